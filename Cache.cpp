@@ -0,0 +1,361 @@
+/*
+ * File:	Cache.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		on-disk cache of check results in Simple C.
+ *
+ *		Entries are spread over 256 subdirectories named for the
+ *		first byte of their key.  An entry starts with a header
+ *		that repeats the key and the length of the input, which
+ *		guards against the rare collision, followed by the symbols
+ *		and then the errors.
+ */
+
+# include <atomic>
+# include <vector>
+# include <cstdio>
+# include <cstring>
+# include <algorithm>
+# include <fcntl.h>
+# include <dirent.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include "Cache.h"
+# include "Prelude.h"
+# include "scc.h"
+
+using namespace std;
+
+# define CACHE_MAGIC "SCCCACHE"
+
+struct Entry {
+    char magic[8];
+    uint64_t key, length;
+    int32_t status;
+    uint32_t errors;
+    uint64_t symbols, diagnostics;
+};
+
+struct File {
+    struct timespec mtime;
+    uint64_t size;
+    string path;
+};
+
+
+/*
+ * Function:	fingerprint
+ *
+ * Description:	Return a 64-bit hash of the given data, consuming eight
+ *		bytes at a time and finishing with the MurmurHash3 mixer.
+ */
+
+uint64_t fingerprint(const void *data, size_t length, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    uint64_t h, w;
+
+
+    h = seed ^ (length * 0x9e3779b97f4a7c15ULL);
+
+    for (; length >= 8; p += 8, length -= 8) {
+	memcpy(&w, p, 8);
+	w *= 0x87c37b91114253d5ULL;
+	h ^= (w << 31) | (w >> 33);
+	h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+    }
+
+    w = 0;
+    memcpy(&w, p, length);
+    h ^= w * 0x4cf5ad432745937fULL;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
+/*
+ * Function:	writeAll
+ *
+ * Description:	Write all of the given bytes to a file.  Return whether
+ *		the write was successful.
+ */
+
+static bool writeAll(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *) data;
+    ssize_t n;
+
+
+    while (length > 0) {
+	if ((n = write(fd, p, length)) <= 0)
+	    return false;
+
+	p += n;
+	length -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	readAll
+ *
+ * Description:	Read exactly the given number of bytes from a file.
+ *		Return whether the read was successful.
+ */
+
+static bool readAll(int fd, void *data, size_t length)
+{
+    char *p = (char *) data;
+    ssize_t n;
+
+
+    while (length > 0) {
+	if ((n = read(fd, p, length)) <= 0)
+	    return false;
+
+	p += n;
+	length -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	scan
+ *
+ * Description:	Collect the entries in the given cache directory.
+ */
+
+static void scan(const string &directory, vector<File> &files)
+{
+    struct dirent *entry;
+    struct stat st;
+    string sub;
+    DIR *dir;
+    char name[3];
+
+
+    for (unsigned i = 0; i < 256; i ++) {
+	snprintf(name, sizeof(name), "%02x", i);
+	sub = directory + "/" + name;
+
+	if ((dir = opendir(sub.c_str())) == nullptr)
+	    continue;
+
+	while ((entry = readdir(dir)) != nullptr) {
+	    if (entry->d_name[0] == '.')
+		continue;
+
+	    File f;
+	    f.path = sub + "/" + entry->d_name;
+
+	    if (stat(f.path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+		f.mtime = st.st_mtim;
+		f.size = st.st_size;
+		files.push_back(f);
+	    }
+	}
+
+	closedir(dir);
+    }
+}
+
+
+/*
+ * Function:	Cache::Cache (constructor)
+ *
+ * Description:	Initialize this cache to use the given directory, holding
+ *		at most about LIMIT bytes of entries, and trim it now if it
+ *		was last used with a larger limit.
+ */
+
+Cache::Cache(const string &directory, uint64_t limit)
+    : _directory(directory), _limit(limit), _size(0)
+{
+    vector<File> files;
+
+
+    mkdir(_directory.c_str(), 0777);
+    scan(_directory, files);
+
+    for (auto &f : files)
+	_size += f.size;
+
+    if (_size > _limit)
+	trim();
+}
+
+
+/*
+ * Function:	Cache::path
+ *
+ * Description:	Return the path of the entry for the given key.
+ */
+
+string Cache::path(uint64_t key) const
+{
+    char name[24];
+
+
+    snprintf(name, sizeof(name), "%02x/%014llx", (unsigned) (key >> 56),
+	(unsigned long long) (key & 0xffffffffffffffULL));
+
+    return _directory + "/" + name;
+}
+
+
+/*
+ * Function:	Cache::key
+ *
+ * Description:	Return the key for checking the given buffer with the
+ *		given options, including the identity of any prelude.
+ */
+
+uint64_t Cache::key(const char *buf, size_t length, const Options &options) const
+{
+    uint64_t seed, identity;
+
+
+    seed = fingerprint(SCC_VERSION, strlen(SCC_VERSION));
+    seed = fingerprint(&options.format, sizeof(options.format), seed);
+
+    if (options.prelude != nullptr) {
+	identity = options.prelude->identity();
+	seed = fingerprint(&identity, sizeof(identity), seed);
+    }
+    return fingerprint(buf, length, seed);
+}
+
+
+/*
+ * Function:	Cache::find
+ *
+ * Description:	Look up the result for the given key and input length.
+ *		Return whether it was found.
+ */
+
+bool Cache::find(uint64_t key, size_t length, Result &result)
+{
+    Entry entry;
+    bool found;
+    int fd;
+
+
+    if ((fd = open(path(key).c_str(), O_RDONLY)) < 0)
+	return false;
+
+    found = readAll(fd, &entry, sizeof(entry)) &&
+	memcmp(entry.magic, CACHE_MAGIC, sizeof(entry.magic)) == 0 &&
+	entry.key == key && entry.length == length;
+
+    if (found) {
+	result.status = entry.status;
+	result.errors = entry.errors;
+	result.symbols.resize(entry.symbols);
+	result.diagnostics.resize(entry.diagnostics);
+
+	found = readAll(fd, &result.symbols[0], entry.symbols) &&
+	    readAll(fd, &result.diagnostics[0], entry.diagnostics);
+    }
+
+    if (found)
+	futimens(fd, nullptr);
+
+    close(fd);
+    return found;
+}
+
+
+/*
+ * Function:	Cache::insert
+ *
+ * Description:	Store the result for the given key and input length.  The
+ *		entry is written to a temporary file and renamed into
+ *		place, so it appears all at once or not at all.
+ */
+
+void Cache::insert(uint64_t key, size_t length, const Result &result)
+{
+    static atomic<unsigned> counter;
+    string final, temp;
+    Entry entry;
+    bool ok;
+    int fd;
+
+
+    memcpy(entry.magic, CACHE_MAGIC, sizeof(entry.magic));
+    entry.key = key;
+    entry.length = length;
+    entry.status = result.status;
+    entry.errors = result.errors;
+    entry.symbols = result.symbols.size();
+    entry.diagnostics = result.diagnostics.size();
+
+    final = path(key);
+    mkdir(final.substr(0, final.rfind('/')).c_str(), 0777);
+
+    temp = final + ".tmp." + to_string(getpid()) + "." + to_string(counter ++);
+
+    if ((fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666)) < 0)
+	return;
+
+    ok = writeAll(fd, &entry, sizeof(entry)) &&
+	writeAll(fd, result.symbols.data(), result.symbols.size()) &&
+	writeAll(fd, result.diagnostics.data(), result.diagnostics.size());
+
+    if (close(fd) < 0 || !ok || rename(temp.c_str(), final.c_str()) < 0) {
+	unlink(temp.c_str());
+	return;
+    }
+
+    lock_guard<mutex> guard(_lock);
+    _size += sizeof(entry) + entry.symbols + entry.diagnostics;
+
+    if (_size > _limit)
+	trim();
+}
+
+
+/*
+ * Function:	Cache::trim
+ *
+ * Description:	Remove the least recently used entries until the cache is
+ *		back under nine tenths of its limit, leaving some room so
+ *		that we don't have to trim again on the very next insert.
+ *		The lock must be held.
+ */
+
+void Cache::trim()
+{
+    vector<File> files;
+
+
+    scan(_directory, files);
+    _size = 0;
+
+    for (auto &f : files)
+	_size += f.size;
+
+    sort(files.begin(), files.end(), [](const File &a, const File &b) {
+	if (a.mtime.tv_sec != b.mtime.tv_sec)
+	    return a.mtime.tv_sec < b.mtime.tv_sec;
+
+	return a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+
+    for (auto &f : files) {
+	if (_size <= _limit / 10 * 9)
+	    break;
+
+	if (unlink(f.path.c_str()) == 0)
+	    _size -= f.size;
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * File:	Cache.h
+ *
+ * Description:	This file contains the class definition for the on-disk
+ *		cache of check results in Simple C.  A result is stored
+ *		under a hash of the input bytes, the version of the
+ *		compiler, and the options that affect the result, including
+ *		the image of any prelude, so that
+ *		checking unchanged input again simply replays the symbols
+ *		and errors, byte for byte, without lexing or parsing.
+ *
+ *		Each entry is a file of its own, written under a temporary
+ *		name and then renamed into place, so that readers never see
+ *		a partial entry even with many processes sharing the cache.
+ *		Hits update the modification time of the entry, and once
+ *		the cache grows beyond its limit, the least recently used
+ *		entries are removed.
+ */
+
+# ifndef CACHE_H
+# define CACHE_H
+# include <mutex>
+# include <string>
+# include <cstdint>
+# include <cstddef>
+
+struct Options;
+struct Result;
+
+class Cache {
+    typedef std::string string;
+
+    string _directory;
+    uint64_t _limit, _size;
+    std::mutex _lock;
+
+    string path(uint64_t key) const;
+    void trim();
+
+public:
+    Cache(const string &directory, uint64_t limit);
+
+    uint64_t key(const char *buf, size_t length, const Options &options) const;
+    bool find(uint64_t key, size_t length, Result &result);
+    void insert(uint64_t key, size_t length, const Result &result);
+};
+
+uint64_t fingerprint(const void *data, size_t length, uint64_t seed = 0);
+
+# endif /* CACHE_H */
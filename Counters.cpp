@@ -0,0 +1,135 @@
+/*
+ * File:	Counters.cpp
+ *
+ * Description:	This file contains the member function definitions for a
+ *		group of hardware performance counters.
+ */
+
+# include <cstring>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+# include "Counters.h"
+
+using namespace std;
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+	PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+	PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+};
+
+
+/*
+ * Function:	Counters::Counters (constructor)
+ *
+ * Description:	Initialize this group with no counters open.
+ */
+
+Counters::Counters()
+    : _count(0)
+{
+    for (int i = 0; i < EVENTS; i ++)
+	_fds[i] = _slots[i] = -1;
+}
+
+
+/*
+ * Function:	Counters::~Counters (destructor)
+ *
+ * Description:	Close the counters of this group.
+ */
+
+Counters::~Counters()
+{
+    for (int i = 0; i < EVENTS; i ++)
+	if (_fds[i] >= 0)
+	    close(_fds[i]);
+}
+
+
+/*
+ * Function:	Counters::open
+ *
+ * Description:	Open and start the counters of this group.  Return whether
+ *		any could be opened.
+ */
+
+bool Counters::open()
+{
+    struct perf_event_attr attr;
+
+
+    for (int i = 0; i < EVENTS; i ++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[i].type;
+	attr.config = events[i].config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.disabled = i == 0;
+	attr.pinned = i == 0;
+
+	_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : _fds[0], 0);
+
+	if (_fds[i] >= 0)
+	    _slots[i] = _count ++;
+	else if (i == 0)
+	    return false;
+    }
+
+    ioctl(_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+
+/*
+ * Function:	Counters::available
+ *
+ * Description:	Return whether the given counter is being counted.
+ */
+
+bool Counters::available(Event event) const
+{
+    return _slots[event] >= 0;
+}
+
+
+/*
+ * Function:	Counters::read
+ *
+ * Description:	Read the current values of the counters of this group.  An
+ *		unavailable counter reads as zero.  Return whether the
+ *		group could be read, which it cannot be if it was pushed
+ *		off the hardware by another user of the counters.
+ */
+
+bool Counters::read(uint64_t values[EVENTS]) const
+{
+    uint64_t data[EVENTS + 1];
+    ssize_t n;
+
+
+    if (_count == 0)
+	return false;
+
+    n = ::read(_fds[0], data, (_count + 1) * sizeof(uint64_t));
+
+    if (n != (ssize_t) ((_count + 1) * sizeof(uint64_t)))
+	return false;
+
+    for (int i = 0; i < EVENTS; i ++)
+	values[i] = _slots[i] >= 0 ? data[_slots[i] + 1] : 0;
+
+    return true;
+}
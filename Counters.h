@@ -0,0 +1,37 @@
+/*
+ * File:	Counters.h
+ *
+ * Description:	This file contains the class definition for a group of
+ *		hardware performance counters, counting the calling thread
+ *		in user mode only.  The counters are opened together so
+ *		that they are scheduled together, and read together so
+ *		that their values agree with one another.
+ *
+ *		Not every machine has every counter, and many virtual
+ *		machines have none at all.  A counter that cannot be
+ *		opened is simply not available, and if the cycle counter
+ *		that leads the group cannot be opened, none are.
+ */
+
+# ifndef COUNTERS_H
+# define COUNTERS_H
+# include <cstdint>
+
+class Counters {
+public:
+    enum Event { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1_MISSES, LLC_MISSES, EVENTS };
+
+private:
+    int _fds[EVENTS], _slots[EVENTS];
+    unsigned _count;
+
+public:
+    Counters();
+    ~Counters();
+
+    bool open();
+    bool available(Event event) const;
+    bool read(uint64_t values[EVENTS]) const;
+};
+
+# endif /* COUNTERS_H */
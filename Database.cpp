@@ -0,0 +1,711 @@
+/*
+ * File:	Database.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		symbol databases in Simple C.
+ *
+ *		The database directory holds the index, the journal, which
+ *		is a text file of paths, one per line, and the shards.  A
+ *		removed file is journaled like any other, but has no shard,
+ *		and the merge leaves its entry in the table of files with
+ *		an empty path.  Only one process should update a database
+ *		at a time, but any number may query it.
+ */
+
+# include <atomic>
+# include <cerrno>
+# include <cstdio>
+# include <cstring>
+# include <fstream>
+# include <algorithm>
+# include <unordered_map>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include "Database.h"
+# include "Cache.h"
+
+using namespace std;
+
+typedef vector<pair<string, DatabasePosting>> Postings;
+
+
+/*
+ * Function:	align
+ *
+ * Description:	Pad the given string with zeros to a multiple of eight
+ *		bytes, and return its new length.
+ */
+
+static uint64_t align(string &s)
+{
+    s.resize((s.size() + 7) & ~(size_t) 7, '\0');
+    return s.size();
+}
+
+
+/*
+ * Function:	intern
+ *
+ * Description:	Append the given text to the given pool, and return its
+ *		offset.
+ */
+
+static uint32_t intern(string &pool, const string &text)
+{
+    uint32_t offset = pool.size();
+
+
+    pool.append(text);
+    pool.push_back('\0');
+    return offset;
+}
+
+
+/*
+ * Function:	mapFile
+ *
+ * Description:	Map the given file into memory, setting its size.  Return
+ *		a null pointer if it cannot be mapped.
+ */
+
+static const char *mapFile(const string &path, size_t &size)
+{
+    struct stat st;
+    void *base;
+    int fd;
+
+
+    if ((fd = open(path.c_str(), O_RDONLY)) < 0)
+	return nullptr;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+	base = MAP_FAILED;
+    else
+	base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (base == MAP_FAILED)
+	return nullptr;
+
+    size = st.st_size;
+    return (const char *) base;
+}
+
+
+/*
+ * Function:	publish
+ *
+ * Description:	Write the given contents to the given file under a
+ *		temporary name and rename it into place.  Return whether
+ *		the file was written.
+ */
+
+static bool publish(const string &path, const string &contents)
+{
+    static atomic<unsigned> counter;
+    string temp;
+    size_t length;
+    ssize_t n;
+    bool ok;
+    int fd;
+
+
+    temp = path + ".tmp." + to_string(getpid()) + "." + to_string(counter ++);
+
+    if ((fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666)) < 0)
+	return false;
+
+    for (length = 0, ok = true; ok && length < contents.size(); length += n)
+	ok = (n = write(fd, contents.data() + length, contents.size() - length)) > 0;
+
+    if (close(fd) < 0 || !ok || rename(temp.c_str(), path.c_str()) < 0) {
+	unlink(temp.c_str());
+	return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	shardImage
+ *
+ * Description:	Return the header of the shard mapped at the given address
+ *		with the given size, if it is a valid shard for the given
+ *		path, and a null pointer otherwise.
+ */
+
+static const ShardImage *shardImage(const char *base, size_t size, const string &path)
+{
+    const ShardImage *h = (const ShardImage *) base;
+    const ShardEntry *entries;
+    uint64_t n;
+
+
+    if (base == nullptr || size < sizeof(ShardImage))
+	return nullptr;
+
+    if (memcmp(h->magic, SHARD_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != SHARD_VERSION || h->size != size ||
+	    h->entries != sizeof(ShardImage) ||
+	    h->count > (size - h->entries) / sizeof(ShardEntry) ||
+	    h->lines != h->entries + h->count * sizeof(ShardEntry) ||
+	    h->nlines > (size - h->lines) / sizeof(uint32_t) ||
+	    h->strings < h->lines + h->nlines * sizeof(uint32_t) ||
+	    h->strings >= size || base[size - 1] != '\0' ||
+	    h->path >= size - h->strings || path != base + h->strings + h->path)
+	return nullptr;
+
+    entries = (const ShardEntry *) (base + h->entries);
+    n = size - h->strings;
+
+    for (uint64_t i = 0; i < h->count; i ++)
+	if (entries[i].name >= n || entries[i].type >= n ||
+		entries[i].references > h->nlines ||
+		entries[i].count > h->nlines - entries[i].references)
+	    return nullptr;
+
+    return h;
+}
+
+
+/*
+ * Function:	hit
+ *
+ * Description:	Return the hit for the given entry of the given shard of
+ *		the given file.
+ */
+
+static Database::Hit hit(const char *base, const ShardImage *h, uint64_t i, const string &path)
+{
+    const ShardEntry &e = ((const ShardEntry *) (base + h->entries))[i];
+    const uint32_t *lines = (const uint32_t *) (base + h->lines);
+    Database::Hit hit;
+
+
+    hit.path = path;
+    hit.type = base + h->strings + e.type;
+    hit.line = e.line;
+    hit.references.assign(lines + e.references, lines + e.references + e.count);
+    return hit;
+}
+
+
+/*
+ * Function:	search
+ *
+ * Description:	Add the hits for the given name in the shard of the given
+ *		file, which is in the given shard file, to the given list.
+ */
+
+static void search(const string &file, const string &path, const string &name, vector<Database::Hit> &hits)
+{
+    const ShardEntry *entries;
+    const ShardImage *h;
+    const char *base;
+    uint64_t lo, hi, mid;
+    size_t size;
+    int cmp;
+
+
+    base = mapFile(file, size);
+
+    if ((h = shardImage(base, size, path)) != nullptr) {
+	entries = (const ShardEntry *) (base + h->entries);
+
+	for (lo = 0, hi = h->count; lo < hi; ) {
+	    mid = (lo + hi) / 2;
+	    cmp = strcmp(base + h->strings + entries[mid].name, name.c_str());
+
+	    if (cmp == 0) {
+		hits.push_back(hit(base, h, mid, path));
+		break;
+	    }
+
+	    if (cmp < 0)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+    }
+
+    if (base != nullptr)
+	munmap((void *) base, size);
+}
+
+
+/*
+ * Function:	Database::Database (constructor)
+ *
+ * Description:	Initialize this database to use the given directory,
+ *		creating it if necessary, and checking files with the given
+ *		options.
+ */
+
+Database::Database(const string &directory, const Options &options)
+    : _directory(directory), _options(options), _base(nullptr), _size(0)
+{
+    mkdir(_directory.c_str(), 0777);
+    mkdir((_directory + "/shards").c_str(), 0777);
+    reload();
+}
+
+
+/*
+ * Function:	Database::~Database (destructor)
+ *
+ * Description:	Unmap the index of this database, if any.
+ */
+
+Database::~Database()
+{
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+}
+
+
+/*
+ * Function:	Database::shard (private)
+ *
+ * Description:	Return the path of the shard for the given file.
+ */
+
+string Database::shard(const string &path) const
+{
+    uint64_t key = fingerprint(path.data(), path.size());
+    char name[24];
+
+
+    snprintf(name, sizeof(name), "%02x/%014llx", (unsigned) (key >> 56),
+	(unsigned long long) (key & 0xffffffffffffffULL));
+
+    return _directory + "/shards/" + name;
+}
+
+
+/*
+ * Function:	Database::image (private)
+ *
+ * Description:	Return the header of the index, or a null pointer if there
+ *		is none.
+ */
+
+const DatabaseImage *Database::image() const
+{
+    return (const DatabaseImage *) _base;
+}
+
+
+/*
+ * Function:	Database::reload (private)
+ *
+ * Description:	Map the index, if there is a valid one, and read the
+ *		journal.  Only the header of the index is checked; each
+ *		array is checked as it is used.
+ */
+
+void Database::reload()
+{
+    const DatabaseImage *h;
+    unordered_set<string> seen;
+    string line;
+
+
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+
+    _base = mapFile(_directory + "/index", _size);
+    h = (const DatabaseImage *) _base;
+
+    if (_base != nullptr && (_size < sizeof(DatabaseImage) ||
+	    memcmp(h->magic, DATABASE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != DATABASE_VERSION || h->size != _size ||
+	    h->files != sizeof(DatabaseImage) ||
+	    h->nfiles > (_size - h->files) / sizeof(DatabaseFile) ||
+	    h->names != h->files + h->nfiles * sizeof(DatabaseFile) ||
+	    h->nnames > (_size - h->names) / sizeof(DatabaseName) ||
+	    h->postings != h->names + h->nnames * sizeof(DatabaseName) ||
+	    h->npostings > (_size - h->postings) / sizeof(DatabasePosting) ||
+	    h->strings < h->postings + h->npostings * sizeof(DatabasePosting) ||
+	    h->strings >= _size || _base[_size - 1] != '\0')) {
+	munmap((void *) _base, _size);
+	_base = nullptr;
+    }
+
+    _journal.clear();
+    _journaled.clear();
+    ifstream journal(_directory + "/journal");
+
+    while (getline(journal, line))
+	if (!line.empty() && _journaled.insert(line).second)
+	    _journal.push_back(line);
+}
+
+
+/*
+ * Function:	Database::note (private)
+ *
+ * Description:	Add the given file to the journal, if it is not there
+ *		already.  The lock must be held.
+ */
+
+void Database::note(const string &path)
+{
+    string line = path + "\n";
+    int fd;
+
+
+    if (!_journaled.insert(path).second)
+	return;
+
+    _journal.push_back(path);
+
+    if ((fd = open((_directory + "/journal").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666)) >= 0) {
+	if (write(fd, line.data(), line.size()) < 0)
+	    perror(_directory.c_str());
+
+	close(fd);
+    }
+}
+
+
+/*
+ * Function:	Database::update
+ *
+ * Description:	Replace the shard of the given file, whose contents are in
+ *		the given buffer, unless the shard is already up to date.
+ *		Return whether the shard was written or left as it was.
+ */
+
+bool Database::update(const string &path, const char *buf, size_t length)
+{
+    uint64_t key = fingerprint(buf, length);
+    string file = shard(path), strings, contents;
+    vector<ShardEntry> entries;
+    vector<uint32_t> lines;
+    vector<Global> globals;
+    const ShardImage *old;
+    const char *base;
+    ShardImage header;
+    size_t size;
+    int status;
+    bool same;
+
+
+    base = mapFile(file, size);
+    old = shardImage(base, size, path);
+    same = old != nullptr && old->fingerprint == key;
+
+    if (base != nullptr)
+	munmap((void *) base, size);
+
+    if (same)
+	return true;
+
+    status = summarize(buf, length, _options, globals);
+    strings.push_back('\0');
+
+    for (auto &global : globals) {
+	ShardEntry e;
+	e.name = intern(strings, global.name);
+	e.type = intern(strings, global.type);
+	e.line = global.line;
+	e.references = lines.size();
+	e.count = global.references.size();
+	lines.insert(lines.end(), global.references.begin(), global.references.end());
+	entries.push_back(e);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHARD_MAGIC, sizeof(header.magic));
+    header.version = SHARD_VERSION;
+    header.status = status;
+    header.fingerprint = key;
+    header.path = intern(strings, path);
+    header.entries = sizeof(header);
+    header.count = entries.size();
+    header.lines = header.entries + entries.size() * sizeof(ShardEntry);
+    header.nlines = lines.size();
+
+    contents.assign((const char *) &header, sizeof(header));
+    contents.append((const char *) entries.data(), entries.size() * sizeof(ShardEntry));
+    contents.append((const char *) lines.data(), lines.size() * sizeof(uint32_t));
+    header.strings = align(contents);
+    contents.append(strings);
+    header.size = contents.size();
+    memcpy(&contents[0], &header, sizeof(header));
+
+    mkdir(file.substr(0, file.rfind('/')).c_str(), 0777);
+
+    if (!publish(file, contents))
+	return false;
+
+    lock_guard<mutex> guard(_lock);
+    note(path);
+    return true;
+}
+
+
+/*
+ * Function:	Database::remove
+ *
+ * Description:	Remove the shard of the given file.  Return whether there
+ *		was one.
+ */
+
+bool Database::remove(const string &path)
+{
+    bool removed = unlink(shard(path).c_str()) == 0;
+
+
+    lock_guard<mutex> guard(_lock);
+    note(path);
+    return removed;
+}
+
+
+/*
+ * Function:	Database::merge
+ *
+ * Description:	Build the next generation of the index from the current
+ *		one and the shards of the journaled files, and empty the
+ *		journal.  Return whether the index was written.
+ */
+
+bool Database::merge()
+{
+    lock_guard<mutex> guard(_lock);
+    const DatabaseImage *h = image();
+    const DatabaseFile *oldFiles = nullptr;
+    const DatabaseName *oldNames = nullptr;
+    const DatabasePosting *oldPostings = nullptr;
+    const char *oldStrings = nullptr, *base;
+    vector<DatabaseFile> files;
+    vector<DatabaseName> names;
+    vector<DatabasePosting> postings;
+    unordered_map<string, uint32_t> numbers;
+    vector<bool> replaced;
+    const ShardImage *s;
+    DatabaseImage header;
+    string strings, contents, name;
+    Postings fresh;
+    uint64_t i, j, k, nnames;
+    uint32_t n;
+    size_t size;
+
+
+    strings.push_back('\0');
+    nnames = 0;
+
+    if (h != nullptr) {
+	oldFiles = (const DatabaseFile *) (_base + h->files);
+	oldNames = (const DatabaseName *) (_base + h->names);
+	oldPostings = (const DatabasePosting *) (_base + h->postings);
+	oldStrings = _base + h->strings;
+	nnames = h->nnames;
+
+	for (i = 0; i < h->nfiles; i ++) {
+	    string path = oldFiles[i].path < _size - h->strings ? oldStrings + oldFiles[i].path : "";
+
+	    files.push_back(DatabaseFile {path.empty() ? 0 : intern(strings, path), 0});
+	    replaced.push_back(path.empty() || _journaled.count(path) > 0);
+
+	    if (!path.empty())
+		numbers[path] = i;
+	}
+    }
+
+    for (auto &path : _journal) {
+	auto it = numbers.find(path);
+
+	if (it != numbers.end())
+	    n = it->second;
+	else {
+	    n = files.size();
+	    files.push_back(DatabaseFile {intern(strings, path), 0});
+	    replaced.push_back(true);
+	}
+
+	base = mapFile(shard(path), size);
+
+	if ((s = shardImage(base, size, path)) != nullptr) {
+	    const ShardEntry *entries = (const ShardEntry *) (base + s->entries);
+
+	    for (i = 0; i < s->count; i ++)
+		fresh.emplace_back(base + s->strings + entries[i].name, DatabasePosting {n, (uint32_t) i});
+	} else
+	    files[n].path = 0;
+
+	if (base != nullptr)
+	    munmap((void *) base, size);
+    }
+
+    stable_sort(fresh.begin(), fresh.end(),
+	[](const Postings::value_type &a, const Postings::value_type &b) {
+	    return a.first < b.first;
+	});
+
+    for (i = 0, j = 0; i < nnames || j < fresh.size(); ) {
+	if (j == fresh.size() || (i < nnames &&
+		strcmp(oldStrings + oldNames[i].name, fresh[j].first.c_str()) <= 0))
+	    name = oldStrings + oldNames[i].name;
+	else
+	    name = fresh[j].first;
+
+	DatabaseName d {0, 0, postings.size()};
+
+	if (i < nnames && name == oldStrings + oldNames[i].name) {
+	    for (k = 0; k < oldNames[i].count && oldNames[i].postings + k < h->npostings; k ++) {
+		const DatabasePosting &p = oldPostings[oldNames[i].postings + k];
+
+		if (p.file < replaced.size() && !replaced[p.file])
+		    postings.push_back(p);
+	    }
+
+	    i ++;
+	}
+
+	for (; j < fresh.size() && fresh[j].first == name; j ++)
+	    postings.push_back(fresh[j].second);
+
+	if ((d.count = postings.size() - d.postings) > 0) {
+	    d.name = intern(strings, name);
+	    names.push_back(d);
+	}
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATABASE_MAGIC, sizeof(header.magic));
+    header.version = DATABASE_VERSION;
+    header.generation = h != nullptr ? h->generation + 1 : 1;
+    header.files = sizeof(header);
+    header.nfiles = files.size();
+    header.names = header.files + files.size() * sizeof(DatabaseFile);
+    header.nnames = names.size();
+    header.postings = header.names + names.size() * sizeof(DatabaseName);
+    header.npostings = postings.size();
+
+    contents.assign((const char *) &header, sizeof(header));
+    contents.append((const char *) files.data(), files.size() * sizeof(DatabaseFile));
+    contents.append((const char *) names.data(), names.size() * sizeof(DatabaseName));
+    contents.append((const char *) postings.data(), postings.size() * sizeof(DatabasePosting));
+    header.strings = align(contents);
+    contents.append(strings);
+    header.size = contents.size();
+    memcpy(&contents[0], &header, sizeof(header));
+
+    if (!publish(_directory + "/index", contents))
+	return false;
+
+    unlink((_directory + "/journal").c_str());
+    reload();
+    return true;
+}
+
+
+/*
+ * Function:	Database::lookup
+ *
+ * Description:	Return the definitions and references of every global
+ *		with the given name, ordered by file and line.
+ */
+
+vector<Database::Hit> Database::lookup(const string &name) const
+{
+    lock_guard<mutex> guard(_lock);
+    const DatabaseImage *h = image();
+    const DatabaseFile *files;
+    const DatabaseName *names;
+    const DatabasePosting *postings;
+    const char *strings;
+    vector<Hit> hits;
+    uint64_t lo, hi, mid, k, limit;
+    int cmp;
+
+
+    if (h != nullptr) {
+	files = (const DatabaseFile *) (_base + h->files);
+	names = (const DatabaseName *) (_base + h->names);
+	postings = (const DatabasePosting *) (_base + h->postings);
+	strings = _base + h->strings;
+	limit = _size - h->strings;
+
+	for (lo = 0, hi = h->nnames; lo < hi; ) {
+	    mid = (lo + hi) / 2;
+	    cmp = names[mid].name < limit ? strcmp(strings + names[mid].name, name.c_str()) : 1;
+
+	    if (cmp < 0) {
+		lo = mid + 1;
+		continue;
+	    }
+
+	    if (cmp > 0) {
+		hi = mid;
+		continue;
+	    }
+
+	    for (k = 0; k < names[mid].count && names[mid].postings + k < h->npostings; k ++) {
+		const DatabasePosting &p = postings[names[mid].postings + k];
+
+		if (p.file >= h->nfiles || files[p.file].path == 0 || files[p.file].path >= limit)
+		    continue;
+
+		string path = strings + files[p.file].path;
+
+		if (_journaled.count(path) > 0)
+		    continue;
+
+		size_t size;
+		const char *base = mapFile(shard(path), size);
+		const ShardImage *s = shardImage(base, size, path);
+
+		if (s != nullptr && p.entry < s->count)
+		    hits.push_back(hit(base, s, p.entry, path));
+
+		if (base != nullptr)
+		    munmap((void *) base, size);
+	    }
+
+	    break;
+	}
+    }
+
+    for (auto &path : _journal)
+	search(shard(path), path, name, hits);
+
+    sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+	return a.path < b.path || (a.path == b.path && a.line < b.line);
+    });
+
+    return hits;
+}
+
+
+/*
+ * Function:	Database::generation (accessor)
+ *
+ * Description:	Return the generation of the index, which is zero if
+ *		there is none.
+ */
+
+uint64_t Database::generation() const
+{
+    lock_guard<mutex> guard(_lock);
+    return image() != nullptr ? image()->generation : 0;
+}
+
+
+/*
+ * Function:	Database::pending (accessor)
+ *
+ * Description:	Return the number of files journaled since the last merge.
+ */
+
+size_t Database::pending() const
+{
+    lock_guard<mutex> guard(_lock);
+    return _journal.size();
+}
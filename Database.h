@@ -0,0 +1,128 @@
+/*
+ * File:	Database.h
+ *
+ * Description:	This file contains the class definition for symbol
+ *		databases in Simple C, which answer where a global is
+ *		declared and referenced across a whole repository.
+ *
+ *		Each file checked gets a shard of its own: the globals it
+ *		declares, with their final types from the outermost scope
+ *		and the lines of their definitions and references, taken
+ *		from a cross-reference index.  Shards are spread over 256
+ *		subdirectories by a hash of the path, like cache entries,
+ *		and written under a temporary name and renamed into place.
+ *
+ *		A merge builds the index: a table of the files, and every
+ *		global name in sorted order, each with its postings, which
+ *		give the file and the entry in its shard.  The index is
+ *		simply mapped into memory, and a query is a binary search
+ *		followed by a look at the shards it names, so queries need
+ *		little memory no matter how large the repository.
+ *
+ *		Replacing the shard of a changed file does not touch the
+ *		index.  The path is added to a journal instead, and
+ *		queries skip the postings of journaled files and consult
+ *		their shards directly.  Each merge starts a new generation
+ *		of the index, folding in the journaled shards and emptying
+ *		the journal, and reads only the old index and those shards.
+ */
+
+# ifndef DATABASE_H
+# define DATABASE_H
+# include <mutex>
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+# include <unordered_set>
+# include "scc.h"
+
+# define SHARD_MAGIC "SCCSHARD"
+# define SHARD_VERSION 1
+# define DATABASE_MAGIC "SCCINDEX"
+# define DATABASE_VERSION 1
+
+struct ShardEntry {
+    uint32_t name;		/* offset into strings */
+    uint32_t type;		/* offset into strings, as text */
+    uint32_t line;		/* line of the definition */
+    uint32_t count;		/* number of references */
+    uint64_t references;	/* index of the first in lines */
+};
+
+struct ShardImage {
+    char magic[8];		/* SHARD_MAGIC */
+    uint32_t version;		/* SHARD_VERSION */
+    int32_t status;		/* exit status of the file */
+    uint64_t fingerprint;	/* fingerprint of the contents of the file */
+    uint64_t path;		/* offset into strings */
+    uint64_t entries, count;	/* ShardEntry[count], sorted by name */
+    uint64_t lines, nlines;	/* uint32_t[nlines], lines of references */
+    uint64_t strings, size;	/* char[], null-terminated text; total size */
+};
+
+struct DatabaseFile {
+    uint32_t path;		/* offset into strings, empty if removed */
+    uint32_t unused;
+};
+
+struct DatabaseName {
+    uint32_t name;		/* offset into strings */
+    uint32_t count;		/* number of postings */
+    uint64_t postings;		/* index of the first in postings */
+};
+
+struct DatabasePosting {
+    uint32_t file;		/* index into files */
+    uint32_t entry;		/* index into the entries of its shard */
+};
+
+struct DatabaseImage {
+    char magic[8];		/* DATABASE_MAGIC */
+    uint32_t version;		/* DATABASE_VERSION */
+    uint32_t unused;
+    uint64_t generation;	/* number of merges so far */
+    uint64_t files, nfiles;	/* DatabaseFile[nfiles] */
+    uint64_t names, nnames;	/* DatabaseName[nnames], sorted by name */
+    uint64_t postings, npostings; /* DatabasePosting[npostings] */
+    uint64_t strings, size;	/* char[], null-terminated text; total size */
+};
+
+class Database {
+    typedef std::string string;
+
+public:
+    struct Hit {
+	string path, type;
+	unsigned line;
+	std::vector<unsigned> references;
+    };
+
+private:
+    string _directory;
+    Options _options;
+    const char *_base;
+    size_t _size;
+    std::vector<string> _journal;
+    std::unordered_set<string> _journaled;
+    mutable std::mutex _lock;
+
+    string shard(const string &path) const;
+    const DatabaseImage *image() const;
+    void note(const string &path);
+    void reload();
+
+public:
+    Database(const string &directory, const Options &options = Options());
+    ~Database();
+
+    bool update(const string &path, const char *buf, size_t length);
+    bool remove(const string &path);
+    bool merge();
+
+    std::vector<Hit> lookup(const string &name) const;
+    uint64_t generation() const;
+    size_t pending() const;
+};
+
+# endif /* DATABASE_H */
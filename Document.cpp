@@ -0,0 +1,610 @@
+/*
+ * File:	Document.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		documents in Simple C.
+ *
+ *		Each global or function is kept as a piece: the unit
+ *		recorded by the incremental engine, along with its offset
+ *		and line.  The pieces before the pivot have their true
+ *		offsets and lines, and those from the pivot on are off by
+ *		the shift, which grows with each edit.  Moving the pivot
+ *		fixes the pieces in between.
+ *
+ *		The text of a piece runs from its first token through the
+ *		first token of the next piece and the character after it,
+ *		so an edit touches every piece whose tokens it could
+ *		change.  The first piece also covers any text before it.
+ *
+ *		One outermost scope is kept for the whole document.  It
+ *		holds the globals as they are just before some piece, and
+ *		is moved to the piece being checked by applying or
+ *		reverting the declarations of the pieces in between.  The
+ *		first use of each name by a piece records the type it had
+ *		before, which is what reverting restores.
+ */
+
+# include <cstdlib>
+# include <cstring>
+# include <sstream>
+# include <unordered_map>
+# include "Document.h"
+# include "checker.h"
+# include "parser.h"
+# include "lexer.h"
+
+using namespace std;
+
+static const size_t none = (size_t) -1;
+
+
+/*
+ * Function:	Document::Document (constructor)
+ *
+ * Description:	Initialize this document as empty, with the given options.
+ */
+
+Document::Document(const Options &options)
+    : _options(options), _scope(nullptr), _at(0), _gap(0), _spare(0),
+      _pivot(0), _broken(none), _shift(0), _lines(0), _stale(true),
+      _checked(0)
+{
+}
+
+
+/*
+ * Function:	Document::~Document (destructor)
+ *
+ * Description:	Deallocate the outermost scope of this document and its
+ *		symbols.
+ */
+
+Document::~Document()
+{
+    if (_scope != nullptr) {
+	for (auto symbol : _scope->symbols())
+	    delete symbol;
+
+	delete _scope;
+    }
+}
+
+
+/*
+ * Function:	Document::slide (private)
+ *
+ * Description:	Move the gap in the text to the given offset.
+ */
+
+void Document::slide(size_t position)
+{
+    char *p = &_text[0];
+
+
+    if (position < _gap)
+	memmove(p + position + _spare, p + position, _gap - position);
+    else if (position > _gap)
+	memmove(p + _gap, p + _gap + _spare, position - _gap);
+
+    _gap = position;
+}
+
+
+/*
+ * Function:	Document::contiguous (private)
+ *
+ * Description:	Return the text, making sure that it is contiguous up to
+ *		the given offset.
+ */
+
+const char *Document::contiguous(size_t end)
+{
+    if (end > _gap)
+	slide(end);
+
+    return _text.data();
+}
+
+
+/*
+ * Function:	Document::start (private)
+ *
+ * Description:	Return the offset of the first token of the given piece.
+ */
+
+size_t Document::start(size_t i) const
+{
+    return _pieces[i].start + (i >= _pivot ? _shift : 0);
+}
+
+
+/*
+ * Function:	Document::end (private)
+ *
+ * Description:	Return the offset just past the text of the given piece,
+ *		which is past the end of the document for the last piece.
+ */
+
+size_t Document::end(size_t i) const
+{
+    const Unit &unit = _pieces[i].unit;
+
+
+    return start(i) + unit.length + (unit.last ? 1 : 0);
+}
+
+
+/*
+ * Function:	Document::line (private)
+ *
+ * Description:	Return the line after the first token of the given piece.
+ */
+
+int Document::line(size_t i) const
+{
+    return _pieces[i].line + (i >= _pivot ? _lines : 0);
+}
+
+
+/*
+ * Function:	Document::settle (private)
+ *
+ * Description:	Move the pivot to the given piece.
+ */
+
+void Document::settle(size_t i)
+{
+    for (; _pivot < i; _pivot ++) {
+	_pieces[_pivot].start += _shift;
+	_pieces[_pivot].line += _lines;
+    }
+
+    for (; _pivot > i; _pivot --) {
+	_pieces[_pivot - 1].start -= _shift;
+	_pieces[_pivot - 1].line -= _lines;
+    }
+}
+
+
+/*
+ * Function:	Document::revert (private)
+ *
+ * Description:	Undo the declarations of the given unit in the outermost
+ *		scope.
+ */
+
+void Document::revert(const Unit &unit)
+{
+    for (auto &d : unit.defines)
+	for (auto &use : unit.uses)
+	    if (use.first == d.first) {
+		Incremental::bind(_scope, use.first, use.second);
+		break;
+	    }
+}
+
+
+/*
+ * Function:	Document::seek (private)
+ *
+ * Description:	Move the outermost scope to just before the given piece.
+ */
+
+void Document::seek(size_t i)
+{
+    while (_at > i)
+	revert(_pieces[-- _at].unit);
+
+    for (; _at < i; _at ++)
+	for (auto &d : _pieces[_at].unit.defines)
+	    Incremental::bind(_scope, d.first, d.second);
+}
+
+
+/*
+ * Function:	Document::reparse (private)
+ *
+ * Description:	Check the text of the pieces from A up to Z again, and
+ *		replace them with the pieces found there.  The pieces from
+ *		Z on have their new offsets, and checking continues past
+ *		them until a piece starts where an old one does, or to the
+ *		end if the document was abandoned.  The old pieces are
+ *		offered for replay, in case some are unchanged.
+ *
+ *		The text is made contiguous only through the first token
+ *		of piece Z.  If the lexer runs into the gap, or a piece
+ *		starts past Z but not where an old one does, we try again
+ *		over more of the document.
+ *
+ *		The names whose types after the new pieces differ from
+ *		those after the old ones are added to the changed names,
+ *		and those that are now the same are removed.  Return the
+ *		index of the piece after the new ones.
+ */
+
+size_t Document::reparse(size_t a, size_t z, unordered_set<string> &changed)
+{
+    size_t n, s, stop, limit, next, count, taken, tries, i, j, k;
+    unordered_map<string, string> after, before;
+    vector<Unit> units, candidates;
+    ostream *saved = diagnostics;
+    const char *base;
+    int status, first;
+    bool broken;
+
+
+    seek(a);
+    n = _pieces.size();
+    s = a == 0 ? 0 : start(a);
+    first = a == 0 ? 1 : line(a) - _pieces[a].unit.lead;
+    limit = z < n ? end(z) : n > a ? end(n - 1) : length();
+    broken = _broken != none;
+
+    if (broken)
+	candidates.swap(_pool);
+
+    for (taken = a, tries = 0; ; tries ++) {
+	for (; taken < z; taken ++) {
+	    for (auto &d : _pieces[taken].unit.defines)
+		after[d.first] = d.second;
+
+	    candidates.push_back(std::move(_pieces[taken].unit));
+	}
+
+	stop = z < n ? start(z) : length();
+	limit = min(max(limit, z < n ? end(z) : limit), length());
+	base = contiguous(limit);
+
+	if (s == 0) {
+	    ostringstream stream;
+	    string lexeme;
+
+	    diagnostics = &stream;
+	    lexinit(base, limit);
+	    lexan(lexeme);
+	    _head = stream.str();
+	    diagnostics = saved;
+	}
+
+	_engine.units().swap(candidates);
+	candidates.clear();
+
+	status = globals(base + s, limit - s, first, _scope, stop - s, next);
+	next += s;
+
+	count = _engine.replayed() + _engine.checked();
+	_checked += _engine.checked();
+	_engine.keep();
+	units.swap(_engine.units());
+
+	if (limit < length() && lexpos() + s == limit) {
+	    if (z < n)
+		z = min(n, z + max(z - a, (size_t) 1));
+	    else
+		limit += max(limit - s, (size_t) 4096);
+
+	} else if (status == EXIT_SUCCESS && next != stop) {
+	    if (next >= length()) {
+		z = n;
+		break;
+	    }
+
+	    for (j = z; j < n && start(j) < next; j ++)
+		continue;
+
+	    if (j < n && start(j) == next) {
+		z = j;
+		break;
+	    }
+
+	    z = j < n && tries < 2 ? j : n;
+
+	} else
+	    break;
+
+	for (i = count; i -- > 0; )
+	    revert(units[i]);
+
+	for (auto &unit : units)
+	    if (!unit.broken)
+		candidates.push_back(std::move(unit));
+
+	units.clear();
+    }
+
+    for (; taken < z; taken ++)
+	for (auto &d : _pieces[taken].unit.defines)
+	    after[d.first] = d.second;
+
+    if (status == EXIT_SUCCESS && !broken) {
+	for (i = 0; i < count; i ++)
+	    for (auto &use : units[i].uses)
+		before.insert(use);
+
+	for (i = 0; i < count; i ++)
+	    for (auto &d : units[i].defines)
+		if (!after.count(d.first) && !changed.count(d.first))
+		    after[d.first] = before[d.first];
+
+	for (auto &entry : after)
+	    if (Incremental::signature(_scope->find(entry.first)) != entry.second)
+		changed.insert(entry.first);
+	    else
+		changed.erase(entry.first);
+    }
+
+    settle(z);
+
+    if (status != EXIT_SUCCESS) {
+	for (i = count; i < units.size(); i ++)
+	    _pool.push_back(std::move(units[i]));
+
+	for (i = z; i < n; i ++)
+	    _pool.push_back(std::move(_pieces[i].unit));
+
+	_pieces.erase(_pieces.begin() + z, _pieces.end());
+    }
+
+    vector<Piece> fresh;
+
+    for (i = 0; i < count; i ++)
+	fresh.push_back(Piece {s + units[i].start, units[i].line, std::move(units[i])});
+
+    k = fresh.size();
+
+    if (k == z - a)
+	std::move(fresh.begin(), fresh.end(), _pieces.begin() + a);
+    else {
+	_pieces.erase(_pieces.begin() + a, _pieces.begin() + z);
+	_pieces.insert(_pieces.begin() + a, make_move_iterator(fresh.begin()),
+	    make_move_iterator(fresh.end()));
+    }
+
+    _pivot = _at = a + k;
+    _broken = status == EXIT_SUCCESS ? none : a + k - 1;
+
+    if (status == EXIT_SUCCESS)
+	_pool.clear();
+
+    return a + k;
+}
+
+
+/*
+ * Function:	Document::update (private)
+ *
+ * Description:	Check the pieces from A up to Z again, and then any later
+ *		pieces that use a global whose type has changed, until no
+ *		types differ from before.  The symbols and errors go
+ *		nowhere; they are kept with the pieces.
+ */
+
+void Document::update(size_t a, size_t z)
+{
+    Output *oldOutput = output;
+    ostream *oldDiagnostics = diagnostics;
+    const atomic<bool> *oldCancelled = cancelled;
+    Incremental *oldIncremental = incremental;
+    unordered_set<string> changed;
+    Output sink(-1, _options.format);
+    ostringstream stream;
+    bool affected;
+    size_t j;
+
+
+    output = &sink;
+    diagnostics = &stream;
+    cancelled = nullptr;
+    incremental = &_engine;
+    _checked = 0;
+
+    j = reparse(a, z, changed);
+
+    while (_broken == none && !changed.empty() && j < _pieces.size()) {
+	affected = false;
+
+	for (auto &use : _pieces[j].unit.uses)
+	    if (changed.count(use.first)) {
+		affected = true;
+		break;
+	    }
+
+	if (affected)
+	    j = reparse(j, j + 1, changed);
+	else {
+	    seek(++ j);
+
+	    for (auto &d : _pieces[j - 1].unit.defines)
+		changed.erase(d.first);
+	}
+    }
+
+    output = oldOutput;
+    diagnostics = oldDiagnostics;
+    cancelled = oldCancelled;
+    incremental = oldIncremental;
+    _stale = true;
+}
+
+
+/*
+ * Function:	Document::open
+ *
+ * Description:	Replace this document with the given text, and check it.
+ */
+
+void Document::open(const char *buf, size_t length)
+{
+    const Prelude *oldPrelude = prelude;
+
+
+    if (_scope != nullptr) {
+	for (auto symbol : _scope->symbols())
+	    delete symbol;
+
+	delete _scope;
+    }
+
+    prelude = _options.prelude;
+    _scope = openScope();
+    closeScope();
+    prelude = oldPrelude;
+
+    _text.assign(buf, length);
+    _gap = length;
+    _spare = 0;
+
+    _pieces.clear();
+    _pool.clear();
+    _head.clear();
+    _pivot = _at = 0;
+    _broken = none;
+    _shift = _lines = 0;
+
+    update(0, 0);
+}
+
+
+/*
+ * Function:	Document::edit
+ *
+ * Description:	Replace the given number of bytes at the given offset with
+ *		the given text, and check the document again.
+ */
+
+void Document::edit(size_t offset, size_t removed, const char *text, size_t inserted)
+{
+    size_t n, a, z, lo, hi, mid, i, grow;
+    int lines;
+
+
+    n = _pieces.size();
+
+    for (lo = 0, hi = n; lo < hi; ) {
+	mid = (lo + hi) / 2;
+
+	if (end(mid) > offset)
+	    hi = mid;
+	else
+	    lo = mid + 1;
+    }
+
+    a = lo < n || n == 0 ? lo : n - 1;
+
+    for (z = a; z < n && (z == 0 || offset + removed > start(z)); z ++)
+	continue;
+
+    if (_broken != none) {
+	a = min(a, _broken);
+	z = n;
+    }
+
+    slide(offset);
+    lines = 0;
+
+    for (i = 0; i < removed; i ++)
+	lines -= _text[_gap + _spare + i] == '\n';
+
+    for (i = 0; i < inserted; i ++)
+	lines += text[i] == '\n';
+
+    _spare += removed;
+
+    if (_spare < inserted) {
+	grow = inserted + length() / 8 + 64;
+	_text.insert(_gap, grow, '\0');
+	_spare += grow;
+    }
+
+    memcpy(&_text[_gap], text, inserted);
+    _gap += inserted;
+    _spare -= inserted;
+
+    settle(z);
+    _shift += (ptrdiff_t) inserted - (ptrdiff_t) removed;
+    _lines += lines;
+    update(a, z);
+}
+
+
+/*
+ * Function:	Document::result
+ *
+ * Description:	Return the result of checking this document as it now
+ *		stands, which is the same as that of check() on its text.
+ *		It remains valid until the next edit.
+ */
+
+const Result &Document::result()
+{
+    Output *oldOutput = output;
+    ostream *oldDiagnostics = diagnostics;
+    int oldErrors = numerrors;
+    Output sink(-1, _options.format);
+    ostringstream stream;
+
+
+    if (!_stale)
+	return _result;
+
+    output = &sink;
+    diagnostics = &stream;
+    numerrors = 0;
+
+    for (auto c : _head)
+	numerrors += c == '\n';
+
+    stream << _head;
+
+    for (size_t i = 0; i < _pieces.size(); i ++)
+	Incremental::emit(_pieces[i].unit, line(i));
+
+    sink.close();
+    _result.status = _broken == none ? EXIT_SUCCESS : EXIT_FAILURE;
+    _result.errors = numerrors;
+    _result.symbols.assign(sink.contents());
+    _result.diagnostics.assign(stream.str());
+
+    output = oldOutput;
+    diagnostics = oldDiagnostics;
+    numerrors = oldErrors;
+    _stale = false;
+    return _result;
+}
+
+
+/*
+ * Function:	Document::length (accessor)
+ *
+ * Description:	Return the length of the text of this document.
+ */
+
+size_t Document::length() const
+{
+    return _text.size() - _spare;
+}
+
+
+/*
+ * Function:	Document::text (accessor)
+ *
+ * Description:	Return the text of this document.
+ */
+
+string Document::text() const
+{
+    return _text.substr(0, _gap) + _text.substr(_gap + _spare);
+}
+
+
+/*
+ * Function:	Document::checked (accessor)
+ *
+ * Description:	Return the number of globals and functions checked by the
+ *		last edit.
+ */
+
+unsigned Document::checked() const
+{
+    return _checked;
+}
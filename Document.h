@@ -0,0 +1,92 @@
+/*
+ * File:	Document.h
+ *
+ * Description:	This file contains the class definition for documents in
+ *		Simple C, which are translation units kept checked while
+ *		they are edited, as in an editor.  Each edit replaces a
+ *		range of bytes, and only the globals and functions whose
+ *		text it touches are lexed, parsed, and checked again.
+ *		Relexing stops as soon as a global or function starts where
+ *		an old one did after the edit, since the tokens from there
+ *		on must be the same.  The globals and functions after that
+ *		are checked again only if they use a global whose type the
+ *		edit changed.
+ *
+ *		The text is kept in a gap buffer with the gap at the last
+ *		edit, so an edit moves only the bytes between it and the
+ *		last one.  The offsets and lines of the globals and
+ *		functions after an edit are adjusted lazily, as later edits
+ *		reach them, and the symbols and errors of the whole unit
+ *		are put together only when asked for.
+ *
+ *		A syntax error abandons the rest of the translation unit,
+ *		just as for check().  The globals and functions after it
+ *		are kept aside and replayed if their text turns up again
+ *		once the error is fixed.
+ */
+
+# ifndef DOCUMENT_H
+# define DOCUMENT_H
+# include <string>
+# include <vector>
+# include <cstddef>
+# include <unordered_set>
+# include "Incremental.h"
+# include "scc.h"
+
+class Document {
+    typedef std::string string;
+    typedef Incremental::Unit Unit;
+
+    struct Piece {
+	size_t start;		/* offset of the first token */
+	int line;		/* line after the first token */
+	Unit unit;
+    };
+
+    Options _options;
+    Incremental _engine;
+    Scope *_scope;
+    size_t _at;
+
+    string _text;
+    size_t _gap, _spare;
+
+    std::vector<Piece> _pieces;
+    std::vector<Unit> _pool;
+    size_t _pivot, _broken;
+    ptrdiff_t _shift;
+    int _lines;
+
+    string _head;
+    Result _result;
+    bool _stale;
+    unsigned _checked;
+
+    void slide(size_t position);
+    const char *contiguous(size_t end);
+
+    size_t start(size_t i) const;
+    size_t end(size_t i) const;
+    int line(size_t i) const;
+    void settle(size_t i);
+
+    void seek(size_t i);
+    void revert(const Unit &unit);
+    size_t reparse(size_t a, size_t z, std::unordered_set<string> &changed);
+    void update(size_t a, size_t z);
+
+public:
+    Document(const Options &options = Options());
+    ~Document();
+
+    void open(const char *buf, size_t length);
+    void edit(size_t offset, size_t removed, const char *text, size_t inserted);
+    const Result &result();
+
+    size_t length() const;
+    string text() const;
+    unsigned checked() const;
+};
+
+# endif /* DOCUMENT_H */
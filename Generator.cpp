@@ -0,0 +1,554 @@
+/*
+ * File:	Generator.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		workload generator for Simple C.  The output is collected
+ *		in a buffer and written to the stream a megabyte at a time,
+ *		so that even a huge translation unit is never held whole.
+ */
+
+# include <sstream>
+# include "Generator.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Generator::Generator (constructor)
+ *
+ * Description:	Initialize this generator with the given knobs.
+ */
+
+Generator::Generator(const Knobs &knobs)
+    : _knobs(knobs), _state(0), _counter(0), _stream(nullptr)
+{
+}
+
+
+/*
+ * Function:	Generator::flush (private)
+ *
+ * Description:	Write the output so far to the stream, if there is enough
+ *		of it or if requested.
+ */
+
+void Generator::flush(bool always)
+{
+    if (always || _out.size() >= (1 << 20)) {
+	_stream->write(_out.data(), _out.size());
+	_out.clear();
+    }
+}
+
+
+/*
+ * Function:	Generator::choose (private)
+ *
+ * Description:	Return a random number less than the given bound, using
+ *		splitmix64 so that the sequence is the same everywhere.
+ */
+
+unsigned Generator::choose(unsigned bound)
+{
+    uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return bound > 0 ? (z ^ (z >> 31)) % bound : 0;
+}
+
+
+/*
+ * Function:	Generator::faulty (private)
+ *
+ * Description:	Return whether the next construct should have an error.
+ */
+
+bool Generator::faulty()
+{
+    return _knobs.errors > 0 && choose(1000000) < _knobs.errors * 1000000;
+}
+
+
+/*
+ * Function:	Generator::identifier (private)
+ *
+ * Description:	Return a new identifier with the given prefix, padded to
+ *		the requested length.  The number after the prefix makes
+ *		it unique, and the prefix keeps it from being a keyword.
+ */
+
+string Generator::identifier(char prefix)
+{
+    string name = prefix + to_string(_counter ++);
+
+
+    if (name.size() < _knobs.identifier) {
+	name += '_';
+
+	while (name.size() < _knobs.identifier)
+	    name += 'a' + name.size() % 26;
+    }
+
+    return name;
+}
+
+
+/*
+ * Function:	Generator::declarator (private)
+ *
+ * Description:	Write a declarator for a new variable of the given kind
+ *		and add the variable to the given list.
+ */
+
+void Generator::declarator(int kind, vector<Variable> &list)
+{
+    list.push_back(Variable {identifier(kind == TEXT ? 's' : 'v'), kind});
+
+    if (kind == POINTER || kind == TEXT)
+	_out += "*";
+
+    _out += list.back().name;
+
+    if (kind == ARRAY)
+	_out += "[" + to_string(1 + choose(100)) + "]";
+}
+
+
+/*
+ * Function:	Generator::declaration (private)
+ *
+ * Description:	Write a declaration of new variables, adding them to the
+ *		given list.
+ */
+
+void Generator::declaration(vector<Variable> &list, const char *indent)
+{
+    unsigned n = _knobs.declarators > 0 ? _knobs.declarators : 1;
+    int kind = choose(4);
+
+
+    _out += indent;
+
+    if (faulty()) {
+	if (choose(2) == 0 || &list != &_globals || list.empty())
+	    _out += "void " + identifier('v') + ";\n";
+	else
+	    _out += "char " + list[choose(list.size())].name + ";\n";
+
+	return;
+    }
+
+    _out += kind == TEXT ? "char " : "int ";
+
+    for (unsigned i = 0; i < n; i ++) {
+	if (i > 0)
+	    _out += ", ";
+
+	declarator(kind == TEXT && i > 0 ? TEXT : kind, list);
+	kind = kind == TEXT ? TEXT : choose(3);
+    }
+
+    _out += ";\n";
+}
+
+
+/*
+ * Function:	Generator::pick (private)
+ *
+ * Description:	Return a random variable of the given kind from the locals
+ *		or _globals, or a null pointer if there is none.
+ */
+
+const Generator::Variable *Generator::pick(int kind, const vector<Variable> &locals)
+{
+    const Variable *v;
+
+
+    for (unsigned tries = 0; tries < 8; tries ++) {
+	if (!locals.empty() && (_globals.empty() || choose(2) == 0))
+	    v = &locals[choose(locals.size())];
+	else if (!_globals.empty())
+	    v = &_globals[choose(_globals.size())];
+	else
+	    return nullptr;
+
+	if (v->kind == kind)
+	    return v;
+    }
+
+    return nullptr;
+}
+
+
+/*
+ * Function:	Generator::leaf (private)
+ *
+ * Description:	Write an operand of type int.
+ */
+
+void Generator::leaf(const vector<Variable> &locals)
+{
+    const Variable *v;
+    unsigned choice = choose(4);
+
+
+    if (choice == 1 && (v = pick(ARRAY, locals)) != nullptr)
+	_out += "*" + v->name;
+    else if (choice == 2 && (v = pick(POINTER, locals)) != nullptr)
+	_out += "*" + v->name;
+    else if (choice == 3 || (v = pick(INTEGER, locals)) == nullptr)
+	_out += to_string(choose(1000));
+    else
+	_out += v->name;
+}
+
+
+/*
+ * Function:	Generator::expression (private)
+ *
+ * Description:	Write an expression of type int of the given depth.
+ */
+
+void Generator::expression(unsigned depth, const vector<Variable> &locals)
+{
+    static const char *binary[] = {
+	"+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&&", "||",
+    };
+
+    unsigned choice;
+    const Variable *v;
+
+
+    if (depth == 0) {
+	leaf(locals);
+	return;
+    }
+
+    choice = choose(14);
+
+    if (choice < 10) {
+	expression(depth - 1, locals);
+	_out += " ";
+	_out += binary[choose(sizeof(binary) / sizeof(binary[0]))];
+	_out += " ";
+	expression(choose(depth), locals);
+
+    } else if (choice < 12) {
+	_out += choice == 10 ? "- " : "!";
+	expression(depth - 1, locals);
+
+    } else if (choice == 12 && (v = pick(INTEGER, locals)) != nullptr)
+	_out += "sizeof " + v->name;
+
+    else {
+	_out += "(";
+	expression(depth - 1, locals);
+	_out += ")";
+    }
+}
+
+
+/*
+ * Function:	Generator::error (private)
+ *
+ * Description:	Write a statement with an error.
+ */
+
+void Generator::error(const vector<Variable> &locals, const string &indent)
+{
+    const Variable *v;
+
+
+    _out += indent;
+
+    if (choose(3) == 0)
+	_out += identifier('u') + " = 1;\n";
+    else if (choose(2) == 0 || (v = pick(POINTER, locals)) == nullptr)
+	_out += "&" + to_string(choose(10)) + ";\n";
+    else
+	_out += v->name + " = " + v->name + " + " + v->name + ";\n";
+}
+
+
+/*
+ * Function:	Generator::text (private)
+ *
+ * Description:	Write a string literal of the requested size.
+ */
+
+void Generator::text()
+{
+    _out += "\"";
+
+    for (unsigned i = 0; i < _knobs.literal; i ++) {
+	_out += 'a' + i % 26;
+	flush();
+    }
+
+    _out += "\"";
+}
+
+
+/*
+ * Function:	Generator::statement (private)
+ *
+ * Description:	Write a statement other than a block.
+ */
+
+void Generator::statement(const vector<Variable> &locals, const string &indent)
+{
+    const Variable *target, *pointer;
+    unsigned choice = choose(8);
+
+
+    if (faulty()) {
+	error(locals, indent);
+	return;
+    }
+
+    if ((target = pick(INTEGER, locals)) == nullptr) {
+	_out += indent;
+	expression(_knobs.expression, locals);
+	_out += ";\n";
+	return;
+    }
+
+    _out += indent;
+
+    if (choice == 0) {
+	_out += "if (";
+	expression(_knobs.expression, locals);
+	_out += ") " + target->name + " = 1; else " + target->name + " = 0;\n";
+
+    } else if (choice == 1) {
+	_out += "while (" + target->name + " > 0) " + target->name + " = " + target->name + " - 1;\n";
+
+    } else if (choice == 2) {
+	_out += "for (" + target->name + " = 0; " + target->name + " < 10; ";
+	_out += target->name + " = " + target->name + " + 1) ";
+	expression(_knobs.expression, locals);
+	_out += ";\n";
+
+    } else if (choice == 3 && (pointer = pick(TEXT, locals)) != nullptr) {
+	_out += pointer->name + " = ";
+	text();
+	_out += ";\n";
+
+    } else if (choice == 4 && !_functions.empty()) {
+	auto &f = _functions[choose(_functions.size())];
+	_out += target->name + " = " + f.first + "(";
+
+	for (unsigned i = 0; i < f.second; i ++) {
+	    _out += i > 0 ? ", " : "";
+	    expression(_knobs.expression, locals);
+	}
+
+	_out += ");\n";
+
+    } else if (choice == 5 && (pointer = pick(ARRAY, locals)) != nullptr) {
+	_out += pointer->name + "[" + to_string(choose(10)) + "] = ";
+	expression(_knobs.expression, locals);
+	_out += ";\n";
+
+    } else {
+	_out += target->name + " = ";
+	expression(_knobs.expression, locals);
+	_out += ";\n";
+    }
+}
+
+
+/*
+ * Function:	Generator::block (private)
+ *
+ * Description:	Write the declarations and statements of a block at the
+ *		given level, including the nested blocks below it.  A
+ *		deeply nested block is indented no further, so that the
+ *		size of the output grows only with the depth.
+ */
+
+void Generator::block(unsigned level, vector<Variable> &locals)
+{
+    size_t mark = locals.size();
+    string indent(level < 16 ? level + 1 : 16, '\t');
+
+
+    if (level > 0 && choose(2) == 0)
+	declaration(locals, indent.c_str());
+
+    for (unsigned i = 0; i < _knobs.statements; i ++) {
+	statement(locals, indent);
+	flush();
+    }
+
+    if (level < _knobs.depth) {
+	_out += indent + "{\n";
+	block(level + 1, locals);
+	_out += indent + "}\n";
+    }
+
+    locals.resize(mark);
+}
+
+
+/*
+ * Function:	Generator::chain (private)
+ *
+ * Description:	Write an assignment of a long chain of || to the given
+ *		variable.
+ */
+
+void Generator::chain(const string &target, const vector<Variable> &locals)
+{
+    _out += "\t" + target + " = ";
+
+    for (unsigned i = 0; i < _knobs.chain; i ++) {
+	if (i > 0)
+	    _out += i % 8 == 0 ? " ||\n\t    " : " || ";
+
+	leaf(locals);
+	flush();
+    }
+
+    _out += ";\n";
+}
+
+
+/*
+ * Function:	Generator::function (private)
+ *
+ * Description:	Write a function with a random number of parameters, all
+ *		of type int, which starts by assigning a string literal.
+ */
+
+void Generator::function()
+{
+    string name = identifier('f');
+    vector<Variable> locals;
+    unsigned n = choose(4);
+
+
+    if (faulty() && !_functions.empty())
+	name = _functions[choose(_functions.size())].first;
+
+    _out += "int " + name + "(";
+
+    for (unsigned i = 0; i < n; i ++) {
+	locals.push_back(Variable {identifier('a'), INTEGER});
+	_out += (i > 0 ? ", int " : "int ") + locals.back().name;
+    }
+
+    _out += n == 0 ? "void)\n{\n" : ")\n{\n";
+    locals.push_back(Variable {identifier('v'), INTEGER});
+    _out += "\tint " + locals.back().name + ";\n";
+
+    if (!_globals.empty() && _globals.back().kind == TEXT) {
+	_out += "\t" + _globals.back().name + " = ";
+	text();
+	_out += ";\n";
+    }
+
+    block(0, locals);
+
+    if (_knobs.chain > 0)
+	chain(locals.back().name, locals);
+
+    _out += "\treturn ";
+    expression(_knobs.expression, locals);
+    _out += ";\n}\n\n";
+
+    _functions.emplace_back(name, n);
+    flush();
+}
+
+
+/*
+ * Function:	Generator::write
+ *
+ * Description:	Write the translation unit of the shape given by the knobs
+ *		to the given stream.  Writing again writes the same unit.
+ */
+
+void Generator::write(ostream &stream)
+{
+    _stream = &stream;
+    _state = _knobs.seed;
+    _counter = 0;
+    _out.clear();
+    _globals.clear();
+    _functions.clear();
+
+    for (unsigned i = 0; i < _knobs.globals; i ++) {
+	declaration(_globals, "");
+	flush();
+    }
+
+    if (_knobs.functions > 0 && _knobs.globals > 0) {
+	_out += "char *";
+	_globals.push_back(Variable {identifier('s'), TEXT});
+	_out += _globals.back().name + ";\n";
+    }
+
+    _out += "\n";
+
+    for (unsigned i = 0; i < _knobs.functions; i ++)
+	function();
+
+    flush(true);
+    _stream = nullptr;
+}
+
+
+/*
+ * Function:	Generator::generate
+ *
+ * Description:	Return the translation unit of the shape given by the
+ *		knobs.
+ */
+
+string Generator::generate()
+{
+    ostringstream s;
+
+
+    write(s);
+    return s.str();
+}
+
+
+/*
+ * Function:	Generator::preset
+ *
+ * Description:	Set the given knobs for the named preset.  Return whether
+ *		the preset exists.
+ */
+
+bool Generator::preset(const string &name, Knobs &knobs)
+{
+    if (name == "globals") {
+	knobs.globals = 1000000;
+	knobs.functions = 0;
+	knobs.declarators = 1;
+    } else if (name == "deep") {
+	knobs.globals = 1;
+	knobs.functions = 1;
+	knobs.depth = 10000;
+	knobs.statements = 1;
+	knobs.expression = 1;
+    } else if (name == "or-chain") {
+	knobs.globals = 10;
+	knobs.functions = 1;
+	knobs.chain = 100000;
+    } else if (name == "string") {
+	knobs.globals = 1;
+	knobs.functions = 1;
+	knobs.depth = 0;
+	knobs.statements = 1;
+	knobs.literal = 100 << 20;
+    } else
+	return false;
+
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * File:	Generator.h
+ *
+ * Description:	This file contains the class definition for the workload
+ *		generator for Simple C, which writes a translation unit of
+ *		the shape given by its knobs.  The same knobs, including
+ *		the seed, always give the same translation unit, so a
+ *		problem found with one can be reproduced anywhere, and the
+ *		generator program, the benchmarks, and the tests all share
+ *		the same workloads.
+ *
+ *		Without errors, the translation unit checks cleanly.  Every
+ *		expression has type int, and each block nests exactly one
+ *		block, so the size grows with the depth and not
+ *		exponentially.  Array elements are only ever assigned, and
+ *		calls are only ever assigned too, since the checker gives
+ *		an indexed array the type of a pointer and a call the type
+ *		of the function.  The errors are undeclared identifiers, bad
+ *		operands, void and conflicting globals, and redefinitions.
+ */
+
+# ifndef GENERATOR_H
+# define GENERATOR_H
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <ostream>
+
+class Generator {
+public:
+    struct Knobs {
+	uint64_t seed = 1;
+	unsigned globals = 100, functions = 100;
+	unsigned depth = 3, expression = 4, declarators = 3;
+	unsigned identifier = 1, literal = 16, statements = 4, chain = 0;
+	double errors = 0;		/* fraction of constructs with an error */
+    };
+
+private:
+    typedef std::string string;
+
+    enum { INTEGER, POINTER, ARRAY, TEXT };
+
+    struct Variable {
+	string name;
+	int kind;
+    };
+
+    Knobs _knobs;
+    uint64_t _state;
+    string _out;
+    unsigned _counter;
+    std::ostream *_stream;
+    std::vector<Variable> _globals;
+    std::vector<std::pair<string, unsigned>> _functions;
+
+    void flush(bool always = false);
+    unsigned choose(unsigned bound);
+    bool faulty();
+    string identifier(char prefix);
+    void declarator(int kind, std::vector<Variable> &list);
+    void declaration(std::vector<Variable> &list, const char *indent);
+    const Variable *pick(int kind, const std::vector<Variable> &locals);
+    void leaf(const std::vector<Variable> &locals);
+    void expression(unsigned depth, const std::vector<Variable> &locals);
+    void error(const std::vector<Variable> &locals, const string &indent);
+    void text();
+    void statement(const std::vector<Variable> &locals, const string &indent);
+    void block(unsigned level, std::vector<Variable> &locals);
+    void chain(const string &target, const std::vector<Variable> &locals);
+    void function();
+
+public:
+    Generator(const Knobs &knobs);
+
+    void write(std::ostream &stream);
+    string generate();
+
+    static bool preset(const string &name, Knobs &knobs);
+};
+
+# endif /* GENERATOR_H */
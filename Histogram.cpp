@@ -0,0 +1,154 @@
+/*
+ * File:	Histogram.cpp
+ *
+ * Description:	This file contains the member function definitions for a
+ *		histogram of latencies.
+ *
+ *		A value v of at least 128 has an exponent e, the number of
+ *		low bits that must be dropped to leave a seven-bit value s
+ *		whose top bit is set.  It goes in bucket 64 * e + s, which
+ *		follows directly on from the buckets of the values below
+ *		it, and the bucket holds the values s << e up to but not
+ *		including (s + 1) << e.
+ */
+
+# include "Histogram.h"
+
+using namespace std;
+
+
+/*
+ * Function:	bucket
+ *
+ * Description:	Return the bucket of the given value.
+ */
+
+static unsigned bucket(uint64_t value)
+{
+    unsigned e;
+
+
+    if (value < 128)
+	return value;
+
+    e = 64 - __builtin_clzll(value) - 7;
+    return 64 * e + (value >> e);
+}
+
+
+/*
+ * Function:	highest
+ *
+ * Description:	Return the highest value in the given bucket.
+ */
+
+static uint64_t highest(unsigned bucket)
+{
+    unsigned e;
+
+
+    if (bucket < 128)
+	return bucket;
+
+    e = bucket / 64 - 1;
+    return ((uint64_t) (bucket - 64 * e + 1) << e) - 1;
+}
+
+
+/*
+ * Function:	Histogram::Histogram (constructor)
+ *
+ * Description:	Initialize this histogram with no values.
+ */
+
+Histogram::Histogram()
+    : _total(0), _sum(0), _max(0)
+{
+    for (unsigned i = 0; i < BUCKETS; i ++)
+	_counts[i] = 0;
+}
+
+
+/*
+ * Function:	Histogram::record
+ *
+ * Description:	Record the given value.
+ */
+
+void Histogram::record(uint64_t value)
+{
+    uint64_t max = _max.load(memory_order_relaxed);
+
+
+    _counts[bucket(value)].fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(value, memory_order_relaxed);
+    _total.fetch_add(1, memory_order_relaxed);
+
+    while (value > max && !_max.compare_exchange_weak(max, value, memory_order_relaxed))
+	continue;
+}
+
+
+/*
+ * Function:	Histogram::percentile
+ *
+ * Description:	Return the value that the given fraction of the values are
+ *		at or below, as the highest value of its bucket, but never
+ *		more than the largest value recorded.
+ */
+
+uint64_t Histogram::percentile(double p) const
+{
+    uint64_t total = _total.load(memory_order_relaxed), seen = 0, rank;
+
+
+    if (total == 0)
+	return 0;
+
+    rank = p * total + 0.5;
+
+    if (rank == 0)
+	rank = 1;
+
+    for (unsigned i = 0; i < BUCKETS; i ++)
+	if ((seen += _counts[i].load(memory_order_relaxed)) >= rank)
+	    return highest(i) < max() ? highest(i) : max();
+
+    return max();
+}
+
+
+/*
+ * Function:	Histogram::count (accessor)
+ *
+ * Description:	Return the number of values recorded.
+ */
+
+uint64_t Histogram::count() const
+{
+    return _total.load(memory_order_relaxed);
+}
+
+
+/*
+ * Function:	Histogram::sum (accessor)
+ *
+ * Description:	Return the sum of the values recorded.
+ */
+
+uint64_t Histogram::sum() const
+{
+    return _sum.load(memory_order_relaxed);
+}
+
+
+/*
+ * Function:	Histogram::max (accessor)
+ *
+ * Description:	Return the largest value recorded.
+ */
+
+uint64_t Histogram::max() const
+{
+    return _max.load(memory_order_relaxed);
+}
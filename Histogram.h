@@ -0,0 +1,36 @@
+/*
+ * File:	Histogram.h
+ *
+ * Description:	This file contains the class definition for a histogram of
+ *		latencies in the style of HdrHistogram.  Values below 128
+ *		each have a bucket of their own, and above that every
+ *		power of two is divided into 64 buckets, so that any value
+ *		is known to within 1.6% however large it is, in a fixed
+ *		amount of space.  Values are recorded with atomic counts,
+ *		so that many threads may record at once without a lock.
+ */
+
+# ifndef HISTOGRAM_H
+# define HISTOGRAM_H
+# include <atomic>
+# include <cstdint>
+
+class Histogram {
+public:
+    static const unsigned BUCKETS = 64 * 59;
+
+private:
+    std::atomic<uint64_t> _counts[BUCKETS];
+    std::atomic<uint64_t> _total, _sum, _max;
+
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    uint64_t percentile(double p) const;
+    uint64_t count() const;
+    uint64_t sum() const;
+    uint64_t max() const;
+};
+
+# endif /* HISTOGRAM_H */
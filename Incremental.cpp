@@ -0,0 +1,616 @@
+/*
+ * File:	Incremental.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		incremental checking in Simple C.
+ *
+ *		Types are kept as short strings, so that a unit owns no
+ *		parameter lists and two types are the same exactly when
+ *		their strings are.  An absent symbol is the empty string.
+ */
+
+# include <cstdlib>
+# include <cstring>
+# include <algorithm>
+# include "Incremental.h"
+# include "checker.h"
+# include "lexer.h"
+# include "tokens.h"
+# include "Cache.h"
+
+using namespace std;
+
+
+/*
+ * Function:	encode
+ *
+ * Description:	Append the string for the given type to the given string.
+ */
+
+static void encode(const Type &type, string &s)
+{
+    if (type.isError()) {
+	s += "E;";
+	return;
+    }
+
+    s += type.isArray() ? 'A' : type.isFunction() ? 'F' : 'S';
+    s += to_string(type.specifier()) + ',' + to_string(type.indirection());
+
+    if (type.isArray())
+	s += ',' + to_string(type.length());
+
+    else if (type.isFunction()) {
+	if (type.parameters() == nullptr)
+	    s += '?';
+	else {
+	    s += '(';
+
+	    for (auto &param : *type.parameters())
+		encode(param, s);
+
+	    s += ')';
+	}
+    }
+
+    s += ';';
+}
+
+
+/*
+ * Function:	decode
+ *
+ * Description:	Return the type whose string starts at the given pointer,
+ *		and advance the pointer past it.
+ */
+
+static Type decode(const char *&p)
+{
+    Parameters *params;
+    unsigned indirection;
+    int specifier;
+    char *end;
+    Type type;
+
+
+    if (*p == 'E') {
+	p += 2;
+	return Type();
+    }
+
+    char kind = *p ++;
+    specifier = strtol(p, &end, 10);
+    indirection = strtoul(end + 1, &end, 10);
+    p = end;
+
+    if (kind == 'A') {
+	type = Type(specifier, indirection, (unsigned) strtoul(p + 1, &end, 10));
+	p = end;
+
+    } else if (kind == 'F') {
+	if (*p ++ == '?')
+	    type = Type(specifier, indirection, nullptr);
+	else {
+	    params = new Parameters();
+
+	    while (*p != ')')
+		params->push_back(decode(p));
+
+	    p ++;
+	    type = Type(specifier, indirection, params);
+	}
+
+    } else
+	type = Type(specifier, indirection);
+
+    p ++;
+    return type;
+}
+
+
+/*
+ * Function:	Incremental::signature
+ *
+ * Description:	Return the string for the type of the given symbol, which
+ *		is empty if there is no symbol.
+ */
+
+string Incremental::signature(const Symbol *symbol)
+{
+    string s;
+
+
+    if (symbol != nullptr)
+	encode(symbol->type(), s);
+
+    return s;
+}
+
+
+/*
+ * Function:	Incremental::Incremental (constructor)
+ *
+ * Description:	Initialize this engine as having checked nothing.
+ */
+
+Incremental::Incremental()
+    : _cursor(0), _buf(nullptr), _length(0), _active(false), _start(0),
+      _line(0), _diagnostics(nullptr), _replayed(0), _checked(0),
+      _generation(0), _edited(false), _replaced(false), _shifting(false),
+      _offset(0), _removed(0), _inserted(0)
+{
+}
+
+
+/*
+ * Function:	Incremental::head (private)
+ *
+ * Description:	Return the first N bytes of the given text, at most eight,
+ *		as a number.  Units are indexed by their heads.
+ */
+
+uint64_t Incremental::head(const char *p, size_t n)
+{
+    uint64_t value = 0;
+
+
+    memcpy(&value, p, n < sizeof(value) ? n : sizeof(value));
+    return value;
+}
+
+
+/*
+ * Function:	Incremental::edit
+ *
+ * Description:	Note that the given number of bytes at the given offset of
+ *		the buffer have been replaced by the given number of bytes
+ *		since it was last checked.  The edits noted before the next
+ *		check are combined into one that spans them all.
+ */
+
+void Incremental::edit(size_t offset, size_t removed, size_t inserted)
+{
+    size_t low, high;
+
+
+    if (!_edited) {
+	_edited = true;
+	_offset = offset;
+	_removed = removed;
+	_inserted = inserted;
+	return;
+    }
+
+    low = min(_offset, offset);
+    high = max(_offset + _inserted, offset + removed);
+
+    _removed = high - _inserted + _removed - low;
+    _inserted = high - removed + inserted - low;
+    _offset = low;
+}
+
+
+/*
+ * Function:	Incremental::replace
+ *
+ * Description:	Note that the buffer may have changed anywhere since it was
+ *		last checked, whatever edits are noted before the next
+ *		check.
+ */
+
+void Incremental::replace()
+{
+    _replaced = true;
+}
+
+
+/*
+ * Function:	Incremental::begin
+ *
+ * Description:	Start checking the given buffer.  The units of the last
+ *		check become the candidates for replay, and any edit noted
+ *		since then is applied to them.
+ */
+
+void Incremental::begin(const char *buf, size_t length)
+{
+    _previous.clear();
+    _previous.swap(_units);
+    _index.clear();
+
+    _shifting = _edited && !_replaced;
+    _edited = _replaced = false;
+    _generation ++;
+
+    for (size_t i = 0; i < _previous.size(); i ++)
+	_index.emplace(_previous[i].prefix, i);
+
+    _cursor = 0;
+    _buf = buf;
+    _length = length;
+    _active = false;
+    _replayed = _checked = 0;
+}
+
+
+/*
+ * Function:	Incremental::unchanged (private)
+ *
+ * Description:	Return whether the text of the given unit is known to be at
+ *		the given offset without reading it: the unit must have
+ *		been seen by the last check, and lie wholly before or after
+ *		the edit noted since, which moved it to the offset.
+ */
+
+bool Incremental::unchanged(const Unit &unit, size_t start) const
+{
+    if (!_shifting || unit.generation + 1 != _generation)
+	return false;
+
+    if (unit.start + unit.length <= _offset)
+	return start == unit.start;
+
+    if (unit.start >= _offset + _removed)
+	return start == unit.start - _removed + _inserted;
+
+    return false;
+}
+
+
+/*
+ * Function:	Incremental::matches (private)
+ *
+ * Description:	Return whether the given unit may be replayed at the given
+ *		offset: its text must be there, and each name it consulted
+ *		must have the same type in the outermost scope as it did.
+ *		A unit already replayed has no text.
+ */
+
+bool Incremental::matches(const Unit &unit, size_t start, Scope *outermost) const
+{
+    if (unit.length == 0 || unit.broken || start + unit.length > _length)
+	return false;
+
+    if (unit.last && start + unit.length != _length)
+	return false;
+
+    if (!unchanged(unit, start)) {
+	if (head(_buf + start, unit.length) != unit.prefix)
+	    return false;
+
+	if (fingerprint(_buf + start, unit.length) != unit.fingerprint)
+	    return false;
+    }
+
+    for (auto &use : unit.uses)
+	if (signature(outermost->find(use.first)) != use.second)
+	    return false;
+
+    return true;
+}
+
+
+/*
+ * Function:	Incremental::emit
+ *
+ * Description:	Write the symbols and errors of the given unit, which is
+ *		now on the given line, to the current output and
+ *		diagnostics.
+ */
+
+void Incremental::emit(const Unit &unit, int line)
+{
+    const char *p;
+    Type type;
+
+
+    for (auto &w : unit.writes) {
+	p = w.second.c_str();
+	type = decode(p);
+	output->write(w.first, type);
+
+	if (type.isFunction())
+	    delete type.parameters();
+    }
+
+    for (auto &e : unit.errors) {
+	*diagnostics << "line " << line + e.first << ": " << e.second << endl;
+	numerrors ++;
+    }
+}
+
+
+/*
+ * Function:	Incremental::bind
+ *
+ * Description:	Give the named symbol in the given outermost scope the
+ *		type with the given string, removing it if the string is
+ *		empty.
+ */
+
+void Incremental::bind(Scope *outermost, const string &name, const string &type)
+{
+    Symbol *symbol = outermost->find(name);
+    const char *p = type.c_str();
+
+
+    if (signature(symbol) == type)
+	return;
+
+    if (symbol != nullptr) {
+	outermost->remove(name);
+	delete symbol;
+    }
+
+    if (!type.empty())
+	outermost->insert(new Symbol(name, decode(p)));
+}
+
+
+/*
+ * Function:	Incremental::replay
+ *
+ * Description:	Replay a unit of the last check at the given offset, which
+ *		is on the given line, if one may be.  The lexer is moved
+ *		past it, and the token that follows it is returned.  Return
+ *		whether a unit was replayed.
+ *
+ *		The unit after the last one replayed is tried first, since
+ *		an edit usually leaves the units around it in order.
+ */
+
+bool Incremental::replay(size_t start, int line, Scope *outermost, int &token, string &lexeme)
+{
+    size_t i, n;
+
+
+    i = _previous.size();
+
+    if (_cursor < _previous.size() && matches(_previous[_cursor], start, outermost))
+	i = _cursor;
+
+    else {
+	n = _length - start;
+	auto range = _index.equal_range(head(_buf + start, n));
+
+	for (auto it = range.first; it != range.second; ++ it)
+	    if (matches(_previous[it->second], start, outermost)) {
+		i = it->second;
+		break;
+	    }
+    }
+
+    if (i == _previous.size())
+	return false;
+
+    Unit &unit = _previous[i];
+    emit(unit, line);
+
+    for (auto &d : unit.defines)
+	bind(outermost, d.first, d.second);
+
+    unit.start = start;
+    unit.line = line;
+    unit.generation = _generation;
+    token = unit.token;
+    lexeme = unit.lexeme;
+    lexseek(start + unit.next, start + unit.end, line + unit.lines, unit.trail);
+
+    _units.push_back(move(unit));
+    unit.length = 0;
+    _cursor = i + 1;
+    _replayed ++;
+    return true;
+}
+
+
+/*
+ * Function:	Incremental::enter
+ *
+ * Description:	Start recording a unit at the given offset, which is on
+ *		the given line.  Its errors are held until it is left.
+ */
+
+void Incremental::enter(size_t start, int line)
+{
+    _unit = Unit();
+    _used.clear();
+    _defined.clear();
+
+    _active = true;
+    _start = start;
+    _line = line;
+
+    _unit.start = start;
+    _unit.line = line;
+    _unit.lead = line - lexline();
+    _unit.broken = false;
+    _unit.generation = _generation;
+
+    _stream.str("");
+    _diagnostics = diagnostics;
+    diagnostics = &_stream;
+    _checked ++;
+}
+
+
+/*
+ * Function:	Incremental::record (private)
+ *
+ * Description:	Finish recording the current unit, which ends where the
+ *		lexer is now.  Its errors are passed on.  An error may span
+ *		lines if it quotes a lexeme with a newline, so each runs up
+ *		to the start of the next.
+ */
+
+void Incremental::record(Scope *outermost)
+{
+    string text = _stream.str();
+    string::size_type line, colon, end;
+    size_t position = lexpos();
+
+
+    diagnostics = _diagnostics;
+    *diagnostics << text;
+    _active = false;
+
+    for (line = 0; line < text.size(); line = end + 1) {
+	end = text.find("\nline ", line);
+	end = end == string::npos ? text.size() - 1 : end;
+	colon = text.find(": ", line);
+	_unit.errors.emplace_back(atoi(text.c_str() + line + 5) - _line,
+	    text.substr(colon + 2, end - colon - 2));
+    }
+
+    _unit.end = position - _start;
+    _unit.next = lexstart() - _start;
+    _unit.last = position == _length;
+    _unit.length = _unit.last ? _unit.end : _unit.end + 1;
+    _unit.lines = lineno - _line;
+    _unit.trail = lineno - lexline();
+    _unit.prefix = head(_buf + _start, _unit.length);
+    _unit.fingerprint = fingerprint(_buf + _start, _unit.length);
+
+    for (auto &name : _defined)
+	_unit.defines.emplace_back(name, signature(outermost->find(name)));
+}
+
+
+/*
+ * Function:	Incremental::leave
+ *
+ * Description:	Finish recording the current unit, which is followed by
+ *		the given token.
+ */
+
+void Incremental::leave(Scope *outermost, int token, const string &lexeme)
+{
+    record(outermost);
+    _unit.token = token;
+    _unit.lexeme = lexeme;
+    _units.push_back(move(_unit));
+}
+
+
+/*
+ * Function:	Incremental::abandon
+ *
+ * Description:	Give up on the current check, in the given outermost
+ *		scope.  The unit being recorded is kept as broken, and the
+ *		units of the last check that were not replayed are kept
+ *		after it for next time.
+ */
+
+void Incremental::abandon(Scope *outermost)
+{
+    if (_active) {
+	record(outermost);
+	_unit.broken = true;
+	_unit.token = DONE;
+	_units.push_back(move(_unit));
+    }
+
+    keep();
+}
+
+
+/*
+ * Function:	Incremental::keep
+ *
+ * Description:	Keep the units of the last check that were not replayed,
+ *		after those of this one, as candidates for the next.  An
+ *		abandoned unit is never replayed, so it is not kept.
+ */
+
+void Incremental::keep()
+{
+    for (auto &unit : _previous)
+	if (unit.length != 0 && !unit.broken)
+	    _units.push_back(move(unit));
+
+    _previous.clear();
+}
+
+
+/*
+ * Function:	Incremental::use
+ *
+ * Description:	Note that the current unit consulted the given global
+ *		name, which has the given symbol in the outermost scope.
+ *		Only the first use of each name matters, since anything
+ *		after that is up to the unit itself.
+ */
+
+void Incremental::use(const string &name, const Symbol *symbol)
+{
+    if (_active && _used.insert(name).second)
+	_unit.uses.emplace_back(name, signature(symbol));
+}
+
+
+/*
+ * Function:	Incremental::define
+ *
+ * Description:	Note that the current unit is about to declare the given
+ *		global name, which now has the given symbol.
+ */
+
+void Incremental::define(const string &name, const Symbol *symbol)
+{
+    use(name, symbol);
+
+    if (_active)
+	_defined.insert(name);
+}
+
+
+/*
+ * Function:	Incremental::write
+ *
+ * Description:	Note that the current unit wrote the given symbol.
+ */
+
+void Incremental::write(const string &name, const Type &type)
+{
+    if (_active) {
+	_unit.writes.emplace_back(name, string());
+	encode(type, _unit.writes.back().second);
+    }
+}
+
+
+/*
+ * Function:	Incremental::replayed (accessor)
+ *
+ * Description:	Return the number of units replayed by the last check.
+ */
+
+unsigned Incremental::replayed() const
+{
+    return _replayed;
+}
+
+
+/*
+ * Function:	Incremental::units (accessor)
+ *
+ * Description:	Return the units recorded or replayed by the last check,
+ *		in order, which become the candidates for the next.
+ */
+
+vector<Incremental::Unit> &Incremental::units()
+{
+    return _units;
+}
+
+
+/*
+ * Function:	Incremental::checked (accessor)
+ *
+ * Description:	Return the number of units checked by the last check.
+ */
+
+unsigned Incremental::checked() const
+{
+    return _checked;
+}
@@ -0,0 +1,126 @@
+/*
+ * File:	Incremental.h
+ *
+ * Description:	This file contains the class definition for incremental
+ *		checking in Simple C.  A translation unit is a series of
+ *		globals and functions, each of which we call a unit here.
+ *		While a unit is checked, we note the text it spans, each
+ *		global name it consults along with the type that name had
+ *		at the time, the global names it declares or defines, the
+ *		symbols it writes, and the errors it reports.
+ *
+ *		When the same engine later checks an edited buffer, a unit
+ *		whose text is unchanged and whose consulted names still
+ *		have the same types is simply replayed: its symbols and
+ *		errors are written again, its declarations are applied to
+ *		the outermost scope, and the lexer skips over its text.
+ *		Only the units that were edited, or that depend on a global
+ *		whose type changed, are checked again.
+ *
+ *		The text of a unit runs from its first token through the
+ *		token after it, which the parser has already read when the
+ *		unit ends, and the character after that, which the lexer
+ *		has read to end that token.  The lines of its errors are
+ *		kept relative to the unit, so a unit that merely moves is
+ *		still replayed.  A unit that is abandoned is kept, with
+ *		whatever it did before it was abandoned, but is never
+ *		replayed.
+ *
+ *		A caller that knows how the buffer was edited since the
+ *		last check may say so before checking it again.  A unit
+ *		of the last check that lies wholly outside the edit is
+ *		then known to be unchanged where the edit moved it, and
+ *		its text need not be read again, so a check reads only
+ *		the text near the edit and the units it checks.
+ */
+
+# ifndef INCREMENTAL_H
+# define INCREMENTAL_H
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+# include <sstream>
+# include <unordered_map>
+# include <unordered_set>
+# include "Scope.h"
+
+class Incremental {
+    typedef std::string string;
+    typedef std::vector<std::pair<string, string>> Bindings;
+
+public:
+    struct Unit {
+	size_t start;		/* offset of the unit when last seen */
+	int line, lead;		/* line after its first token, and the lines
+				   within that token */
+	bool broken;		/* whether the unit was abandoned */
+	unsigned generation;	/* the check that last saw the unit */
+	uint64_t prefix;	/* head of the text */
+	uint64_t fingerprint;	/* fingerprint of the text */
+	size_t length;		/* length of the text */
+	size_t next, end;	/* offsets of the next token and character */
+	bool last;		/* whether the text ends the buffer */
+	int lines;		/* lines from the start to the end */
+	int trail;		/* lines within the next token */
+	int token;		/* the next token and its lexeme */
+	string lexeme;
+	Bindings uses;		/* names consulted, with their types */
+	Bindings defines;	/* names declared, with their final types */
+	Bindings writes;	/* symbols written */
+	std::vector<std::pair<int, string>> errors;
+    };
+
+private:
+    std::vector<Unit> _units, _previous;
+    std::unordered_multimap<uint64_t, size_t> _index;
+    size_t _cursor;
+
+    const char *_buf;
+    size_t _length;
+
+    Unit _unit;
+    bool _active;
+    size_t _start;
+    int _line;
+    std::unordered_set<string> _used, _defined;
+    std::ostream *_diagnostics;
+    std::ostringstream _stream;
+
+    unsigned _replayed, _checked;
+
+    unsigned _generation;
+    bool _edited, _replaced, _shifting;
+    size_t _offset, _removed, _inserted;
+
+    static uint64_t head(const char *p, size_t n);
+    bool unchanged(const Unit &unit, size_t start) const;
+    bool matches(const Unit &unit, size_t start, Scope *outermost) const;
+    void record(Scope *outermost);
+
+public:
+    Incremental();
+
+    void edit(size_t offset, size_t removed, size_t inserted);
+    void replace();
+    void begin(const char *buf, size_t length);
+    bool replay(size_t start, int line, Scope *outermost, int &token, string &lexeme);
+    void enter(size_t start, int line);
+    void leave(Scope *outermost, int token, const string &lexeme);
+    void abandon(Scope *outermost);
+    void keep();
+
+    void use(const string &name, const Symbol *symbol);
+    void define(const string &name, const Symbol *symbol);
+    void write(const string &name, const Type &type);
+
+    unsigned replayed() const;
+    unsigned checked() const;
+    std::vector<Unit> &units();
+
+    static string signature(const Symbol *symbol);
+    static void bind(Scope *outermost, const string &name, const string &type);
+    static void emit(const Unit &unit, int line);
+};
+
+# endif /* INCREMENTAL_H */
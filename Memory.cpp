@@ -0,0 +1,152 @@
+/*
+ * File:	Memory.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		accounting for the memory allocated while checking a
+ *		translation unit.
+ *
+ *		The accounting is kept by the allocation functions
+ *		themselves, so nothing here may allocate until the report
+ *		is written.
+ */
+
+# include <iomanip>
+# include <sys/resource.h>
+# include "Memory.h"
+
+using namespace std;
+
+thread_local Memory *memory;
+thread_local int subsystem;
+
+static const char *subsystems[] = {
+    "other", "lexemes", "symbols", "scopes", "parameters", "output",
+};
+
+
+/*
+ * Function:	Memory::Memory (constructor)
+ *
+ * Description:	Initialize this accounting with nothing allocated.
+ */
+
+Memory::Memory()
+    : _total(0), _highest(0), _scopes(0)
+{
+    for (int i = 0; i < SUBSYSTEMS; i ++)
+	_live[i] = _peak[i] = _count[i] = 0;
+}
+
+
+/*
+ * Function:	Memory::Tag::Tag (constructor)
+ *
+ * Description:	Make the given subsystem the one that the calling thread
+ *		is allocating for, for the lifetime of this tag.
+ */
+
+Memory::Tag::Tag(Subsystem s)
+    : _previous(subsystem)
+{
+    subsystem = s;
+}
+
+
+/*
+ * Function:	Memory::Tag::~Tag (destructor)
+ *
+ * Description:	Restore the subsystem that was being allocated for.
+ */
+
+Memory::Tag::~Tag()
+{
+    subsystem = _previous;
+}
+
+
+/*
+ * Function:	Memory::allocate
+ *
+ * Description:	Count an allocation of the given size for the given
+ *		subsystem.
+ */
+
+void Memory::allocate(size_t size, int subsystem)
+{
+    _count[subsystem] ++;
+    _live[subsystem] += size;
+    _total += size;
+
+    if (_live[subsystem] > _peak[subsystem])
+	_peak[subsystem] = _live[subsystem];
+
+    if (_total > _highest)
+	_highest = _total;
+}
+
+
+/*
+ * Function:	Memory::release
+ *
+ * Description:	Count the release of an allocation of the given size for
+ *		the given subsystem.
+ */
+
+void Memory::release(size_t size, int subsystem)
+{
+    _live[subsystem] -= size;
+    _total -= size;
+}
+
+
+/*
+ * Function:	Memory::scope
+ *
+ * Description:	Count a scope being created or destroyed.
+ */
+
+void Memory::scope(int delta)
+{
+    _scopes += delta;
+}
+
+
+/*
+ * Function:	Memory::write
+ *
+ * Description:	Write this accounting to the given stream, for an input of
+ *		the given number of lines.  The peak of all subsystems
+ *		together is less than the sum of their peaks, since they
+ *		need not peak at once.
+ */
+
+void Memory::write(ostream &out, unsigned lines) const
+{
+    struct rusage usage;
+
+
+    out << left << setw(12) << "subsystem" << right << setw(14) << "allocations";
+    out << setw(14) << "live bytes" << setw(14) << "peak bytes" << endl;
+
+    for (int i = 0; i < SUBSYSTEMS; i ++) {
+	out << left << setw(12) << subsystems[i] << right << setw(14) << _count[i];
+	out << setw(14) << _live[i] << setw(14) << _peak[i] << endl;
+    }
+
+    out << left << setw(12) << "total" << right << setw(14) << "";
+    out << setw(14) << _total << setw(14) << _highest << endl << endl;
+
+    if (lines > 0) {
+	out << fixed << setprecision(1);
+	out << "peak heap per line: " << (double) _highest / lines << " bytes over ";
+	out << lines << " lines" << endl;
+    }
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+	out << "peak resident set: " << usage.ru_maxrss << " KiB" << endl;
+
+    if (_scopes > 0) {
+	out << "leaked scopes: " << _scopes << " never freed, holding ";
+	out << _live[SCOPES] << " bytes with their symbol lists" << endl;
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * File:	Memory.h
+ *
+ * Description:	This file contains the class definition for accounting for
+ *		the memory allocated while checking a translation unit.
+ *		Each thread names the subsystem it is allocating for with
+ *		a tag that lasts as long as the tag does, and the
+ *		allocations of the calling thread are counted against that
+ *		subsystem if an accounting is being kept.
+ *
+ *		The library only names the subsystems.  Nothing is counted
+ *		unless the program replaces the global allocation
+ *		functions with ones that call allocate and release, which
+ *		a library must not do behind the back of its users.
+ */
+
+# ifndef MEMORY_H
+# define MEMORY_H
+# include <cstddef>
+# include <ostream>
+
+class Memory {
+public:
+    enum Subsystem { OTHER, LEXEMES, SYMBOLS, SCOPES, PARAMETERS, OUTPUT, SUBSYSTEMS };
+
+    class Tag {
+	int _previous;
+
+    public:
+	Tag(Subsystem subsystem);
+	~Tag();
+    };
+
+private:
+    size_t _live[SUBSYSTEMS], _peak[SUBSYSTEMS], _count[SUBSYSTEMS];
+    size_t _total, _highest;
+    long _scopes;
+
+public:
+    Memory();
+
+    void allocate(size_t size, int subsystem);
+    void release(size_t size, int subsystem);
+    void scope(int delta);
+
+    void write(std::ostream &out, unsigned lines) const;
+};
+
+extern thread_local Memory *memory;
+extern thread_local int subsystem;
+
+# endif /* MEMORY_H */
@@ -0,0 +1,222 @@
+/*
+ * File:	Metrics.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		latency and throughput metrics of a run.  Latencies are
+ *		recorded in nanoseconds and reported in seconds.
+ */
+
+# include <ctime>
+# include <cstdio>
+# include <fstream>
+# include <iomanip>
+# include <unistd.h>
+# include "Metrics.h"
+
+using namespace std;
+
+Metrics *metrics;
+
+static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+static const char *labels[] = {"p50", "p90", "p99", "p999"};
+
+
+/*
+ * Function:	Metrics::Metrics (constructor)
+ *
+ * Description:	Initialize these metrics for inputs of the given kind,
+ *		starting the clock of the run.
+ */
+
+Metrics::Metrics(const string &item)
+    : _item(item), _bytes(0), _failures(0), _interval(0), _stopped(false)
+{
+    _start = now();
+}
+
+
+/*
+ * Function:	Metrics::~Metrics (destructor)
+ *
+ * Description:	Stop writing these metrics periodically.
+ */
+
+Metrics::~Metrics()
+{
+    stop();
+}
+
+
+/*
+ * Function:	Metrics::now
+ *
+ * Description:	Return the current time in seconds on a clock that never
+ *		goes backward.
+ */
+
+double Metrics::now()
+{
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Function:	Metrics::record
+ *
+ * Description:	Record an input of the given size that was asked for and
+ *		started at the given times, and whose result is ready now.
+ */
+
+void Metrics::record(double asked, double started, size_t bytes, bool failed)
+{
+    double ready = now();
+
+
+    _latency.record((ready - asked) * 1e9);
+    _wait.record((started - asked) * 1e9);
+    _bytes.fetch_add(bytes, memory_order_relaxed);
+
+    if (failed)
+	_failures.fetch_add(1, memory_order_relaxed);
+}
+
+
+/*
+ * Function:	Metrics::write
+ *
+ * Description:	Write a summary of these metrics to the given stream.
+ */
+
+void Metrics::write(ostream &out) const
+{
+    double elapsed = now() - _start;
+    uint64_t count = _latency.count();
+
+
+    out << "scc: " << count << " " << _item << "s";
+    out << fixed << setprecision(3) << " in " << elapsed << " s, ";
+    out << setprecision(1);
+    out << count / elapsed << " " << _item << "s/s, ";
+    out << _bytes / elapsed / 1e6 << " MB/s" << endl;
+
+    for (auto histogram : {&_latency, &_wait}) {
+	out << "scc: " << _item << (histogram == &_latency ? " latency" : " queue wait");
+	out << setprecision(3);
+
+	for (unsigned i = 0; i < 4; i ++)
+	    out << " " << labels[i] << " " << histogram->percentile(quantiles[i]) / 1e6;
+
+	out << " max " << histogram->max() / 1e6 << " ms" << endl;
+    }
+}
+
+
+/*
+ * Function:	Metrics::save
+ *
+ * Description:	Write these metrics in the Prometheus text format to the
+ *		given file, replacing it.  Return whether it was written.
+ */
+
+bool Metrics::save(const string &path) const
+{
+    string temporary = path + ".tmp";
+    ofstream out(temporary);
+    string name;
+
+
+    out << setprecision(9);
+
+    for (auto histogram : {&_latency, &_wait}) {
+	name = "scc_" + _item + (histogram == &_latency ? "_latency_seconds" : "_queue_wait_seconds");
+	out << "# HELP " << name << " Time from when each " << _item << " was asked for until ";
+	out << (histogram == &_latency ? "its result was ready.\n" : "its check began.\n");
+	out << "# TYPE " << name << " summary\n";
+
+	for (auto q : quantiles)
+	    out << name << "{quantile=\"" << q << "\"} " << histogram->percentile(q) / 1e9 << "\n";
+
+	out << name << "_sum " << histogram->sum() / 1e9 << "\n";
+	out << name << "_count " << histogram->count() << "\n";
+    }
+
+    out << "# HELP scc_" << _item << "_bytes_total Bytes checked.\n";
+    out << "# TYPE scc_" << _item << "_bytes_total counter\n";
+    out << "scc_" << _item << "_bytes_total " << _bytes << "\n";
+    out << "# HELP scc_" << _item << "_failures_total Inputs whose check failed.\n";
+    out << "# TYPE scc_" << _item << "_failures_total counter\n";
+    out << "scc_" << _item << "_failures_total " << _failures << "\n";
+    out << "# HELP scc_uptime_seconds Time since the run started.\n";
+    out << "# TYPE scc_uptime_seconds gauge\n";
+    out << "scc_uptime_seconds " << now() - _start << "\n";
+
+    out.close();
+
+    if (out.fail() || rename(temporary.c_str(), path.c_str()) < 0) {
+	unlink(temporary.c_str());
+	return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	Metrics::publish
+ *
+ * Description:	Write these metrics to their file every interval until
+ *		stopped, and once more when stopped.
+ */
+
+void Metrics::publish()
+{
+    unique_lock<mutex> lock(_lock);
+
+
+    while (!_stopped) {
+	save(_path);
+	_stopping.wait_for(lock, chrono::seconds(_interval));
+    }
+
+    save(_path);
+}
+
+
+/*
+ * Function:	Metrics::start
+ *
+ * Description:	Start writing these metrics to the given file every given
+ *		number of seconds.
+ */
+
+void Metrics::start(const string &path, unsigned interval)
+{
+    _path = path;
+    _interval = interval > 0 ? interval : 1;
+    _writer = thread(&Metrics::publish, this);
+}
+
+
+/*
+ * Function:	Metrics::stop
+ *
+ * Description:	Stop writing these metrics periodically, after writing them
+ *		a last time.
+ */
+
+void Metrics::stop()
+{
+    {
+	lock_guard<mutex> guard(_lock);
+	_stopped = true;
+    }
+
+    _stopping.notify_all();
+
+    if (_writer.joinable())
+	_writer.join();
+}
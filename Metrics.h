@@ -0,0 +1,58 @@
+/*
+ * File:	Metrics.h
+ *
+ * Description:	This file contains the class definition for the latency and
+ *		throughput metrics of a run that checks many inputs, such
+ *		as the files of a batch or the requests to a server.  Each
+ *		input has a latency, from when it was asked for to when
+ *		its result was ready, and a queue wait, from when it was
+ *		asked for to when its check began.
+ *
+ *		The metrics are summarized as percentiles at the end of the
+ *		run, and may also be written periodically to a file in the
+ *		Prometheus text format, for a node exporter's text file
+ *		collector to pick up.  The file is replaced atomically, so
+ *		that it is never read half written.
+ */
+
+# ifndef METRICS_H
+# define METRICS_H
+# include <mutex>
+# include <atomic>
+# include <string>
+# include <thread>
+# include <ostream>
+# include <condition_variable>
+# include "Histogram.h"
+
+class Metrics {
+    typedef std::string string;
+
+    string _item, _path;
+    Histogram _latency, _wait;
+    std::atomic<uint64_t> _bytes, _failures;
+    double _start;
+    unsigned _interval;
+    std::thread _writer;
+    std::mutex _lock;
+    std::condition_variable _stopping;
+    bool _stopped;
+
+    void publish();
+
+public:
+    Metrics(const string &item);
+    ~Metrics();
+
+    static double now();
+
+    void record(double asked, double started, size_t bytes, bool failed);
+    void write(std::ostream &out) const;
+    bool save(const string &path) const;
+    void start(const string &path, unsigned interval);
+    void stop();
+};
+
+extern Metrics *metrics;
+
+# endif /* METRICS_H */
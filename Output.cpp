@@ -0,0 +1,334 @@
+/*
+ * File:	Output.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		symbol output sink in Simple C.
+ *
+ *		The text format is produced directly into the buffer rather
+ *		than through the stream operator for types, which would
+ *		otherwise construct a temporary string for the asterisks
+ *		of every pointer type.  The buffer is written with a single
+ *		system call once it holds about a megabyte.
+ */
+
+# include <cerrno>
+# include <cstring>
+# include <unistd.h>
+# include "tokens.h"
+# include "Output.h"
+# include "Stats.h"
+# include "Memory.h"
+# include "Trace.h"
+
+using namespace std;
+
+static const size_t BUFSIZE = 1 << 20;
+
+
+/*
+ * Function:	append
+ *
+ * Description:	Append an unsigned number in decimal to the given string.
+ */
+
+static void append(string &s, unsigned n)
+{
+    char buf[16], *p = buf + sizeof(buf);
+
+
+    do {
+	*-- p = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+
+    s.append(p, buf + sizeof(buf) - p);
+}
+
+
+/*
+ * Function:	align
+ *
+ * Description:	Pad the given string with zero bytes to a multiple of eight
+ *		bytes in length and return the new length.
+ */
+
+static uint64_t align(string &s)
+{
+    s.append((8 - s.size() % 8) % 8, '\0');
+    return s.size();
+}
+
+
+/*
+ * Function:	column
+ *
+ * Description:	Append a column of values to the dump, aligned to eight
+ *		bytes, and return its offset.
+ */
+
+template<class T>
+static uint64_t column(string &s, const vector<T> &values)
+{
+    uint64_t offset = align(s);
+
+
+    s.append((const char *) values.data(), values.size() * sizeof(T));
+    return offset;
+}
+
+
+/*
+ * Function:	Output::Output (constructor)
+ *
+ * Description:	Initialize this sink to write to the given file descriptor
+ *		using the given format.  A negative descriptor means that
+ *		the output is simply kept in memory.
+ */
+
+Output::Output(int fd, Format format)
+    : _fd(fd), _error(0), _closed(false), _format(format)
+{
+    if (_fd >= 0 && _format == TEXT)
+	_buffer.reserve(BUFSIZE);
+}
+
+
+/*
+ * Function:	Output::~Output (destructor)
+ *
+ * Description:	Close the sink if that hasn't already been done.
+ */
+
+Output::~Output()
+{
+    close();
+}
+
+
+/*
+ * Function:	Output::drain
+ *
+ * Description:	Write the buffer to the file descriptor, if we have one.
+ *		The buffer is discarded if a write fails, and so is any
+ *		later output, since the file is incomplete anyway.
+ */
+
+void Output::drain()
+{
+    const char *p = _buffer.data();
+    size_t left = _buffer.size();
+    ssize_t n;
+
+
+    if (_fd < 0)
+	return;
+
+    if (_error != 0) {
+	_buffer.clear();
+	return;
+    }
+
+    Trace::Span span("output", "flush");
+    span.arg("bytes", left);
+
+    while (left > 0) {
+	n = ::write(_fd, p, left);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0) {
+	    _error = n < 0 ? errno : EIO;
+	    break;
+	}
+
+	p += n;
+	left -= n;
+    }
+
+    _buffer.clear();
+}
+
+
+/*
+ * Function:	Output::dump
+ *
+ * Description:	Append the binary dump of all symbols written so far to the
+ *		buffer.
+ */
+
+void Output::dump()
+{
+    SymbolDump header;
+
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SYMBOL_DUMP_MAGIC, sizeof(header.magic));
+    header.version = SYMBOL_DUMP_VERSION;
+    header.count = _kinds.size();
+
+    _names.push_back(_strings.size());
+    _buffer.append((const char *) &header, sizeof(header));
+
+    header.names = column(_buffer, _names);
+    header.kinds = column(_buffer, _kinds);
+    header.specifiers = column(_buffer, _specifiers);
+    header.indirections = column(_buffer, _indirections);
+    header.lengths = column(_buffer, _lengths);
+    header.arities = column(_buffer, _arities);
+    header.strings = align(_buffer);
+
+    _buffer += _strings;
+    header.size = align(_buffer);
+    memcpy(&_buffer[0], &header, sizeof(header));
+}
+
+
+/*
+ * Function:	Output::write
+ *
+ * Description:	Write a symbol with the given name and type.
+ */
+
+void Output::write(const string &name, const Type &type)
+{
+    Stats::Timer timer(Stats::OUTPUT);
+    Memory::Tag tag(Memory::OUTPUT);
+    int specifier;
+
+
+    if (_format == BINARY) {
+	_names.push_back(_strings.size());
+	_strings += name;
+	_strings += '\0';
+
+	if (type.isError())
+	    _kinds.push_back(DUMP_ERROR);
+	else if (type.isArray())
+	    _kinds.push_back(DUMP_ARRAY);
+	else if (type.isFunction())
+	    _kinds.push_back(DUMP_FUNCTION);
+	else
+	    _kinds.push_back(DUMP_SCALAR);
+
+	specifier = type.specifier();
+
+	if (specifier == CHAR)
+	    _specifiers.push_back(DUMP_CHAR);
+	else if (specifier == INT)
+	    _specifiers.push_back(DUMP_INT);
+	else if (specifier == VOID)
+	    _specifiers.push_back(DUMP_VOID);
+	else
+	    _specifiers.push_back(DUMP_NONE);
+
+	_indirections.push_back(type.indirection());
+	_lengths.push_back(type.isArray() ? type.length() : 0);
+
+	if (type.isFunction() && type.parameters())
+	    _arities.push_back(type.parameters()->size());
+	else
+	    _arities.push_back(-1);
+
+	return;
+    }
+
+    _buffer += name;
+    _buffer += ": ";
+
+    if (type.isError())
+	_buffer += "error";
+
+    else {
+	if (type.specifier() == CHAR)
+	    _buffer += "char";
+	else if (type.specifier() == INT)
+	    _buffer += "int";
+	else if (type.specifier() == VOID)
+	    _buffer += "void";
+	else
+	    _buffer += "unknown";
+
+	if (type.indirection() > 0) {
+	    _buffer += ' ';
+	    _buffer.append(type.indirection(), '*');
+	}
+
+	if (type.isArray()) {
+	    _buffer += '[';
+	    append(_buffer, type.length());
+	    _buffer += ']';
+
+	} else if (type.isFunction())
+	    _buffer += "()";
+    }
+
+    _buffer += '\n';
+
+    if (_buffer.size() >= BUFSIZE)
+	drain();
+}
+
+
+/*
+ * Function:	Output::close
+ *
+ * Description:	Finish writing the output.  A binary dump is written out
+ *		only now, since its header needs to know every column.
+ *		Return whether all of the output was written.
+ */
+
+bool Output::close()
+{
+    Stats::Timer timer(Stats::OUTPUT);
+    Memory::Tag tag(Memory::OUTPUT);
+
+
+    if (_closed)
+	return _error == 0;
+
+    if (_format == BINARY)
+	dump();
+
+    drain();
+    _closed = true;
+    return _error == 0;
+}
+
+
+/*
+ * Function:	Output::error (accessor)
+ *
+ * Description:	Return the error number of the write that failed, or zero
+ *		if every write succeeded.
+ */
+
+int Output::error() const
+{
+    return _error;
+}
+
+
+/*
+ * Function:	Output::format (accessor)
+ *
+ * Description:	Return the format of this sink.
+ */
+
+Output::Format Output::format() const
+{
+    return _format;
+}
+
+
+/*
+ * Function:	Output::contents (accessor)
+ *
+ * Description:	Return the output accumulated by a sink without a file
+ *		descriptor.
+ */
+
+const string &Output::contents() const
+{
+    return _buffer;
+}
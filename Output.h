@@ -0,0 +1,85 @@
+/*
+ * File:	Output.h
+ *
+ * Description:	This file contains the class definition for the symbol
+ *		output sink in Simple C.  Every declaration seen by the
+ *		checker is written to the sink, which keeps a large buffer
+ *		in user space and writes it out only when it fills or when
+ *		the sink is closed.  Nothing is flushed per line.
+ *
+ *		Two formats are supported.  The text format is the familiar
+ *		"name: type" listing.  The binary format is a columnar dump
+ *		that is written as a whole when the sink is closed, so that
+ *		downstream tools can simply mmap the file.  Its layout is
+ *		described by the SymbolDump structure below: a fixed header
+ *		followed by one array per column, each aligned to eight
+ *		bytes, and finally a pool of null-terminated names.
+ *
+ *		A sink without a file descriptor just accumulates its
+ *		output, which the caller can then retrieve.  If writing to
+ *		the file descriptor fails, the rest of the output is
+ *		discarded and the error is kept for the caller to report
+ *		once the sink is closed.
+ */
+
+# ifndef OUTPUT_H
+# define OUTPUT_H
+# include <string>
+# include <vector>
+# include <cstdint>
+# include "Type.h"
+
+# define SYMBOL_DUMP_MAGIC "SCCSYMS"
+# define SYMBOL_DUMP_VERSION 1
+
+enum { DUMP_SCALAR, DUMP_ARRAY, DUMP_FUNCTION, DUMP_ERROR };
+enum { DUMP_NONE, DUMP_CHAR, DUMP_INT, DUMP_VOID };
+
+struct SymbolDump {
+    char magic[8];		/* SYMBOL_DUMP_MAGIC */
+    uint32_t version;		/* SYMBOL_DUMP_VERSION */
+    uint32_t count;		/* number of symbols */
+    uint64_t names;		/* uint32_t[count + 1], offsets into strings */
+    uint64_t kinds;		/* uint8_t[count], DUMP_SCALAR, ... */
+    uint64_t specifiers;	/* uint8_t[count], DUMP_CHAR, ... */
+    uint64_t indirections;	/* uint32_t[count] */
+    uint64_t lengths;		/* uint32_t[count], zero unless an array */
+    uint64_t arities;		/* int32_t[count], -1 unless specified */
+    uint64_t strings;		/* char[], null-terminated names */
+    uint64_t size;		/* total size of the dump in bytes */
+};
+
+class Output {
+public:
+    enum Format { TEXT, BINARY };
+
+private:
+    typedef std::string string;
+
+    int _fd, _error;
+    bool _closed;
+    Format _format;
+    string _buffer;
+
+    std::vector<uint32_t> _names;
+    std::vector<uint8_t> _kinds, _specifiers;
+    std::vector<uint32_t> _indirections, _lengths;
+    std::vector<int32_t> _arities;
+    string _strings;
+
+    void drain();
+    void dump();
+
+public:
+    Output(int fd = -1, Format format = TEXT);
+    ~Output();
+
+    void write(const string &name, const Type &type);
+    bool close();
+
+    int error() const;
+    Format format() const;
+    const string &contents() const;
+};
+
+# endif /* OUTPUT_H */
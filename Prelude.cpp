@@ -0,0 +1,311 @@
+/*
+ * File:	Prelude.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		precompiled preludes in Simple C.
+ *
+ *		An image is checked thoroughly when it is opened, so that
+ *		installing it never needs to check anything again.  A
+ *		damaged or foreign image is simply refused.
+ */
+
+# include <cerrno>
+# include <cstring>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include "Prelude.h"
+# include "Output.h"
+# include "Cache.h"
+# include "tokens.h"
+
+using namespace std;
+
+
+/*
+ * Function:	entry
+ *
+ * Description:	Return the image entry for the given type.  The parameters
+ *		of a function type are appended to the given list.
+ */
+
+static PreludeEntry entry(const Type &type, vector<PreludeEntry> &params)
+{
+    PreludeEntry e;
+
+
+    memset(&e, 0, sizeof(e));
+    e.arity = -1;
+
+    if (type.isError()) {
+	e.kind = DUMP_ERROR;
+	return e;
+    }
+
+    if (type.specifier() == CHAR)
+	e.specifier = DUMP_CHAR;
+    else if (type.specifier() == INT)
+	e.specifier = DUMP_INT;
+    else if (type.specifier() == VOID)
+	e.specifier = DUMP_VOID;
+    else
+	e.specifier = DUMP_NONE;
+
+    e.indirection = type.indirection();
+
+    if (type.isArray()) {
+	e.kind = DUMP_ARRAY;
+	e.length = type.length();
+
+    } else if (type.isFunction()) {
+	e.kind = DUMP_FUNCTION;
+
+	if (type.parameters() != nullptr) {
+	    e.parameters = params.size();
+	    e.arity = type.parameters()->size();
+
+	    for (auto &param : *type.parameters())
+		params.push_back(entry(param, params));
+	}
+
+    } else
+	e.kind = DUMP_SCALAR;
+
+    return e;
+}
+
+
+/*
+ * Function:	Prelude::Prelude (constructor)
+ *
+ * Description:	Initialize this prelude as empty.
+ */
+
+Prelude::Prelude()
+    : _base(nullptr), _size(0), _identity(0)
+{
+}
+
+
+/*
+ * Function:	Prelude::~Prelude (destructor)
+ *
+ * Description:	Unmap the image of this prelude.
+ */
+
+Prelude::~Prelude()
+{
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+}
+
+
+/*
+ * Function:	Prelude::image (private accessor)
+ *
+ * Description:	Return the header of the image of this prelude.
+ */
+
+const PreludeImage *Prelude::image() const
+{
+    return (const PreludeImage *) _base;
+}
+
+
+/*
+ * Function:	Prelude::type (private)
+ *
+ * Description:	Return the type for the given image entry.
+ */
+
+Type Prelude::type(const PreludeEntry &e) const
+{
+    const PreludeEntry *params;
+    Parameters *parameters;
+    int specifier;
+
+
+    if (e.kind == DUMP_ERROR)
+	return Type();
+
+    if (e.specifier == DUMP_CHAR)
+	specifier = CHAR;
+    else if (e.specifier == DUMP_INT)
+	specifier = INT;
+    else if (e.specifier == DUMP_VOID)
+	specifier = VOID;
+    else
+	specifier = 0;
+
+    if (e.kind == DUMP_ARRAY)
+	return Type(specifier, e.indirection, e.length);
+
+    if (e.kind == DUMP_SCALAR)
+	return Type(specifier, e.indirection);
+
+    if (e.arity < 0)
+	return Type(specifier, e.indirection, nullptr);
+
+    params = (const PreludeEntry *) (_base + image()->parameters);
+    parameters = new Parameters();
+
+    for (int i = 0; i < e.arity; i ++)
+	parameters->push_back(type(params[e.parameters + i]));
+
+    return Type(specifier, e.indirection, parameters);
+}
+
+
+/*
+ * Function:	Prelude::open
+ *
+ * Description:	Map the image in the given file.  Return false, with errno
+ *		set, if it cannot be mapped or is not a valid image.
+ */
+
+bool Prelude::open(const string &path)
+{
+    const PreludeImage *header;
+    const PreludeEntry *entries;
+    struct stat st;
+    uint64_t n;
+    void *base;
+    int fd;
+
+
+    if ((fd = ::open(path.c_str(), O_RDONLY)) < 0)
+	return false;
+
+    if (fstat(fd, &st) < 0)
+	base = MAP_FAILED;
+    else if (st.st_size < (off_t) sizeof(PreludeImage))
+	base = MAP_FAILED, errno = EINVAL;
+    else
+	base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (base == MAP_FAILED)
+	return false;
+
+    header = (const PreludeImage *) base;
+    entries = (const PreludeEntry *) ((const char *) base + sizeof(PreludeImage));
+    n = st.st_size;
+
+    bool valid = memcmp(header->magic, PRELUDE_MAGIC, sizeof(header->magic)) == 0 &&
+	header->version == PRELUDE_VERSION && header->size == n &&
+	header->symbols == sizeof(PreludeImage) &&
+	header->parameters == header->symbols + header->count * sizeof(PreludeEntry) &&
+	header->strings == header->parameters + header->nparams * sizeof(PreludeEntry) &&
+	header->strings <= n && (header->strings == n || ((const char *) base)[n - 1] == '\0');
+
+    for (uint32_t i = 0; valid && i < header->count + header->nparams; i ++)
+	valid = entries[i].kind <= DUMP_ERROR && entries[i].specifier <= DUMP_VOID &&
+	    (entries[i].arity < 0 || (i < header->count &&
+	     (uint64_t) entries[i].parameters + entries[i].arity <= header->nparams)) &&
+	    (i >= header->count || header->strings + entries[i].name < n);
+
+    if (!valid) {
+	munmap(base, n);
+	errno = EINVAL;
+	return false;
+    }
+
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+
+    _base = (const char *) base;
+    _size = n;
+    _identity = fingerprint(_base, _size);
+    return true;
+}
+
+
+/*
+ * Function:	Prelude::install
+ *
+ * Description:	Insert a fresh symbol into the given scope for each symbol
+ *		of this prelude.
+ */
+
+void Prelude::install(Scope *scope) const
+{
+    const PreludeEntry *symbols;
+    const char *strings;
+
+
+    if (_base == nullptr)
+	return;
+
+    symbols = (const PreludeEntry *) (_base + image()->symbols);
+    strings = _base + image()->strings;
+
+    for (uint32_t i = 0; i < image()->count; i ++)
+	scope->insert(new Symbol(strings + symbols[i].name, type(symbols[i])));
+}
+
+
+/*
+ * Function:	Prelude::identity (accessor)
+ *
+ * Description:	Return a fingerprint of the image of this prelude, which
+ *		is zero if there is no image.
+ */
+
+uint64_t Prelude::identity() const
+{
+    return _identity;
+}
+
+
+/*
+ * Function:	Prelude::save
+ *
+ * Description:	Write an image of the given scope to the given file.
+ *		Return whether the image was written.
+ */
+
+bool Prelude::save(const Scope *scope, const string &path)
+{
+    vector<PreludeEntry> symbols, params;
+    PreludeImage header;
+    string strings;
+    size_t length;
+    ssize_t n;
+    int fd;
+
+
+    for (auto symbol : scope->symbols()) {
+	symbols.push_back(entry(symbol->type(), params));
+	symbols.back().name = strings.size();
+	strings.append(symbol->name());
+	strings.push_back('\0');
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PRELUDE_MAGIC, sizeof(header.magic));
+    header.version = PRELUDE_VERSION;
+    header.count = symbols.size();
+    header.nparams = params.size();
+    header.symbols = sizeof(header);
+    header.parameters = header.symbols + symbols.size() * sizeof(PreludeEntry);
+    header.strings = header.parameters + params.size() * sizeof(PreludeEntry);
+    header.size = header.strings + strings.size();
+
+    string image((const char *) &header, sizeof(header));
+    image.append((const char *) symbols.data(), symbols.size() * sizeof(PreludeEntry));
+    image.append((const char *) params.data(), params.size() * sizeof(PreludeEntry));
+    image.append(strings);
+
+    if ((fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+	return false;
+
+    for (length = 0; length < image.size(); length += n)
+	if ((n = write(fd, image.data() + length, image.size() - length)) <= 0) {
+	    close(fd);
+	    return false;
+	}
+
+    return close(fd) == 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * File:	Prelude.h
+ *
+ * Description:	This file contains the class definition for precompiled
+ *		preludes in Simple C.  A prelude is a file of global
+ *		declarations shared by many translation units.  Rather than
+ *		parsing it again for each unit, we check it once and save
+ *		its outermost scope as an image, which later runs simply
+ *		map into memory and install as the initial outermost scope
+ *		of each unit, exactly as if the prelude had been included
+ *		at its beginning.
+ *
+ *		The image contains no pointers, only offsets from its start,
+ *		so it may be mapped at any address.  Its layout is described
+ *		by the PreludeImage structure below: a fixed header, one
+ *		entry per symbol, one entry per parameter of any function
+ *		defined in the prelude, and finally a pool of null-
+ *		terminated names.  Specifiers and kinds use the same codes
+ *		as the binary symbol dump.
+ *
+ *		Since functions defined later may replace the symbols of
+ *		the outermost scope, installing a prelude creates fresh
+ *		symbols for each unit.  The image itself is read-only.
+ */
+
+# ifndef PRELUDE_H
+# define PRELUDE_H
+# include <string>
+# include <cstdint>
+# include <cstddef>
+# include "Scope.h"
+
+# define PRELUDE_MAGIC "SCCPRELD"
+# define PRELUDE_VERSION 1
+
+struct PreludeEntry {
+    uint32_t name;		/* offset into strings, unused for parameters */
+    uint8_t kind;		/* DUMP_SCALAR, ... */
+    uint8_t specifier;		/* DUMP_CHAR, ... */
+    uint16_t unused;
+    uint32_t indirection;
+    uint32_t length;		/* zero unless an array */
+    uint32_t parameters;	/* index of the first parameter */
+    int32_t arity;		/* -1 unless specified */
+};
+
+struct PreludeImage {
+    char magic[8];		/* PRELUDE_MAGIC */
+    uint32_t version;		/* PRELUDE_VERSION */
+    uint32_t count;		/* number of symbols */
+    uint32_t nparams;		/* number of parameters */
+    uint32_t unused;
+    uint64_t symbols;		/* PreludeEntry[count] */
+    uint64_t parameters;	/* PreludeEntry[nparams] */
+    uint64_t strings;		/* char[], null-terminated names */
+    uint64_t size;		/* total size of the image in bytes */
+};
+
+class Prelude {
+    typedef std::string string;
+
+    const char *_base;
+    size_t _size;
+    uint64_t _identity;
+
+    const PreludeImage *image() const;
+    Type type(const PreludeEntry &entry) const;
+
+public:
+    Prelude();
+    ~Prelude();
+
+    bool open(const string &path);
+    void install(Scope *scope) const;
+    uint64_t identity() const;
+
+    static bool save(const Scope *scope, const string &path);
+};
+
+# endif /* PRELUDE_H */
@@ -0,0 +1,572 @@
+/*
+ * File:	ReadAhead.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		reading source files ahead of the workers in a batch run.
+ *
+ *		We talk to io_uring directly through its system calls
+ *		rather than depending on liburing.  Only the oldest read
+ *		operation is used, so any kernel with io_uring will do.
+ *		Opening the files is still done synchronously by the ring
+ *		thread, since that is cheap compared to reading them.  If
+ *		the ring cannot be set up, perhaps because a container
+ *		forbids it, we quietly fall back to the pool of threads.
+ *
+ *		The kernel writes into the buffer of a read until its
+ *		completion is posted, so a buffer is never freed while its
+ *		read is still owned by the kernel, even if the ring fails.
+ */
+
+# include <map>
+# include <chrono>
+# include <cerrno>
+# include <cstring>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/uio.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include "ReadAhead.h"
+# include "batch.h"
+
+# ifdef __NR_io_uring_setup
+# include <linux/io_uring.h>
+# endif
+
+using namespace std;
+using namespace std::chrono;
+
+struct Ring {
+# ifdef __NR_io_uring_setup
+    int fd;
+    unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+    unsigned *cqhead, *cqtail, *cqmask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqring, *cqring;
+    size_t sqsize, cqsize, sqesize;
+# endif
+};
+
+struct Read {
+    int fd;
+    string data;
+    size_t offset;
+    struct iovec iov;
+};
+
+
+# ifdef __NR_io_uring_setup
+
+/*
+ * Function:	openRing
+ *
+ * Description:	Create an io_uring with room for the given number of
+ *		entries and map its rings into memory.  Return a null
+ *		pointer if the kernel won't let us.
+ */
+
+static Ring *openRing(unsigned entries)
+{
+    struct io_uring_params p;
+    Ring *ring;
+    char *sq, *cq;
+    int fd;
+
+
+    memset(&p, 0, sizeof(p));
+    fd = syscall(__NR_io_uring_setup, entries, &p);
+
+    if (fd < 0)
+	return nullptr;
+
+    ring = new Ring();
+    ring->fd = fd;
+    ring->sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+	ring->sqsize = ring->cqsize = max(ring->sqsize, ring->cqsize);
+
+    ring->sqring = mmap(nullptr, ring->sqsize, PROT_READ | PROT_WRITE,
+	MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+	ring->cqring = ring->sqring;
+    else
+	ring->cqring = mmap(nullptr, ring->cqsize, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+    ring->sqes = (struct io_uring_sqe *) mmap(nullptr, ring->sqesize,
+	PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+	IORING_OFF_SQES);
+
+    if (ring->sqring == MAP_FAILED || ring->cqring == MAP_FAILED ||
+	    ring->sqes == MAP_FAILED) {
+	close(fd);
+	delete ring;
+	return nullptr;
+    }
+
+    sq = (char *) ring->sqring;
+    ring->sqhead = (unsigned *) (sq + p.sq_off.head);
+    ring->sqtail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sqmask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sqarray = (unsigned *) (sq + p.sq_off.array);
+
+    cq = (char *) ring->cqring;
+    ring->cqhead = (unsigned *) (cq + p.cq_off.head);
+    ring->cqtail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cqmask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    return ring;
+}
+
+
+/*
+ * Function:	closeRing
+ *
+ * Description:	Unmap and close the given ring.
+ */
+
+static void closeRing(Ring *ring)
+{
+    munmap(ring->sqes, ring->sqesize);
+
+    if (ring->cqring != ring->sqring)
+	munmap(ring->cqring, ring->cqsize);
+
+    munmap(ring->sqring, ring->sqsize);
+    close(ring->fd);
+    delete ring;
+}
+
+
+/*
+ * Function:	submit
+ *
+ * Description:	Queue a read of the remainder of the given file.  The read
+ *		is not actually submitted until we next enter the kernel.
+ */
+
+static void submit(Ring *ring, unsigned file, Read &r)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+
+    r.iov.iov_base = &r.data[r.offset];
+    r.iov.iov_len = r.data.size() - r.offset;
+
+    tail = *ring->sqtail;
+    index = tail & *ring->sqmask;
+    sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = r.fd;
+    sqe->addr = (unsigned long) &r.iov;
+    sqe->len = 1;
+    sqe->off = r.offset;
+    sqe->user_data = file;
+
+    ring->sqarray[index] = index;
+    __atomic_store_n(ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+}
+
+# endif /* __NR_io_uring_setup */
+
+
+/*
+ * Function:	ReadAhead::ReadAhead (constructor)
+ *
+ * Description:	Start reading the given files in the given order, keeping
+ *		at most WINDOW files either in flight or not yet taken.  A
+ *		window of zero disables reading ahead altogether.
+ */
+
+ReadAhead::ReadAhead(const vector<string> &paths, const vector<unsigned> &order, unsigned window, unsigned threads)
+    : _paths(paths), _order(order), _files(paths.size()), _window(window),
+      _ahead(0), _position(0), _pool(threads), _stopping(false),
+      _ring(nullptr), _wait(0), _bytes(0)
+{
+    for (auto &f : _files) {
+	f.state = File::PENDING;
+	f.error = 0;
+    }
+
+    if (_window == 0)
+	return;
+
+# ifdef __NR_io_uring_setup
+    if ((_ring = openRing(_window)) != nullptr) {
+	_threads.push_back(thread(&ReadAhead::ringThread, this));
+	return;
+    }
+# endif
+
+    for (unsigned i = 0; i < threads; i ++)
+	_threads.push_back(thread(&ReadAhead::poolThread, this));
+}
+
+
+/*
+ * Function:	ReadAhead::~ReadAhead (destructor)
+ *
+ * Description:	Stop reading ahead and wait for any reads in flight.
+ */
+
+ReadAhead::~ReadAhead()
+{
+    {
+	lock_guard<mutex> guard(_lock);
+	_stopping = true;
+	_space.notify_all();
+    }
+
+    for (auto &t : _threads)
+	t.join();
+
+# ifdef __NR_io_uring_setup
+    if (_ring != nullptr)
+	closeRing(_ring);
+# endif
+}
+
+
+/*
+ * Function:	ReadAhead::claim
+ *
+ * Description:	Claim the next file to be read ahead, waiting for room in
+ *		the window if BLOCK is true.  Return false if there is
+ *		nothing to claim.
+ */
+
+bool ReadAhead::claim(unsigned &file, bool block)
+{
+    unique_lock<mutex> lock(_lock);
+
+
+    while (!_stopping) {
+	while (_position < _order.size() &&
+		_files[_order[_position]].state != File::PENDING)
+	    _position ++;
+
+	if (_position == _order.size())
+	    return false;
+
+	if (_ahead < _window) {
+	    file = _order[_position ++];
+	    _files[file].state = File::STARTED;
+	    _ahead ++;
+	    return true;
+	}
+
+	if (!block)
+	    return false;
+
+	_space.wait(lock);
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	ReadAhead::complete
+ *
+ * Description:	Record that the given file has been read.
+ */
+
+void ReadAhead::complete(unsigned file, string &data, int error)
+{
+    lock_guard<mutex> guard(_lock);
+
+
+    _files[file].data.swap(data);
+    _files[file].error = error;
+    _files[file].state = File::READY;
+    _bytes += _files[file].data.size();
+    _ready.notify_all();
+}
+
+
+/*
+ * Function:	ReadAhead::release
+ *
+ * Description:	Give back the given files, which were claimed but not read,
+ *		so that they can be claimed again or read by their workers.
+ */
+
+void ReadAhead::release(const vector<unsigned> &files)
+{
+    lock_guard<mutex> guard(_lock);
+
+
+    for (auto file : files) {
+	_files[file].state = File::PENDING;
+	_ahead --;
+    }
+
+    _position = 0;
+    _ready.notify_all();
+    _space.notify_all();
+}
+
+
+/*
+ * Function:	ReadAhead::poolThread
+ *
+ * Description:	Read files one at a time until there are none left.
+ */
+
+void ReadAhead::poolThread()
+{
+    unsigned file;
+    string data;
+    int fd, error;
+
+
+    while (claim(file, true)) {
+	error = 0;
+
+	if ((fd = open(_paths[file].c_str(), O_RDONLY)) < 0)
+	    error = errno;
+	else {
+	    if (!readFile(fd, data))
+		error = errno;
+
+	    close(fd);
+	}
+
+	complete(file, data, error);
+    }
+}
+
+
+/*
+ * Function:	ReadAhead::ringThread
+ *
+ * Description:	Keep the window full of reads submitted to the ring and
+ *		collect their completions, until there are no files left.
+ *
+ *		If entering the ring fails, we take back the reads that the
+ *		kernel has not yet consumed and wait only for those it has.
+ *		Their buffers are kept until their completions arrive, and
+ *		are never freed at all if we cannot wait for them.  The
+ *		files left unread are then released and read by a pool of
+ *		threads, the first of which is this one.
+ */
+
+void ReadAhead::ringThread()
+{
+# ifdef __NR_io_uring_setup
+    map<unsigned, Read> reads;
+    vector<unsigned> unfinished;
+    vector<thread> pool;
+    struct io_uring_cqe *cqe;
+    unsigned file, queued, head, tail;
+    struct stat st;
+    bool done, failed;
+    int error;
+
+
+    queued = 0;
+    failed = false;
+
+    while (1) {
+	while (!failed && claim(file, reads.empty())) {
+	    Read &r = reads[file];
+
+	    if ((r.fd = open(_paths[file].c_str(), O_RDONLY)) < 0) {
+		complete(file, r.data, errno);
+		reads.erase(file);
+		continue;
+	    }
+
+	    if (fstat(r.fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		error = readFile(r.fd, r.data) ? 0 : errno;
+		close(r.fd);
+		complete(file, r.data, error);
+		reads.erase(file);
+		continue;
+	    }
+
+	    r.data.resize(st.st_size);
+	    r.offset = 0;
+	    submit(_ring, file, r);
+	    queued ++;
+	}
+
+	if (reads.empty())
+	    break;
+
+	if (syscall(__NR_io_uring_enter, _ring->fd, queued, 1,
+		IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+	    if (failed)
+		break;
+
+	    failed = true;
+	    head = __atomic_load_n(_ring->sqhead, __ATOMIC_ACQUIRE);
+	    tail = *_ring->sqtail;
+	    __atomic_store_n(_ring->sqtail, head, __ATOMIC_RELEASE);
+
+	    for (; head != tail; head ++) {
+		file = _ring->sqes[_ring->sqarray[head & *_ring->sqmask]].user_data;
+		close(reads[file].fd);
+		reads.erase(file);
+		unfinished.push_back(file);
+	    }
+
+	    queued = 0;
+	    continue;
+	}
+
+	queued = 0;
+	head = *_ring->cqhead;
+
+	while (head != __atomic_load_n(_ring->cqtail, __ATOMIC_ACQUIRE)) {
+	    cqe = &_ring->cqes[head & *_ring->cqmask];
+	    file = cqe->user_data;
+	    Read &r = reads[file];
+	    done = true;
+	    error = 0;
+
+	    if (cqe->res == -EINTR || cqe->res == -EAGAIN)
+		done = false;
+	    else if (cqe->res < 0)
+		error = -cqe->res;
+	    else if (cqe->res == 0)
+		r.data.resize(r.offset);
+	    else if ((r.offset += cqe->res) < r.data.size())
+		done = false;
+
+	    head ++;
+	    __atomic_store_n(_ring->cqhead, head, __ATOMIC_RELEASE);
+
+	    if (done) {
+		close(r.fd);
+		complete(file, r.data, error);
+		reads.erase(file);
+	    } else if (failed) {
+		close(r.fd);
+		reads.erase(file);
+		unfinished.push_back(file);
+	    } else {
+		submit(_ring, file, r);
+		queued ++;
+	    }
+	}
+    }
+
+    if (!failed)
+	return;
+
+    for (auto &r : reads) {
+	close(r.second.fd);
+	unfinished.push_back(r.first);
+    }
+
+    if (!reads.empty())
+	new map<unsigned, Read>(move(reads));	/* still the kernel's */
+
+    release(unfinished);
+
+    for (unsigned i = 1; i < _pool; i ++)
+	pool.push_back(thread(&ReadAhead::poolThread, this));
+
+    poolThread();
+
+    for (auto &t : pool)
+	t.join();
+# endif
+}
+
+
+/*
+ * Function:	ReadAhead::get
+ *
+ * Description:	Wait for the given file to be read and move its contents
+ *		into the buffer.  If the file has not been started, read it
+ *		now.  Return zero or the error number of a failed read.
+ */
+
+int ReadAhead::get(unsigned file, string &data)
+{
+    steady_clock::time_point start = steady_clock::now();
+    unique_lock<mutex> lock(_lock);
+    File &f = _files[file];
+    int fd, error;
+
+
+    while (f.state == File::STARTED)
+	_ready.wait(lock);
+
+    if (f.state == File::PENDING) {
+	f.state = File::TAKEN;
+	lock.unlock();
+	error = 0;
+
+	if ((fd = open(_paths[file].c_str(), O_RDONLY)) < 0)
+	    error = errno;
+	else {
+	    if (!readFile(fd, data))
+		error = errno;
+
+	    close(fd);
+	}
+
+	lock.lock();
+	_bytes += data.size();
+	_wait += duration<double>(steady_clock::now() - start).count();
+	return error;
+    }
+
+    data.swap(f.data);
+    string().swap(f.data);
+    f.state = File::TAKEN;
+
+    _ahead --;
+    _space.notify_all();
+    _wait += duration<double>(steady_clock::now() - start).count();
+    return f.error;
+}
+
+
+/*
+ * Function:	ReadAhead::uring (accessor)
+ *
+ * Description:	Return whether the files are being read using io_uring.
+ */
+
+bool ReadAhead::uring() const
+{
+    return _ring != nullptr;
+}
+
+
+/*
+ * Function:	ReadAhead::wait (accessor)
+ *
+ * Description:	Return the total number of seconds spent waiting for files.
+ */
+
+double ReadAhead::wait() const
+{
+    return _wait;
+}
+
+
+/*
+ * Function:	ReadAhead::bytes (accessor)
+ *
+ * Description:	Return the total number of bytes read.
+ */
+
+uint64_t ReadAhead::bytes() const
+{
+    return _bytes;
+}
@@ -0,0 +1,73 @@
+/*
+ * File:	ReadAhead.h
+ *
+ * Description:	This file contains the class definition for reading source
+ *		files ahead of the workers in a batch run.  The files are
+ *		read in the order the workers are expected to want them,
+ *		keeping a window of files either in flight or sitting in
+ *		memory, so that a worker asking for its next file usually
+ *		finds it already there.
+ *
+ *		The reads are done using io_uring where the kernel allows
+ *		it, and otherwise by a small pool of threads.  If the ring
+ *		fails part way through, the files it had not finished are
+ *		handed to the pool instead.  A worker
+ *		asking for a file that has not been started yet, perhaps
+ *		because it stole the file from another worker, simply reads
+ *		the file itself.
+ *
+ *		The time workers spend waiting for their files is recorded
+ *		separately, which tells us how well checking overlaps with
+ *		the latency of storage.
+ */
+
+# ifndef READAHEAD_H
+# define READAHEAD_H
+# include <mutex>
+# include <string>
+# include <thread>
+# include <vector>
+# include <cstdint>
+# include <condition_variable>
+
+class ReadAhead {
+    typedef std::string string;
+
+    struct File {
+	enum { PENDING, STARTED, READY, TAKEN } state;
+	string data;
+	int error;
+    };
+
+    std::vector<string> _paths;
+    std::vector<unsigned> _order;
+    std::vector<File> _files;
+    unsigned _window, _ahead, _position, _pool;
+    bool _stopping;
+
+    std::mutex _lock;
+    std::condition_variable _ready, _space;
+    std::vector<std::thread> _threads;
+    struct Ring *_ring;
+
+    double _wait;
+    uint64_t _bytes;
+
+    bool claim(unsigned &file, bool block);
+    void complete(unsigned file, string &data, int error);
+    void release(const std::vector<unsigned> &files);
+    void poolThread();
+    void ringThread();
+
+public:
+    ReadAhead(const std::vector<string> &paths, const std::vector<unsigned> &order, unsigned window, unsigned threads);
+    ~ReadAhead();
+
+    int get(unsigned file, string &data);
+
+    bool uring() const;
+    double wait() const;
+    uint64_t bytes() const;
+};
+
+# endif /* READAHEAD_H */
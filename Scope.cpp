@@ -15,6 +15,9 @@
 
 # include <cassert>
 # include "Scope.h"
+# include "Stats.h"
+# include "Memory.h"
+# include "probes.h"
 
 
 /*
@@ -26,6 +29,21 @@
 Scope::Scope(Scope *enclosing)
     : _enclosing(enclosing)
 {
+    if (memory != nullptr)
+	memory->scope(1);
+}
+
+
+/*
+ * Function:	Scope::~Scope (destructor)
+ *
+ * Description:	Deallocate this scope object, but not its symbols.
+ */
+
+Scope::~Scope()
+{
+    if (memory != nullptr)
+	memory->scope(-1);
 }
 
 
@@ -39,8 +57,16 @@ Scope::Scope(Scope *enclosing)
 
 void Scope::insert(Symbol *symbol)
 {
+    Memory::Tag tag(Memory::SCOPES);
+
+
     assert(find(symbol->name()) == nullptr);
     _symbols.push_back(symbol);
+    _index.emplace(symbol->name(), symbol);
+    PROBE2(symbol__insert, symbol->name().c_str(), this);
+
+    if (stats != nullptr)
+	stats->insert();
 }
 
 
@@ -53,11 +79,10 @@ void Scope::insert(Symbol *symbol)
 
 Symbol *Scope::find(const string &name) const
 {
-    for (auto symbol : _symbols)
-	if (name == symbol->name())
-	    return symbol;
+    auto it = _index.find(name);
+
 
-    return nullptr;
+    return it != _index.end() ? it->second : nullptr;
 }
 
 
@@ -65,16 +90,25 @@ Symbol *Scope::find(const string &name) const
  * Function:	Scope::remove
  *
  * Description:	Remove the symbol with the given name from this scope.
- *		And, yes, I didn't use an iterator.  So sue me.
+ *		The most recently inserted symbols are the ones most often
+ *		removed, so we search from the end.
  */
 
 void Scope::remove(const string &name)
 {
-    for (unsigned i = 0; i < _symbols.size(); i ++)
-	if (name == _symbols[i]->name()) {
+    auto it = _index.find(name);
+
+
+    if (it == _index.end())
+	return;
+
+    for (unsigned i = _symbols.size(); i -- > 0; )
+	if (_symbols[i] == it->second) {
 	    _symbols.erase(_symbols.begin() + i);
 	    break;
 	}
+
+    _index.erase(it);
 }
 
 
@@ -89,13 +123,21 @@ void Scope::remove(const string &name)
 
 Symbol *Scope::lookup(const string &name) const
 {
+    const Scope *scope = this;
     Symbol *symbol;
+    unsigned depth;
+
+
+    for (depth = 1; (symbol = scope->find(name)) == nullptr; depth ++)
+	if ((scope = scope->_enclosing) == nullptr)
+	    break;
 
+    PROBE3(symbol__lookup, name.c_str(), depth, symbol);
 
-    if ((symbol = find(name)) != nullptr)
-	return symbol;
+    if (stats != nullptr)
+	stats->lookup(depth);
 
-    return _enclosing != nullptr ? _enclosing->lookup(name) : nullptr;
+    return symbol;
 }
 
 
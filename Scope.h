@@ -3,9 +3,11 @@
  *
  * Description:	This file contains the class definition for scopes in
  *		Simple C.  A scope consists simply of a list of symbols.
- *		We use a vector rather than a map because we want to keep
- *		the symbols in insertion order, and we expect the number of
- *		symbols inserted to be small.
+ *		We use a vector because we want to keep the symbols in
+ *		insertion order.  The outermost scope of a large unit is
+ *		anything but small, though, and a document looks names up
+ *		in it for every edit, so each scope also indexes its
+ *		symbols by name.
  *
  *		Each scope has a link to its enclosing scope.  By
  *		convention, a null scope is used if there is no enclosing
@@ -18,6 +20,7 @@
 # define SCOPE_H
 # include "Symbol.h"
 # include <vector>
+# include <unordered_map>
 
 typedef std::vector<Symbol *> Symbols;
 
@@ -26,9 +29,11 @@ class Scope {
 
     Scope *_enclosing;
     Symbols _symbols;
+    std::unordered_map<string, Symbol *> _index;
 
 public:
     Scope(Scope *enclosing = nullptr);
+    ~Scope();
 
     void insert(Symbol *symbol);
     void remove(const string &name);
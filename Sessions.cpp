@@ -0,0 +1,77 @@
+/*
+ * File:	Sessions.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		sessions of a server.  The sessions are kept in a list from
+ *		the most recently used to the least, and indexed by name.
+ */
+
+# include "Sessions.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Sessions::Sessions (constructor)
+ *
+ * Description:	Initialize these sessions as empty, keeping at most the
+ *		given number, which is at least one.
+ */
+
+Sessions::Sessions(size_t capacity)
+    : _capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+
+/*
+ * Function:	Sessions::find
+ *
+ * Description:	Return the session of the given name, starting one if there
+ *		is none, and mark it as the most recently used.  Starting
+ *		a session may drop the least recently used one.
+ */
+
+shared_ptr<Sessions::Session> Sessions::find(const string &name)
+{
+    auto it = _index.find(name);
+
+
+    if (it != _index.end()) {
+	_recent.splice(_recent.begin(), _recent, it->second);
+	return _recent.front().second;
+    }
+
+    if (_recent.size() == _capacity) {
+	_index.erase(_recent.back().first);
+	_recent.pop_back();
+    }
+
+    _recent.emplace_front(name, make_shared<Session>());
+    _index[name] = _recent.begin();
+    return _recent.front().second;
+}
+
+
+/*
+ * Function:	Sessions::contains (accessor)
+ *
+ * Description:	Return whether there is a session of the given name.
+ */
+
+bool Sessions::contains(const string &name) const
+{
+    return _index.count(name) > 0;
+}
+
+
+/*
+ * Function:	Sessions::size (accessor)
+ *
+ * Description:	Return the number of sessions kept.
+ */
+
+size_t Sessions::size() const
+{
+    return _index.size();
+}
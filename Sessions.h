@@ -0,0 +1,60 @@
+/*
+ * File:	Sessions.h
+ *
+ * Description:	This file contains the class definition for the sessions of
+ *		a server, each of which keeps the incremental engine for
+ *		the checks of one name.  An engine holds the units of its
+ *		last check, so only a fixed number of sessions are kept,
+ *		and the one used least recently is dropped to make room
+ *		for a new one.  A dropped session lives on for as long as
+ *		a check still holds it, but the next check of its name
+ *		starts afresh.
+ *
+ *		Each session also keeps the text last asked for under its
+ *		name, so that a client may send just an edit to it, and
+ *		the edits not yet noted by the engine.  These and the
+ *		sessions themselves are not locked; the server must keep
+ *		them under its own lock.
+ */
+
+# ifndef SESSIONS_H
+# define SESSIONS_H
+# include <list>
+# include <mutex>
+# include <memory>
+# include <string>
+# include <vector>
+# include <unordered_map>
+# include "Incremental.h"
+
+class Sessions {
+public:
+    struct Edit {
+	size_t offset, removed, inserted;
+    };
+
+    struct Session {
+	std::mutex lock;		/* held while the engine checks */
+	Incremental engine;
+	std::string text;		/* the text last asked for */
+	std::vector<Edit> edits;	/* edits not yet noted by the engine */
+	bool replaced;			/* whether it was replaced since */
+    };
+
+private:
+    typedef std::string string;
+    typedef std::list<std::pair<string, std::shared_ptr<Session>>> List;
+
+    size_t _capacity;
+    List _recent;
+    std::unordered_map<string, List::iterator> _index;
+
+public:
+    Sessions(size_t capacity);
+
+    std::shared_ptr<Session> find(const string &name);
+    bool contains(const string &name) const;
+    size_t size() const;
+};
+
+# endif /* SESSIONS_H */
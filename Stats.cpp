@@ -0,0 +1,555 @@
+/*
+ * File:	Stats.cpp
+ *
+ * Description:	This file contains the member function definitions for the
+ *		statistics gathered while checking a translation unit.
+ */
+
+# include <ctime>
+# include <iomanip>
+# include <algorithm>
+# include "lexer.h"
+# include "Stats.h"
+# include "Memory.h"
+
+using namespace std;
+
+thread_local Stats *stats;
+
+static const char *keywords[] = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if", "int",
+    "long", "register", "return", "short", "signed", "sizeof", "static",
+    "struct", "switch", "typedef", "union", "unsigned", "void", "volatile",
+    "while",
+};
+
+static const char *operators[] = {
+    "||", "&&", "==", "!=", "<=", ">=", "++", "--", "->",
+    "identifier", "number", "string", "error", "end of file",
+};
+
+static const char *phases[] = {"parse", "lex", "check", "output"};
+
+
+
+/*
+ * Function:	now
+ *
+ * Description:	Return the time of the given clock in seconds.
+ */
+
+static double now(clockid_t clock)
+{
+    struct timespec ts;
+
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Function:	name
+ *
+ * Description:	Return the name of the given token.
+ */
+
+static string name(int token)
+{
+    if (token < AUTO)
+	return string("'") + (char) token + "'";
+
+    if (token < OR)
+	return keywords[token - AUTO];
+
+    return operators[token - OR];
+}
+
+
+/*
+ * Function:	Stats::Stats (constructor)
+ *
+ * Description:	Initialize these statistics with all counts zero, to list
+ *		the given number of the most expensive declarations.
+ */
+
+Stats::Stats(unsigned top)
+    : _cpu(0), _last(0), _start(0), _mark(0), _counters(nullptr),
+      _charging(false), _top(top), _count(0), _deepest(0), _scopes(0), _depth(0), _peak(0),
+      _symbols(0), _largest(0), _lookups(0), _walked(0), _types(0),
+      _diagnostics(0)
+{
+    fill(_wall, _wall + PHASES, 0);
+    fill(&_events[0][0], &_events[0][0] + PHASES * Counters::EVENTS, 0);
+    fill(_previous, _previous + Counters::EVENTS, 0);
+    fill(_marks, _marks + Counters::EVENTS, 0);
+    fill(_tokens, _tokens + DONE + 1, 0);
+}
+
+
+/*
+ * Function:	Stats::~Stats (destructor)
+ *
+ * Description:	Deallocate the hardware counters of these statistics.
+ */
+
+Stats::~Stats()
+{
+    delete _counters;
+}
+
+
+/*
+ * Function:	Stats::count
+ *
+ * Description:	Count hardware events as well as time, if the machine will
+ *		let us.  Return whether it will.
+ */
+
+bool Stats::count()
+{
+    if (_counters == nullptr) {
+	_counters = new Counters();
+
+	if (!_counters->open()) {
+	    delete _counters;
+	    _counters = nullptr;
+	}
+    }
+
+    return _counters != nullptr;
+}
+
+
+/*
+ * Function:	Stats::start
+ *
+ * Description:	Start timing, beginning in the parser.
+ */
+
+void Stats::start()
+{
+    _phases.assign(1, PARSE);
+    _cpu -= now(CLOCK_THREAD_CPUTIME_ID);
+    _start = _last = now(CLOCK_MONOTONIC);
+
+    if (_counters != nullptr)
+	_counters->read(_previous);
+}
+
+
+/*
+ * Function:	Stats::stop
+ *
+ * Description:	Stop timing, charging the time since the last change to the
+ *		current phase.
+ */
+
+void Stats::stop()
+{
+    charge();
+    _cpu += now(CLOCK_THREAD_CPUTIME_ID);
+    _phases.clear();
+}
+
+
+/*
+ * Function:	Stats::charge
+ *
+ * Description:	Charge the time since the last change to the current phase.
+ */
+
+void Stats::charge()
+{
+    double t = now(CLOCK_MONOTONIC);
+    uint64_t values[Counters::EVENTS];
+
+
+    _wall[_phases.back()] += t - _last;
+    _last = t;
+
+    if (_counters != nullptr && _counters->read(values))
+	for (int i = 0; i < Counters::EVENTS; i ++) {
+	    _events[_phases.back()][i] += values[i] - _previous[i];
+	    _previous[i] = values[i];
+	}
+}
+
+
+/*
+ * Function:	Stats::enter
+ *
+ * Description:	Enter the given phase, which ends when it is left.
+ */
+
+void Stats::enter(Phase phase)
+{
+    charge();
+    _phases.push_back(phase);
+}
+
+
+/*
+ * Function:	Stats::leave
+ *
+ * Description:	Leave the current phase, returning to the one before it.
+ */
+
+void Stats::leave()
+{
+    charge();
+    _phases.pop_back();
+}
+
+
+/*
+ * Function:	Stats::Timer::Timer (constructor)
+ *
+ * Description:	Enter the given phase of the statistics of this thread, if
+ *		they are being gathered, for the lifetime of this timer.
+ */
+
+Stats::Timer::Timer(Phase phase)
+    : _active(stats != nullptr && !stats->_phases.empty())
+{
+    if (_active)
+	stats->enter(phase);
+}
+
+
+/*
+ * Function:	Stats::Timer::~Timer (destructor)
+ *
+ * Description:	Leave the phase entered by this timer.
+ */
+
+Stats::Timer::~Timer()
+{
+    if (_active)
+	stats->leave();
+}
+
+
+/*
+ * Function:	Stats::token
+ *
+ * Description:	Count the given token, and the identifier it names if any.
+ */
+
+void Stats::token(int token, const string &lexbuf)
+{
+    Memory::Tag tag(Memory::OTHER);
+
+
+    _tokens[token] ++;
+    _count ++;
+
+    if (token == ID)
+	_identifiers.insert(lexbuf);
+}
+
+
+/*
+ * Function:	Stats::open
+ *
+ * Description:	Count a scope being opened.
+ */
+
+void Stats::open()
+{
+    _scopes ++;
+    _peak = max(_peak, ++ _depth);
+    _deepest = max(_deepest, _depth);
+}
+
+
+/*
+ * Function:	Stats::close
+ *
+ * Description:	Count a scope with the given number of symbols being
+ *		closed.
+ */
+
+void Stats::close(size_t symbols)
+{
+    _depth --;
+    _largest = max<unsigned long>(_largest, symbols);
+}
+
+
+/*
+ * Function:	Stats::begin
+ *
+ * Description:	Begin charging a top-level declaration.
+ */
+
+void Stats::begin()
+{
+    if (!_phases.empty()) {
+	charge();
+	_mark = _last;
+	copy(_previous, _previous + Counters::EVENTS, _marks);
+    }
+
+    _charging = true;
+    _current.name.clear();
+    _current.line = lineno;
+    _current.tokens = _count;
+    _current.symbols = _symbols;
+    _current.diagnostics = _diagnostics;
+    _deepest = _depth;
+}
+
+
+/*
+ * Function:	Stats::declare
+ *
+ * Description:	Name the top-level declaration being charged and give the
+ *		line it is on.
+ */
+
+void Stats::declare(const string &name, int line)
+{
+    Memory::Tag tag(Memory::OTHER);
+
+
+    _current.name = name;
+    _current.line = line;
+}
+
+
+/*
+ * Function:	Stats::end
+ *
+ * Description:	End charging the current top-level declaration, if one is
+ *		being charged.
+ */
+
+void Stats::end()
+{
+    Memory::Tag tag(Memory::OTHER);
+
+
+    if (!_charging)
+	return;
+
+    _charging = false;
+
+    if (!_phases.empty())
+	charge();
+
+    _current.wall = _last - _mark;
+    _current.tokens = _count - _current.tokens;
+    _current.symbols = _symbols - _current.symbols;
+    _current.diagnostics = _diagnostics - _current.diagnostics;
+    _current.depth = _deepest;
+
+    for (int i = 0; i < Counters::EVENTS; i ++)
+	_current.events[i] = _previous[i] - _marks[i];
+
+    _declarations.push_back(_current);
+}
+
+
+/*
+ * Function:	Stats::insert
+ *
+ * Description:	Count a symbol being inserted into a scope.
+ */
+
+void Stats::insert()
+{
+    _symbols ++;
+}
+
+
+/*
+ * Function:	Stats::lookup
+ *
+ * Description:	Count a lookup that searched the given number of scopes.
+ */
+
+void Stats::lookup(unsigned depth)
+{
+    _lookups ++;
+    _walked += depth;
+}
+
+
+/*
+ * Function:	Stats::type
+ *
+ * Description:	Count a type being constructed.
+ */
+
+void Stats::type()
+{
+    _types ++;
+}
+
+
+/*
+ * Function:	Stats::diagnostic
+ *
+ * Description:	Count a diagnostic being reported.
+ */
+
+void Stats::diagnostic()
+{
+    _diagnostics ++;
+}
+
+
+/*
+ * Function:	Stats::events
+ *
+ * Description:	Write the given hardware counts to the given stream, with
+ *		the instructions per cycle.
+ */
+
+void Stats::events(ostream &out, const uint64_t values[]) const
+{
+    for (int i = 0; i < Counters::EVENTS; i ++)
+	if (_counters->available((Counters::Event) i))
+	    out << setw(14) << values[i];
+	else
+	    out << setw(14) << "-";
+
+    out << setprecision(2) << setw(7);
+
+    if (values[Counters::CYCLES] > 0)
+	out << (double) values[Counters::INSTRUCTIONS] / values[Counters::CYCLES];
+    else
+	out << "-";
+
+    out << setprecision(3);
+}
+
+
+/*
+ * Function:	Stats::write
+ *
+ * Description:	Write these statistics to the given stream.  The tokens
+ *		are listed by kind, most frequent first, and the most
+ *		expensive declarations by time, slowest first.
+ */
+
+void Stats::write(ostream &out) const
+{
+    vector<pair<unsigned long, int>> kinds;
+    vector<const Declaration *> slowest;
+    uint64_t totals[Counters::EVENTS] = {0};
+    unsigned long tokens = 0;
+    double wall = 0;
+
+
+    for (int i = 0; i < PHASES; i ++)
+	wall += _wall[i];
+
+    out << fixed << setprecision(3);
+    out << left << setw(12) << "phase" << right << setw(12) << "wall ms";
+    out << setw(12) << "cpu ms";
+
+    if (_counters != nullptr) {
+	out << setw(14) << "cycles" << setw(14) << "instructions";
+	out << setw(14) << "branch misses" << setw(14) << "L1 misses";
+	out << setw(14) << "LLC misses" << setw(7) << "IPC";
+    }
+
+    out << endl;
+
+    for (int i = 0; i < PHASES; i ++) {
+	out << left << setw(12) << phases[i] << right;
+	out << setw(12) << _wall[i] * 1e3;
+	out << setw(12) << (wall > 0 ? _cpu * _wall[i] / wall : 0) * 1e3;
+
+	if (_counters != nullptr)
+	    events(out, _events[i]);
+
+	for (int j = 0; j < Counters::EVENTS; j ++)
+	    totals[j] += _events[i][j];
+
+	out << endl;
+    }
+
+    out << left << setw(12) << "total" << right << setw(12) << wall * 1e3;
+    out << setw(12) << _cpu * 1e3;
+
+    if (_counters != nullptr)
+	events(out, totals);
+
+    out << endl << endl;
+
+    for (auto &d : _declarations)
+	slowest.push_back(&d);
+
+    sort(slowest.begin(), slowest.end(), [](const Declaration *a, const Declaration *b) {
+	return a->wall > b->wall;
+    });
+
+    if (!slowest.empty() && _top > 0) {
+	out << left << setw(24) << "declaration" << right << setw(8) << "line";
+	out << setw(12) << "wall ms" << setw(10) << "tokens" << setw(9) << "symbols";
+	out << setw(7) << "depth" << setw(13) << "diagnostics";
+
+	if (_counters != nullptr) {
+	    out << setw(14) << "cycles" << setw(14) << "instructions";
+	    out << setw(14) << "branch misses" << setw(14) << "L1 misses";
+	    out << setw(14) << "LLC misses" << setw(7) << "IPC";
+	}
+
+	out << endl;
+
+	for (size_t i = 0; i < slowest.size() && i < _top; i ++) {
+	    const Declaration &d = *slowest[i];
+
+	    out << left << setw(24) << d.name << right << setw(8) << d.line;
+	    out << setw(12) << d.wall * 1e3 << setw(10) << d.tokens;
+	    out << setw(9) << d.symbols << setw(7) << d.depth;
+	    out << setw(13) << d.diagnostics;
+
+	    if (_counters != nullptr)
+		events(out, d.events);
+
+	    out << endl;
+	}
+
+	if (slowest.size() > _top)
+	    out << "(and " << slowest.size() - _top << " more)" << endl;
+
+	out << endl;
+    }
+
+    for (int i = 0; i <= DONE; i ++)
+	if (_tokens[i] > 0) {
+	    kinds.emplace_back(_tokens[i], i);
+	    tokens += _tokens[i];
+	}
+
+    sort(kinds.begin(), kinds.end(), [](const pair<unsigned long, int> &a, const pair<unsigned long, int> &b) {
+	return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    out << setprecision(2);
+    out << left << setw(16) << "tokens" << right << setw(12) << tokens << endl;
+
+    for (auto &kind : kinds)
+	out << "  " << left << setw(14) << name(kind.second) << right << setw(12) << kind.first << endl;
+
+    out << left << setw(16) << "identifiers" << right << setw(12) << _tokens[ID];
+    out << " (" << _identifiers.size() << " distinct)" << endl;
+
+    out << left << setw(16) << "scopes" << right << setw(12) << _scopes;
+    out << " (peak depth " << _peak << ")" << endl;
+
+    out << left << setw(16) << "symbols" << right << setw(12) << _symbols;
+    out << " (" << (_scopes > 0 ? (double) _symbols / _scopes : 0) << " per scope, ";
+    out << "largest " << _largest << ")" << endl;
+
+    out << left << setw(16) << "lookups" << right << setw(12) << _lookups;
+    out << " (" << (_lookups > 0 ? (double) _walked / _lookups : 0) << " scopes walked on average)" << endl;
+
+    out << left << setw(16) << "types" << right << setw(12) << _types << endl;
+    out << left << setw(16) << "diagnostics" << right << setw(12) << _diagnostics << endl;
+}
@@ -0,0 +1,106 @@
+/*
+ * File:	Stats.h
+ *
+ * Description:	This file contains the class definition for the statistics
+ *		gathered while checking a translation unit.  The front end
+ *		counts into the statistics of the calling thread, if any,
+ *		so that a disabled count costs only a test of a null
+ *		pointer.
+ *
+ *		The phases interleave, since the parser asks the lexer for
+ *		one token at a time and calls the checker as it goes, so
+ *		the time of each phase is charged to it as the phases are
+ *		entered and left, with the time not charged elsewhere
+ *		going to the parser.  Reading the processor time at every
+ *		change would cost more than most of the phases do, so it
+ *		is read only at the start and end and divided among the
+ *		phases by their shares of the wall time.
+ *
+ *		If hardware counters are requested and available, they
+ *		are read at every change as well, and charged both to the
+ *		phases and to each top-level declaration.
+ *
+ *		Each top-level declaration, which for a function includes
+ *		its body, is charged its time, tokens, symbols, deepest
+ *		scope, and diagnostics, so that the most expensive ones
+ *		can be listed.  A declaration abandoned at a syntax error
+ *		is charged for the part that was parsed.
+ */
+
+# ifndef STATS_H
+# define STATS_H
+# include <string>
+# include <vector>
+# include <ostream>
+# include <unordered_set>
+# include "tokens.h"
+# include "Counters.h"
+
+class Stats {
+public:
+    enum Phase { PARSE, LEX, CHECK, OUTPUT, PHASES };
+
+    class Timer {
+	bool _active;
+
+    public:
+	Timer(Phase phase);
+	~Timer();
+    };
+
+private:
+    typedef std::string string;
+
+    struct Declaration {
+	string name;
+	int line;
+	double wall;
+	unsigned long tokens, symbols, depth, diagnostics;
+	uint64_t events[Counters::EVENTS];
+    };
+
+    std::vector<Phase> _phases;
+    double _wall[PHASES], _cpu, _last, _start, _mark;
+    Counters *_counters;
+    uint64_t _events[PHASES][Counters::EVENTS];
+    uint64_t _previous[Counters::EVENTS], _marks[Counters::EVENTS];
+    std::vector<Declaration> _declarations;
+    Declaration _current;
+    bool _charging;
+    unsigned _top;
+    unsigned long _tokens[DONE + 1], _count, _deepest;
+    std::unordered_set<string> _identifiers;
+    unsigned long _scopes, _depth, _peak, _symbols, _largest;
+    unsigned long _lookups, _walked, _types, _diagnostics;
+
+    void charge();
+    void events(std::ostream &out, const uint64_t values[]) const;
+
+public:
+    Stats(unsigned top = 10);
+    ~Stats();
+
+    bool count();
+
+    void start();
+    void stop();
+    void enter(Phase phase);
+    void leave();
+
+    void token(int token, const string &lexbuf);
+    void open();
+    void close(size_t symbols);
+    void begin();
+    void declare(const string &name, int line);
+    void end();
+    void insert();
+    void lookup(unsigned depth);
+    void type();
+    void diagnostic();
+
+    void write(std::ostream &out) const;
+};
+
+extern thread_local Stats *stats;
+
+# endif /* STATS_H */
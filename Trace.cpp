@@ -0,0 +1,251 @@
+/*
+ * File:	Trace.cpp
+ *
+ * Description:	This file contains the member function definitions for a
+ *		timeline of the work done by each thread.
+ *
+ *		Only one trace is kept at a time, since each thread finds
+ *		its buffer through a pointer of its own.
+ */
+
+# include <ctime>
+# include <fstream>
+# include <iomanip>
+# include <unistd.h>
+# include "Memory.h"
+# include "Trace.h"
+
+using namespace std;
+
+Trace *trace;
+thread_local Trace::Buffer *Trace::_current;
+
+
+/*
+ * Function:	quote
+ *
+ * Description:	Return the given text as a JSON string.
+ */
+
+static string quote(const string &text)
+{
+    string s = "\"";
+
+
+    for (auto c : text)
+	if (c == '"' || c == '\\')
+	    s += string("\\") + c;
+	else if ((unsigned char) c < ' ')
+	    s += ' ';
+	else
+	    s += c;
+
+    return s + "\"";
+}
+
+
+/*
+ * Function:	Trace::Trace (constructor)
+ *
+ * Description:	Initialize this trace, starting its clock.
+ */
+
+Trace::Trace()
+    : _origin(0)
+{
+    _origin = now();
+}
+
+
+/*
+ * Function:	Trace::~Trace (destructor)
+ *
+ * Description:	Deallocate the buffers of this trace.
+ */
+
+Trace::~Trace()
+{
+    for (auto buffer : _buffers)
+	delete buffer;
+}
+
+
+/*
+ * Function:	Trace::now
+ *
+ * Description:	Return the time since this trace was started in
+ *		microseconds.
+ */
+
+double Trace::now() const
+{
+    struct timespec ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3 - _origin;
+}
+
+
+/*
+ * Function:	Trace::buffer
+ *
+ * Description:	Return the buffer of the calling thread, creating it the
+ *		first time.
+ */
+
+Trace::Buffer *Trace::buffer()
+{
+    Buffer *b = _current;
+
+
+    if (b == nullptr) {
+	lock_guard<mutex> guard(_lock);
+	b = new Buffer();
+	b->id = _buffers.size() + 1;
+	b->name = "thread " + to_string(b->id);
+	_buffers.push_back(b);
+	_current = b;
+    }
+
+    return b;
+}
+
+
+/*
+ * Function:	Trace::thread
+ *
+ * Description:	Name the calling thread in the timeline.
+ */
+
+void Trace::thread(const string &name)
+{
+    Memory::Tag tag(Memory::OTHER);
+
+
+    buffer()->name = name;
+}
+
+
+/*
+ * Function:	Trace::record
+ *
+ * Description:	Record a span of the given category and name, which started
+ *		at the given time and ends now, with the given arguments
+ *		already written as the members of a JSON object.
+ */
+
+void Trace::record(const char *category, const string &name, double start, const string &args)
+{
+    Memory::Tag tag(Memory::OTHER);
+    Buffer *b = buffer();
+
+
+    b->events.emplace_back();
+    Event &e = b->events.back();
+    e.category = category;
+    e.name = name;
+    e.args = args;
+    e.start = start;
+    e.duration = now() - start;
+}
+
+
+/*
+ * Function:	Trace::save
+ *
+ * Description:	Write the spans of every thread to the given file.  Return
+ *		whether it was written.
+ */
+
+bool Trace::save(const string &path)
+{
+    lock_guard<mutex> guard(_lock);
+    ofstream out(path);
+    int pid = getpid();
+    const char *separator = "\n";
+
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    out << fixed << setprecision(3);
+
+    for (auto b : _buffers) {
+	out << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid;
+	out << ", \"tid\": " << b->id << ", \"args\": {\"name\": " << quote(b->name) << "}}";
+	separator = ",\n";
+
+	for (auto &e : b->events) {
+	    out << separator << "{\"name\": " << quote(e.name) << ", \"cat\": \"" << e.category;
+	    out << "\", \"ph\": \"X\", \"ts\": " << e.start << ", \"dur\": " << e.duration;
+	    out << ", \"pid\": " << pid << ", \"tid\": " << b->id;
+	    out << ", \"args\": {" << e.args << "}}";
+	}
+    }
+
+    out << "\n]}\n";
+    out.close();
+    return !out.fail();
+}
+
+
+/*
+ * Function:	Trace::Span::Span (constructor)
+ *
+ * Description:	Start a span of the given category and name, if a trace is
+ *		being kept.  The span is recorded when it is destroyed.
+ */
+
+Trace::Span::Span(const char *category, const char *name)
+    : _category(category), _start(0), _active(trace != nullptr)
+{
+    if (_active) {
+	Memory::Tag tag(Memory::OTHER);
+	_name = name;
+	_start = trace->now();
+    }
+}
+
+
+/*
+ * Function:	Trace::Span::~Span (destructor)
+ *
+ * Description:	Record this span as ending now.
+ */
+
+Trace::Span::~Span()
+{
+    if (_active)
+	trace->record(_category, _name, _start, _args);
+}
+
+
+/*
+ * Function:	Trace::Span::name
+ *
+ * Description:	Name this span, once its name is known.
+ */
+
+void Trace::Span::name(const string &name)
+{
+    if (_active) {
+	Memory::Tag tag(Memory::OTHER);
+	_name = name;
+    }
+}
+
+
+/*
+ * Function:	Trace::Span::arg
+ *
+ * Description:	Add the given argument to this span.
+ */
+
+void Trace::Span::arg(const char *key, long value)
+{
+    if (_active) {
+	Memory::Tag tag(Memory::OTHER);
+	_args += _args.empty() ? "\"" : ", \"";
+	_args += key;
+	_args += "\": " + to_string(value);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * File:	Trace.h
+ *
+ * Description:	This file contains the class definition for a timeline of
+ *		the work done by each thread, written in the trace event
+ *		format that Perfetto and chrome://tracing read.
+ *
+ *		A span is recorded when it ends, into a buffer belonging to
+ *		the calling thread, so that threads never contend to record
+ *		one.  The buffers belong to the trace and outlive their
+ *		threads, and are all written out together once the work is
+ *		done.  If no trace is being kept, a span costs only a test
+ *		of a null pointer.
+ */
+
+# ifndef TRACE_H
+# define TRACE_H
+# include <mutex>
+# include <string>
+# include <vector>
+
+class Trace {
+public:
+    class Span {
+	const char *_category;
+	std::string _name, _args;
+	double _start;
+	bool _active;
+
+    public:
+	Span(const char *category, const char *name = "");
+	~Span();
+
+	void name(const std::string &name);
+	void arg(const char *key, long value);
+    };
+
+private:
+    typedef std::string string;
+
+    struct Event {
+	const char *category;
+	string name, args;
+	double start, duration;
+    };
+
+    struct Buffer {
+	unsigned id;
+	string name;
+	std::vector<Event> events;
+    };
+
+    static thread_local Buffer *_current;
+
+    std::mutex _lock;
+    std::vector<Buffer *> _buffers;
+    double _origin;
+
+    Buffer *buffer();
+
+public:
+    Trace();
+    ~Trace();
+
+    double now() const;
+    void thread(const string &name);
+    void record(const char *category, const string &name, double start, const string &args);
+    bool save(const string &path);
+};
+
+extern Trace *trace;
+
+# endif /* TRACE_H */
@@ -0,0 +1,536 @@
+/*
+ * File:	Tree.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		syntax tree images in Simple C.
+ *
+ *		Types are interned as they are seen, so that the type
+ *		table holds each distinct type once.  Types without
+ *		parameter lists, which are nearly all of them, are found by
+ *		packing their fields into a single integer.  Symbols are
+ *		entered in the symbol table as they are declared.  Since
+ *		the checker may delete a symbol and allocate another at the
+ *		same address, a reference is only matched to an earlier
+ *		symbol with the same name.
+ */
+
+# include <cerrno>
+# include <cstring>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include "Tree.h"
+# include "Output.h"
+# include "Cache.h"
+# include "tokens.h"
+# include "lexer.h"
+
+using namespace std;
+
+
+/*
+ * Function:	align
+ *
+ * Description:	Return the given offset rounded up to eight bytes.
+ */
+
+static uint64_t align(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+
+/*
+ * Function:	writeAll
+ *
+ * Description:	Write all of the given bytes to a file, followed by enough
+ *		zeros to align the file to eight bytes.  Return whether the
+ *		write was successful.
+ */
+
+static bool writeAll(int fd, const void *data, size_t length)
+{
+    static const char zeros[8] = {0};
+    const char *p = (const char *) data;
+    size_t padding = align(length) - length;
+    ssize_t n;
+
+
+    while (length > 0) {
+	if ((n = write(fd, p, length)) <= 0)
+	    return false;
+
+	p += n;
+	length -= n;
+    }
+
+    return padding == 0 || write(fd, zeros, padding) == (ssize_t) padding;
+}
+
+
+/*
+ * Function:	checksum
+ *
+ * Description:	Return the checksum of the given arrays.
+ */
+
+static uint64_t checksum(const void *nodes, size_t nnodes, const void *symbols,
+	size_t nsymbols, const void *types, size_t ntypes, const void *params,
+	size_t nparams, const char *strings, size_t length)
+{
+    uint64_t h;
+
+
+    h = fingerprint(nodes, nnodes * sizeof(TreeNode));
+    h = fingerprint(symbols, nsymbols * sizeof(TreeSymbol), h);
+    h = fingerprint(types, ntypes * sizeof(TreeType), h);
+    h = fingerprint(params, nparams * sizeof(uint32_t), h);
+    return fingerprint(strings, length, h);
+}
+
+
+/*
+ * Function:	Tree::Tree (constructor)
+ *
+ * Description:	Initialize this tree as empty.
+ */
+
+Tree::Tree()
+    : _base(nullptr), _size(0)
+{
+}
+
+
+/*
+ * Function:	Tree::~Tree (destructor)
+ *
+ * Description:	Unmap the image of this tree, if any.
+ */
+
+Tree::~Tree()
+{
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+}
+
+
+/*
+ * Function:	Tree::intern (private)
+ *
+ * Description:	Return the index of the given type in the type table,
+ *		adding it if necessary.
+ */
+
+uint32_t Tree::intern(const Type &type)
+{
+    TreeType t;
+    uint64_t key;
+    string text;
+
+
+    memset(&t, 0, sizeof(t));
+    t.arity = -1;
+
+    if (type.isError())
+	t.kind = DUMP_ERROR;
+    else {
+	if (type.specifier() == CHAR)
+	    t.specifier = DUMP_CHAR;
+	else if (type.specifier() == INT)
+	    t.specifier = DUMP_INT;
+	else if (type.specifier() == VOID)
+	    t.specifier = DUMP_VOID;
+
+	t.indirection = type.indirection();
+
+	if (type.isArray()) {
+	    t.kind = DUMP_ARRAY;
+	    t.length = type.length();
+	} else if (type.isFunction())
+	    t.kind = DUMP_FUNCTION;
+	else
+	    t.kind = DUMP_SCALAR;
+    }
+
+    if (!type.isFunction() || type.parameters() == nullptr) {
+	key = (uint64_t) t.length << 32 | (uint64_t) t.indirection << 4;
+	key |= t.kind << 2 | t.specifier;
+
+	auto it = _scalars.find(key);
+
+	if (it != _scalars.end())
+	    return it->second;
+
+	_types.push_back(t);
+	return _scalars[key] = _types.size() - 1;
+    }
+
+    vector<uint32_t> params;
+
+    for (auto &param : *type.parameters())
+	params.push_back(intern(param));
+
+    text.assign((const char *) &t, sizeof(t));
+    text.append((const char *) params.data(), params.size() * sizeof(uint32_t));
+
+    auto it = _functions.find(text);
+
+    if (it != _functions.end())
+	return it->second;
+
+    t.parameters = _parameters.size();
+    t.arity = params.size();
+    _parameters.insert(_parameters.end(), params.begin(), params.end());
+    _types.push_back(t);
+    return _functions[text] = _types.size() - 1;
+}
+
+
+/*
+ * Function:	Tree::intern (private)
+ *
+ * Description:	Add the given text to the string pool and return its
+ *		offset.
+ */
+
+uint32_t Tree::intern(const string &text)
+{
+    uint32_t offset = _strings.size();
+
+
+    _strings.append(text);
+    _strings.push_back('\0');
+    return offset;
+}
+
+
+/*
+ * Function:	Tree::index (private)
+ *
+ * Description:	Return the index of the given symbol in the symbol table,
+ *		adding it if necessary or if a fresh entry is requested.
+ */
+
+uint32_t Tree::index(const Symbol *symbol, bool fresh)
+{
+    const string &name = symbol->name();
+    TreeSymbol s;
+
+
+    auto it = _indices.find(symbol);
+
+    if (!fresh && it != _indices.end()) {
+	uint32_t offset = _symbols[it->second].name;
+
+	if (_strings.compare(offset, name.size(), name) == 0 &&
+		_strings[offset + name.size()] == '\0')
+	    return it->second;
+    }
+
+    s.name = intern(name);
+    s.type = intern(symbol->type());
+    s.line = lineno;
+    s.unused = 0;
+
+    _symbols.push_back(s);
+    return _indices[symbol] = _symbols.size() - 1;
+}
+
+
+/*
+ * Function:	Tree::add (private)
+ *
+ * Description:	Add a node with the given number of children, which are
+ *		the most recent nodes not yet given a parent.
+ */
+
+void Tree::add(uint32_t kind, unsigned arity, uint32_t type, uint32_t value)
+{
+    TreeNode n;
+
+
+    n.kind = kind;
+    n.arity = arity;
+    n.extent = 1;
+    n.type = type;
+    n.line = lineno;
+    n.value = value;
+
+    for (unsigned i = 0; i < arity && !_pending.empty(); i ++) {
+	n.extent += _nodes[_pending.back()].extent;
+	_pending.pop_back();
+    }
+
+    _pending.push_back(_nodes.size());
+    _nodes.push_back(n);
+}
+
+
+/*
+ * Function:	Tree::clear
+ *
+ * Description:	Discard everything recorded so far.
+ */
+
+void Tree::clear()
+{
+    _nodes.clear();
+    _symbols.clear();
+    _types.clear();
+    _parameters.clear();
+    _pending.clear();
+    _strings.clear();
+    _indices.clear();
+    _scalars.clear();
+    _functions.clear();
+}
+
+
+/*
+ * Function:	Tree::pending
+ *
+ * Description:	Return the number of nodes not yet given a parent.  The
+ *		parser uses this to count the children of a construct with
+ *		any number of them.
+ */
+
+unsigned Tree::pending() const
+{
+    return _pending.size();
+}
+
+
+/*
+ * Function:	Tree::node
+ *
+ * Description:	Add a statement node with the given number of children.
+ */
+
+void Tree::node(int kind, unsigned arity)
+{
+    add(kind, arity, TREE_NONE, TREE_NONE);
+}
+
+
+/*
+ * Function:	Tree::node
+ *
+ * Description:	Add an expression node of the given type with the given
+ *		number of children.
+ */
+
+void Tree::node(int kind, unsigned arity, const Type &type)
+{
+    add(kind, arity, intern(type), TREE_NONE);
+}
+
+
+/*
+ * Function:	Tree::literal
+ *
+ * Description:	Add a leaf for a number or string with the given text.
+ */
+
+void Tree::literal(int kind, const Type &type, const string &text)
+{
+    add(kind, 0, intern(type), intern(text));
+}
+
+
+/*
+ * Function:	Tree::reference
+ *
+ * Description:	Add a leaf for a use of the given symbol.
+ */
+
+void Tree::reference(const Symbol *symbol)
+{
+    uint32_t n = index(symbol, false);
+    add(TREE_IDENTIFIER, 0, _symbols[n].type, n);
+}
+
+
+/*
+ * Function:	Tree::declaration
+ *
+ * Description:	Add a leaf for a declaration of the given symbol.  A
+ *		redeclaration refers to the symbol already declared.
+ */
+
+void Tree::declaration(const Symbol *symbol)
+{
+    uint32_t n = index(symbol, false);
+    add(TREE_DECLARATION, 0, _symbols[n].type, n);
+}
+
+
+/*
+ * Function:	Tree::function
+ *
+ * Description:	Add a node for the definition of the given function, with
+ *		its parameters and body as its children.
+ */
+
+void Tree::function(const Symbol *symbol, unsigned arity)
+{
+    uint32_t n = index(symbol, true);
+    add(TREE_FUNCTION, arity, _symbols[n].type, n);
+}
+
+
+/*
+ * Function:	Tree::finish
+ *
+ * Description:	Add the root node, adopting every node not yet given a
+ *		parent, including any left over from an abandoned unit.
+ */
+
+void Tree::finish()
+{
+    add(TREE_UNIT, _pending.size(), TREE_NONE, TREE_NONE);
+}
+
+
+/*
+ * Function:	Tree::save
+ *
+ * Description:	Write the image of this tree to the given file.  Return
+ *		whether the image was written.
+ */
+
+bool Tree::save(const string &path, int status, unsigned errors) const
+{
+    TreeImage header;
+    bool ok;
+    int fd;
+
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TREE_MAGIC, sizeof(header.magic));
+    header.version = TREE_VERSION;
+    header.status = status;
+    header.errors = errors;
+
+    header.nodes = align(sizeof(header));
+    header.count = _nodes.size();
+    header.symbols = align(header.nodes + _nodes.size() * sizeof(TreeNode));
+    header.nsymbols = _symbols.size();
+    header.types = align(header.symbols + _symbols.size() * sizeof(TreeSymbol));
+    header.ntypes = _types.size();
+    header.parameters = align(header.types + _types.size() * sizeof(TreeType));
+    header.nparams = _parameters.size();
+    header.strings = align(header.parameters + _parameters.size() * sizeof(uint32_t));
+    header.nstrings = _strings.size();
+    header.size = align(header.strings + _strings.size());
+
+    header.checksum = checksum(_nodes.data(), _nodes.size(), _symbols.data(),
+	_symbols.size(), _types.data(), _types.size(), _parameters.data(),
+	_parameters.size(), _strings.data(), _strings.size());
+
+    if ((fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+	return false;
+
+    ok = writeAll(fd, &header, sizeof(header)) &&
+	writeAll(fd, _nodes.data(), _nodes.size() * sizeof(TreeNode)) &&
+	writeAll(fd, _symbols.data(), _symbols.size() * sizeof(TreeSymbol)) &&
+	writeAll(fd, _types.data(), _types.size() * sizeof(TreeType)) &&
+	writeAll(fd, _parameters.data(), _parameters.size() * sizeof(uint32_t)) &&
+	writeAll(fd, _strings.data(), _strings.size());
+
+    return close(fd) == 0 && ok;
+}
+
+
+/*
+ * Function:	Tree::open
+ *
+ * Description:	Map the image in the given file.  Only the header is
+ *		checked.  Return false, with errno set, if the image cannot
+ *		be mapped or its header is not valid.
+ */
+
+bool Tree::open(const string &path)
+{
+    const TreeImage *h;
+    struct stat st;
+    void *base;
+    int fd;
+
+
+    if ((fd = ::open(path.c_str(), O_RDONLY)) < 0)
+	return false;
+
+    if (fstat(fd, &st) < 0)
+	base = MAP_FAILED;
+    else if (st.st_size < (off_t) sizeof(TreeImage))
+	base = MAP_FAILED, errno = EINVAL;
+    else
+	base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (base == MAP_FAILED)
+	return false;
+
+    h = (const TreeImage *) base;
+
+    if (memcmp(h->magic, TREE_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != TREE_VERSION || h->size != (uint64_t) st.st_size ||
+	    h->nodes < sizeof(TreeImage) || h->nodes % 8 != 0 ||
+	    h->count > (h->symbols - h->nodes) / sizeof(TreeNode) ||
+	    h->symbols < h->nodes || h->symbols % 8 != 0 ||
+	    h->nsymbols > (h->types - h->symbols) / sizeof(TreeSymbol) ||
+	    h->types < h->symbols || h->types % 8 != 0 ||
+	    h->ntypes > (h->parameters - h->types) / sizeof(TreeType) ||
+	    h->parameters < h->types || h->parameters % 8 != 0 ||
+	    h->nparams > (h->strings - h->parameters) / sizeof(uint32_t) ||
+	    h->strings < h->parameters || h->strings > h->size ||
+	    h->nstrings > h->size - h->strings) {
+	munmap(base, st.st_size);
+	errno = EINVAL;
+	return false;
+    }
+
+    if (_base != nullptr)
+	munmap((void *) _base, _size);
+
+    _base = (const char *) base;
+    _size = st.st_size;
+    return true;
+}
+
+
+/*
+ * Function:	Tree::verify
+ *
+ * Description:	Return whether the checksum of the image of this tree
+ *		matches its contents.
+ */
+
+bool Tree::verify() const
+{
+    const TreeImage *h = image();
+
+
+    if (h == nullptr)
+	return false;
+
+    return h->checksum == checksum(_base + h->nodes, h->count,
+	_base + h->symbols, h->nsymbols, _base + h->types, h->ntypes,
+	_base + h->parameters, h->nparams, _base + h->strings, h->nstrings);
+}
+
+
+/*
+ * Function:	Tree::image (accessor)
+ *
+ * Description:	Return the header of the mapped image of this tree, from
+ *		which its arrays may be found, or a null pointer if no
+ *		image is mapped.
+ */
+
+const TreeImage *Tree::image() const
+{
+    return (const TreeImage *) _base;
+}
@@ -0,0 +1,138 @@
+/*
+ * File:	Tree.h
+ *
+ * Description:	This file contains the class definition for syntax tree
+ *		images in Simple C.  Our parser checks as it goes and
+ *		never builds a tree, so when asked, it records each
+ *		construct it finishes instead, in postfix order.  The
+ *		record is written as an image that later passes can simply
+ *		map into memory and walk, with no parsing of any kind.
+ *
+ *		The image contains no pointers, only offsets and indices,
+ *		so it may be mapped at any address.  Its layout is
+ *		described by the TreeImage structure below: a fixed header,
+ *		the node array, the symbol table, the type table, the
+ *		parameter lists of the function types, and finally a pool
+ *		of null-terminated names and literals.  Each array is
+ *		aligned to eight bytes.  Kinds and specifiers of types use
+ *		the same codes as the binary symbol dump.
+ *
+ *		Since the nodes are in postfix order, the children of a
+ *		node immediately precede it.  Its last child is the node
+ *		just before it, and the sibling before any child is found
+ *		by skipping back over the extent of that child.  The root,
+ *		a TREE_UNIT node, is always the last node.
+ *
+ *		Opening an image checks only its header, so that even a
+ *		huge image is available at once.  The checksum covers each
+ *		of the arrays in turn, and is checked only on request.
+ */
+
+# ifndef TREE_H
+# define TREE_H
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+# include <unordered_map>
+# include "Symbol.h"
+
+# define TREE_MAGIC "SCCTREE"
+# define TREE_VERSION 1
+# define TREE_NONE 0xffffffff
+
+enum {
+    TREE_UNIT, TREE_FUNCTION, TREE_DECLARATION, TREE_BLOCK,
+    TREE_RETURN, TREE_WHILE, TREE_FOR, TREE_IF, TREE_ASSIGN,
+
+    TREE_IDENTIFIER, TREE_NUMBER, TREE_STRING, TREE_CALL, TREE_INDEX,
+    TREE_NOT, TREE_NEG, TREE_DEREF, TREE_ADDR, TREE_SIZEOF,
+    TREE_MUL, TREE_DIV, TREE_REM, TREE_ADD, TREE_SUB,
+    TREE_LTN, TREE_GTN, TREE_LEQ, TREE_GEQ, TREE_EQL, TREE_NEQ,
+    TREE_AND, TREE_OR
+};
+
+struct TreeNode {
+    uint32_t kind;		/* TREE_UNIT, ... */
+    uint32_t arity;		/* number of children */
+    uint32_t extent;		/* number of nodes in the subtree */
+    uint32_t type;		/* index into types, or TREE_NONE */
+    uint32_t line;		/* line on which the node was finished */
+    uint32_t value;		/* index into symbols, offset into strings,
+				   or TREE_NONE */
+};
+
+struct TreeSymbol {
+    uint32_t name;		/* offset into strings */
+    uint32_t type;		/* index into types */
+    uint32_t line;		/* line of the declaration */
+    uint32_t unused;
+};
+
+struct TreeType {
+    uint8_t kind;		/* DUMP_SCALAR, ... */
+    uint8_t specifier;		/* DUMP_CHAR, ... */
+    uint16_t unused;
+    uint32_t indirection;
+    uint32_t length;		/* zero unless an array */
+    uint32_t parameters;	/* index into parameters */
+    int32_t arity;		/* -1 unless specified */
+};
+
+struct TreeImage {
+    char magic[8];		/* TREE_MAGIC */
+    uint32_t version;		/* TREE_VERSION */
+    int32_t status;		/* exit status of the translation unit */
+    uint32_t errors;		/* number of errors reported */
+    uint32_t unused;
+    uint64_t checksum;		/* fingerprint of the arrays */
+    uint64_t nodes, count;	/* TreeNode[count] */
+    uint64_t symbols, nsymbols;	/* TreeSymbol[nsymbols] */
+    uint64_t types, ntypes;	/* TreeType[ntypes] */
+    uint64_t parameters, nparams; /* uint32_t[nparams], indices into types */
+    uint64_t strings, nstrings;	/* char[nstrings], null-terminated text */
+    uint64_t size;		/* total size of the image in bytes */
+};
+
+class Tree {
+    typedef std::string string;
+
+    std::vector<TreeNode> _nodes;
+    std::vector<TreeSymbol> _symbols;
+    std::vector<TreeType> _types;
+    std::vector<uint32_t> _parameters, _pending;
+    string _strings;
+
+    std::unordered_map<const Symbol *, uint32_t> _indices;
+    std::unordered_map<uint64_t, uint32_t> _scalars;
+    std::unordered_map<string, uint32_t> _functions;
+
+    const char *_base;
+    size_t _size;
+
+    uint32_t intern(const Type &type);
+    uint32_t intern(const string &text);
+    uint32_t index(const Symbol *symbol, bool fresh);
+    void add(uint32_t kind, unsigned arity, uint32_t type, uint32_t value);
+
+public:
+    Tree();
+    ~Tree();
+
+    void clear();
+    unsigned pending() const;
+    void node(int kind, unsigned arity);
+    void node(int kind, unsigned arity, const Type &type);
+    void literal(int kind, const Type &type, const string &text);
+    void reference(const Symbol *symbol);
+    void declaration(const Symbol *symbol);
+    void function(const Symbol *symbol, unsigned arity);
+    void finish();
+    bool save(const string &path, int status, unsigned errors) const;
+
+    bool open(const string &path);
+    bool verify() const;
+    const TreeImage *image() const;
+};
+
+# endif /* TREE_H */
@@ -22,6 +22,7 @@
 # include <cassert>
 # include "tokens.h"
 # include "Type.h"
+# include "Stats.h"
 
 using namespace std;
 
@@ -35,6 +36,8 @@ using namespace std;
 Type::Type()
     : _kind(ERROR)
 {
+    if (stats != nullptr)
+	stats->type();
 }
 
 
@@ -47,6 +50,8 @@ Type::Type()
 Type::Type(int specifier, unsigned indirection)
     : _specifier(specifier), _indirection(indirection), _kind(SCALAR)
 {
+    if (stats != nullptr)
+	stats->type();
 }
 
 
@@ -60,6 +65,9 @@ Type::Type(int specifier, unsigned indirection, unsigned length)
     : _specifier(specifier), _indirection(indirection), _length(length)
 {
     _kind = ARRAY;
+
+    if (stats != nullptr)
+	stats->type();
 }
 
 
@@ -73,6 +81,9 @@ Type::Type(int specifier, unsigned indirection, Parameters *parameters)
     : _specifier(specifier), _indirection(indirection), _parameters(parameters)
 {
     _kind = FUNCTION;
+
+    if (stats != nullptr)
+	stats->type();
 }
 
 
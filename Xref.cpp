@@ -0,0 +1,557 @@
+/*
+ * File:	Xref.cpp
+ *
+ * Description:	This file contains the member function definitions for
+ *		cross-reference indices in Simple C.
+ *
+ *		Numbers are written in a variable number of bytes, seven
+ *		bits to a byte, low bits first, with the high bit set in
+ *		every byte but the last.  The differences between the
+ *		offsets of successive references are usually small, so
+ *		most take a byte or two.
+ *
+ *		Since the checker may delete a symbol and allocate another
+ *		at the same address, a use is only matched to an earlier
+ *		symbol with the same name, as for syntax trees.
+ */
+
+# include <cstring>
+# include <algorithm>
+# include "Xref.h"
+
+using namespace std;
+
+static const unsigned spacing = 32;
+
+
+/*
+ * Function:	put
+ *
+ * Description:	Append the given number to the given bytes.
+ */
+
+static void put(vector<uint8_t> &bytes, uint32_t value)
+{
+    while (value >= 0x80) {
+	bytes.push_back(value | 0x80);
+	value >>= 7;
+    }
+
+    bytes.push_back(value);
+}
+
+
+/*
+ * Function:	get
+ *
+ * Description:	Return the number at the given pointer, and advance the
+ *		pointer past it.
+ */
+
+static uint32_t get(const uint8_t *&p)
+{
+    uint32_t value = 0;
+    unsigned shift = 0;
+
+
+    while (*p & 0x80) {
+	value |= (uint32_t) (*p ++ & 0x7f) << shift;
+	shift += 7;
+    }
+
+    return value | (uint32_t) *p ++ << shift;
+}
+
+
+/*
+ * Function:	Xref::Xref (constructor)
+ *
+ * Description:	Initialize this index as empty.
+ */
+
+Xref::Xref()
+    : _caller(XREF_NONE), _local(false)
+{
+}
+
+
+/*
+ * Function:	Xref::clear
+ *
+ * Description:	Discard everything noted or indexed so far.
+ */
+
+void Xref::clear()
+{
+    _occurrences.clear();
+    _calls.clear();
+    _ids.clear();
+    _globals.clear();
+    _caller = XREF_NONE;
+    _local = false;
+
+    _strings.clear();
+    _names.clear();
+    _definitions.clear();
+    _references.clear();
+    _callers.clear();
+    _callees.clear();
+    _marks.clear();
+    _uses.clear();
+    _in.clear();
+    _out.clear();
+    _positions.clear();
+}
+
+
+/*
+ * Function:	Xref::id (private)
+ *
+ * Description:	Return the number of the given symbol, giving it a new one
+ *		if necessary or if one is requested.
+ */
+
+uint32_t Xref::id(const Symbol *symbol, bool fresh)
+{
+    const string &name = symbol->name();
+    uint32_t n;
+
+
+    auto it = _ids.find(symbol);
+
+    if (!fresh && it != _ids.end() && name == _strings.c_str() + _names[it->second])
+	return it->second;
+
+    n = _names.size();
+    _names.push_back(_strings.size());
+    _strings.append(name);
+    _strings.push_back('\0');
+    _definitions.push_back(Location {XREF_NONE, 0});
+    return _ids[symbol] = n;
+}
+
+
+/*
+ * Function:	Xref::global (private)
+ *
+ * Description:	Return the number of the given global symbol, which is that
+ *		of any earlier global with the same name.
+ */
+
+uint32_t Xref::global(const Symbol *symbol)
+{
+    auto it = _globals.find(symbol->name());
+
+
+    if (it == _globals.end())
+	return _globals[symbol->name()] = id(symbol, true);
+
+    return _ids[symbol] = it->second;
+}
+
+
+/*
+ * Function:	Xref::note (private)
+ *
+ * Description:	Note an occurrence of the given symbol at the given offset
+ *		and line.
+ */
+
+void Xref::note(uint32_t symbol, size_t offset, int line)
+{
+    _occurrences.push_back(Occurrence {symbol, (uint32_t) offset, (uint32_t) line});
+}
+
+
+/*
+ * Function:	Xref::enter
+ *
+ * Description:	Note that the parameters and body of a function follow,
+ *		whose declarations are all local.
+ */
+
+void Xref::enter()
+{
+    _local = true;
+}
+
+
+/*
+ * Function:	Xref::leave
+ *
+ * Description:	Note that the body of the current function has ended.
+ */
+
+void Xref::leave()
+{
+    _local = false;
+    _caller = XREF_NONE;
+}
+
+
+/*
+ * Function:	Xref::declaration
+ *
+ * Description:	Note a declaration of the given symbol by the identifier at
+ *		the given offset and line.  A local redeclaration refers to
+ *		the symbol already declared, but never to a global.
+ */
+
+void Xref::declaration(const Symbol *symbol, size_t offset, int line)
+{
+    uint32_t n;
+
+
+    if (!_local)
+	n = global(symbol);
+    else {
+	n = id(symbol, false);
+	auto it = _globals.find(symbol->name());
+
+	if (it != _globals.end() && it->second == n)
+	    n = id(symbol, true);
+    }
+
+    if (_definitions[n].offset == XREF_NONE)
+	_definitions[n] = Location {(uint32_t) offset, (uint32_t) line};
+
+    note(n, offset, line);
+}
+
+
+/*
+ * Function:	Xref::reference
+ *
+ * Description:	Note a use of the given symbol by the identifier at the
+ *		given offset and line.  A symbol never declared, such as
+ *		one from a prelude, is given a number with no definition.
+ */
+
+void Xref::reference(const Symbol *symbol, size_t offset, int line)
+{
+    note(id(symbol, false), offset, line);
+}
+
+
+/*
+ * Function:	Xref::function
+ *
+ * Description:	Note the definition of the given function by the
+ *		identifier at the given offset and line.  The calls in its
+ *		body are from it.
+ */
+
+void Xref::function(const Symbol *symbol, size_t offset, int line)
+{
+    uint32_t n = global(symbol);
+
+
+    _definitions[n] = Location {(uint32_t) offset, (uint32_t) line};
+    note(n, offset, line);
+    _caller = n;
+}
+
+
+/*
+ * Function:	Xref::call
+ *
+ * Description:	Note a call of the given symbol from the current function.
+ */
+
+void Xref::call(const Symbol *symbol)
+{
+    if (_caller != XREF_NONE)
+	_calls.emplace_back(_caller, id(symbol, false));
+}
+
+
+/*
+ * Function:	Xref::finish
+ *
+ * Description:	Pack everything noted into the index, and discard the
+ *		notes.
+ */
+
+void Xref::finish()
+{
+    uint32_t n, s, offset, line, previous;
+    size_t i;
+
+
+    n = _names.size();
+    _references.assign(n + 1, 0);
+    _callees.assign(n + 1, 0);
+    _callers.assign(n + 1, 0);
+
+    stable_sort(_occurrences.begin(), _occurrences.end(),
+	[](const Occurrence &a, const Occurrence &b) {
+	    return a.symbol < b.symbol || (a.symbol == b.symbol && a.offset < b.offset);
+	});
+
+    for (s = 0, i = 0; s < n; s ++) {
+	_references[s] = _uses.size();
+
+	for (offset = line = 0; i < _occurrences.size() && _occurrences[i].symbol == s; i ++) {
+	    put(_uses, _occurrences[i].offset - offset);
+	    put(_uses, _occurrences[i].line - line);
+	    offset = _occurrences[i].offset;
+	    line = _occurrences[i].line;
+	}
+    }
+
+    _references[n] = _uses.size();
+
+    stable_sort(_occurrences.begin(), _occurrences.end(),
+	[](const Occurrence &a, const Occurrence &b) {
+	    return a.offset < b.offset;
+	});
+
+    for (i = 0, previous = 0; i < _occurrences.size(); i ++) {
+	if (i % spacing == 0) {
+	    previous = _occurrences[i].offset;
+	    _marks.emplace_back(previous, _positions.size());
+	}
+
+	put(_positions, _occurrences[i].offset - previous);
+	put(_positions, _occurrences[i].symbol);
+	previous = _occurrences[i].offset;
+    }
+
+    sort(_calls.begin(), _calls.end());
+    _calls.erase(unique(_calls.begin(), _calls.end()), _calls.end());
+
+    for (s = 0, i = 0; s < n; s ++) {
+	_callees[s] = _out.size();
+
+	for (previous = 0; i < _calls.size() && _calls[i].first == s; i ++) {
+	    put(_out, _calls[i].second - previous);
+	    previous = _calls[i].second;
+	}
+    }
+
+    _callees[n] = _out.size();
+
+    for (auto &call : _calls)
+	swap(call.first, call.second);
+
+    sort(_calls.begin(), _calls.end());
+
+    for (s = 0, i = 0; s < n; s ++) {
+	_callers[s] = _in.size();
+
+	for (previous = 0; i < _calls.size() && _calls[i].first == s; i ++) {
+	    put(_in, _calls[i].second - previous);
+	    previous = _calls[i].second;
+	}
+    }
+
+    _callers[n] = _in.size();
+
+    vector<Occurrence>().swap(_occurrences);
+    vector<pair<uint32_t, uint32_t>>().swap(_calls);
+    _ids.clear();
+    _caller = XREF_NONE;
+    _local = false;
+}
+
+
+/*
+ * Function:	Xref::decode (private)
+ *
+ * Description:	Append the numbers of the given symbol in the given bytes,
+ *		which start where the given table says, to the given list.
+ */
+
+void Xref::decode(const Bytes &bytes, const Table &table, uint32_t n, Table &ids) const
+{
+    const uint8_t *p, *end;
+    uint32_t value = 0;
+
+
+    if (n >= _names.size() || table.empty())
+	return;
+
+    p = bytes.data() + table[n];
+    end = bytes.data() + table[n + 1];
+
+    while (p < end)
+	ids.push_back(value += get(p));
+}
+
+
+/*
+ * Function:	Xref::size (accessor)
+ *
+ * Description:	Return the number of symbols in this index.
+ */
+
+uint32_t Xref::size() const
+{
+    return _names.size();
+}
+
+
+/*
+ * Function:	Xref::name
+ *
+ * Description:	Return the name of the given symbol.
+ */
+
+const char *Xref::name(uint32_t symbol) const
+{
+    return symbol < _names.size() ? _strings.c_str() + _names[symbol] : nullptr;
+}
+
+
+/*
+ * Function:	Xref::find
+ *
+ * Description:	Return the number of the global with the given name, or
+ *		XREF_NONE if there is none.
+ */
+
+uint32_t Xref::find(const string &name) const
+{
+    auto it = _globals.find(name);
+
+
+    return it != _globals.end() ? it->second : XREF_NONE;
+}
+
+
+/*
+ * Function:	Xref::globals
+ *
+ * Description:	Return the numbers of all globals declared or defined, in
+ *		order.
+ */
+
+vector<uint32_t> Xref::globals() const
+{
+    Table ids;
+
+
+    for (auto &global : _globals)
+	ids.push_back(global.second);
+
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+
+/*
+ * Function:	Xref::symbol
+ *
+ * Description:	Return the number of the symbol whose identifier spans the
+ *		given offset, or XREF_NONE if none does.
+ */
+
+uint32_t Xref::symbol(size_t offset) const
+{
+    const uint8_t *p, *end;
+    uint32_t at, start, found;
+
+
+    auto it = upper_bound(_marks.begin(), _marks.end(), make_pair((uint32_t) offset, (uint32_t) XREF_NONE));
+
+    if (it == _marks.begin())
+	return XREF_NONE;
+
+    p = _positions.data() + (it - 1)->second;
+    end = _positions.data() + (it != _marks.end() ? it->second : _positions.size());
+    at = start = (it - 1)->first;
+    found = XREF_NONE;
+
+    while (p < end) {
+	at += get(p);
+
+	if (at > offset)
+	    break;
+
+	start = at;
+	found = get(p);
+    }
+
+    if (found != XREF_NONE && offset < start + strlen(name(found)))
+	return found;
+
+    return XREF_NONE;
+}
+
+
+/*
+ * Function:	Xref::definition
+ *
+ * Description:	Return the location of the definition of the given symbol,
+ *		whose offset is XREF_NONE if it has none.
+ */
+
+Xref::Location Xref::definition(uint32_t symbol) const
+{
+    if (symbol >= _definitions.size())
+	return Location {XREF_NONE, 0};
+
+    return _definitions[symbol];
+}
+
+
+/*
+ * Function:	Xref::references
+ *
+ * Description:	Return the locations of all declarations and uses of the
+ *		given symbol, in order.
+ */
+
+vector<Xref::Location> Xref::references(uint32_t symbol) const
+{
+    vector<Location> locations;
+    const uint8_t *p, *end;
+    uint32_t offset, line;
+
+
+    if (symbol >= _names.size() || _references.empty())
+	return locations;
+
+    p = _uses.data() + _references[symbol];
+    end = _uses.data() + _references[symbol + 1];
+
+    for (offset = line = 0; p < end; ) {
+	offset += get(p);
+	line += get(p);
+	locations.push_back(Location {offset, line});
+    }
+
+    return locations;
+}
+
+
+/*
+ * Function:	Xref::callers
+ *
+ * Description:	Return the functions that call the given function.
+ */
+
+vector<uint32_t> Xref::callers(uint32_t symbol) const
+{
+    Table ids;
+
+
+    decode(_in, _callers, symbol, ids);
+    return ids;
+}
+
+
+/*
+ * Function:	Xref::callees
+ *
+ * Description:	Return the functions that the given function calls.
+ */
+
+vector<uint32_t> Xref::callees(uint32_t symbol) const
+{
+    Table ids;
+
+
+    decode(_out, _callees, symbol, ids);
+    return ids;
+}
@@ -0,0 +1,101 @@
+/*
+ * File:	Xref.h
+ *
+ * Description:	This file contains the class definition for cross-reference
+ *		indices in Simple C.  When asked, the parser notes each
+ *		declaration of a symbol, each use of one, and each call
+ *		from one function to another, along with the offset and
+ *		line of the identifier.  Once the translation unit is
+ *		finished, these notes are packed into an index that
+ *		answers where a symbol is defined, where it is referenced,
+ *		and which functions call or are called by a function,
+ *		with no further parsing.
+ *
+ *		Each symbol gets a small number.  A global keeps its number
+ *		across all of its declarations and its definition, while
+ *		each local and parameter gets its own.  The definition of a
+ *		symbol is that of a function if it has one, and otherwise
+ *		its first declaration.  Its references are all of its
+ *		declarations and uses, in order.
+ *
+ *		The index is a handful of flat arrays.  The references of
+ *		all symbols are kept in one array, symbol by symbol, each
+ *		as the difference from the one before it in a variable
+ *		number of bytes, with a table giving where each symbol
+ *		starts.  The callers and callees of each function are kept
+ *		in the same way.  Every identifier in the unit is also kept
+ *		in order of offset, with every so many marked by their
+ *		absolute offset, so that the symbol at an offset is found
+ *		by a binary search and a short scan.
+ */
+
+# ifndef XREF_H
+# define XREF_H
+# include <string>
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+# include <unordered_map>
+# include "Symbol.h"
+
+# define XREF_NONE 0xffffffff
+
+class Xref {
+    typedef std::string string;
+    typedef std::vector<uint8_t> Bytes;
+    typedef std::vector<uint32_t> Table;
+
+public:
+    struct Location {
+	uint32_t offset;	/* offset of the identifier, or XREF_NONE */
+	uint32_t line;		/* line of the identifier */
+    };
+
+private:
+    struct Occurrence {
+	uint32_t symbol, offset, line;
+    };
+
+    std::vector<Occurrence> _occurrences;
+    std::vector<std::pair<uint32_t, uint32_t>> _calls;
+    std::unordered_map<const Symbol *, uint32_t> _ids;
+    std::unordered_map<string, uint32_t> _globals;
+    uint32_t _caller;
+    bool _local;
+
+    string _strings;
+    Table _names;
+    std::vector<Location> _definitions;
+    Table _references, _callers, _callees;
+    std::vector<std::pair<uint32_t, uint32_t>> _marks;
+    Bytes _uses, _in, _out, _positions;
+
+    uint32_t id(const Symbol *symbol, bool fresh);
+    uint32_t global(const Symbol *symbol);
+    void note(uint32_t symbol, size_t offset, int line);
+    void decode(const Bytes &bytes, const Table &table, uint32_t n, Table &ids) const;
+
+public:
+    Xref();
+
+    void clear();
+    void enter();
+    void leave();
+    void declaration(const Symbol *symbol, size_t offset, int line);
+    void reference(const Symbol *symbol, size_t offset, int line);
+    void function(const Symbol *symbol, size_t offset, int line);
+    void call(const Symbol *symbol);
+    void finish();
+
+    uint32_t size() const;
+    const char *name(uint32_t symbol) const;
+    uint32_t find(const string &name) const;
+    std::vector<uint32_t> globals() const;
+    uint32_t symbol(size_t offset) const;
+    Location definition(uint32_t symbol) const;
+    std::vector<Location> references(uint32_t symbol) const;
+    std::vector<uint32_t> callers(uint32_t symbol) const;
+    std::vector<uint32_t> callees(uint32_t symbol) const;
+};
+
+# endif /* XREF_H */
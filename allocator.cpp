@@ -0,0 +1,182 @@
+/*
+ * File:	allocator.cpp
+ *
+ * Description:	This file contains the replacements of the global
+ *		allocation functions for the Simple C compiler, which
+ *		account for each allocation against the subsystem the
+ *		calling thread is allocating for, if an accounting is
+ *		being kept.
+ *
+ *		Each block is preceded by a header giving its size and the
+ *		subsystem it was counted against, so that it can be
+ *		released from the same one.  A block allocated while no
+ *		accounting was kept is never counted when it is released.
+ *		The header is as large as the alignment of the blocks that
+ *		malloc returns, so that the blocks we return keep it.
+ *
+ *		This file is part of the program rather than the library,
+ *		since replacing the allocation functions affects everything
+ *		linked with them.
+ */
+
+# include <new>
+# include <cstdlib>
+# include "Memory.h"
+
+using namespace std;
+
+static const size_t HEADER = 2 * sizeof(size_t);
+static const size_t UNCOUNTED = -1;
+
+
+/*
+ * Function:	operator new
+ *
+ * Description:	Allocate and return a block of the given size, or throw if
+ *		there is no memory left.
+ */
+
+void *operator new(size_t size)
+{
+    size_t *block;
+
+
+    if ((block = (size_t *) malloc(size + HEADER)) == nullptr)
+	throw bad_alloc();
+
+    block[0] = size;
+    block[1] = memory != nullptr ? subsystem : UNCOUNTED;
+
+    if (memory != nullptr)
+	memory->allocate(size, subsystem);
+
+    return block + 2;
+}
+
+
+/*
+ * Function:	operator new
+ *
+ * Description:	Allocate and return a block of the given size, or a null
+ *		pointer if there is no memory left.
+ */
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    try {
+	return operator new(size);
+    } catch (const bad_alloc &) {
+	return nullptr;
+    }
+}
+
+
+/*
+ * Function:	operator new[]
+ *
+ * Description:	Allocate and return a block of the given size for an
+ *		array.
+ */
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+
+/*
+ * Function:	operator new[]
+ *
+ * Description:	Allocate and return a block of the given size for an
+ *		array, or a null pointer if there is no memory left.
+ */
+
+void *operator new[](size_t size, const nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+
+/*
+ * Function:	operator delete
+ *
+ * Description:	Release the given block.
+ */
+
+void operator delete(void *p) noexcept
+{
+    size_t *block;
+
+
+    if (p == nullptr)
+	return;
+
+    block = (size_t *) p - 2;
+
+    if (block[1] != UNCOUNTED && memory != nullptr)
+	memory->release(block[0], block[1]);
+
+    free(block);
+}
+
+
+/*
+ * Function:	operator delete
+ *
+ * Description:	Release the given block of the given size.
+ */
+
+void operator delete(void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+
+/*
+ * Function:	operator delete
+ *
+ * Description:	Release the given block allocated without throwing.
+ */
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+    operator delete(p);
+}
+
+
+/*
+ * Function:	operator delete[]
+ *
+ * Description:	Release the given block allocated for an array.
+ */
+
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
+
+
+/*
+ * Function:	operator delete[]
+ *
+ * Description:	Release the given block of the given size allocated for an
+ *		array.
+ */
+
+void operator delete[](void *p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+
+/*
+ * Function:	operator delete[]
+ *
+ * Description:	Release the given block allocated for an array without
+ *		throwing.
+ */
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+    operator delete(p);
+}
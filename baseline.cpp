@@ -0,0 +1,518 @@
+/*
+ * File:	baseline.cpp
+ *
+ * Description:	This file contains the public and private function
+ *		definitions for recording the results of the benchmarks as
+ *		baselines and comparing later results against them.
+ *
+ *		A baseline is a JSON object naming the commit and machine
+ *		it was recorded on, and giving every sample of every
+ *		benchmark in nanoseconds per operation.  Only the samples
+ *		are kept, so that any statistics may be computed later.
+ *
+ *		Two runs are compared benchmark by benchmark with the
+ *		Mann-Whitney U test, which assumes nothing about how the
+ *		times are distributed, and so is not fooled by the long
+ *		tail that a busy machine adds.  The change is estimated as
+ *		the median of the differences between every pair of
+ *		samples (the Hodges-Lehmann estimator), with a confidence
+ *		interval taken from the same differences.  A benchmark has
+ *		regressed if it is significantly slower and the estimated
+ *		change is above the threshold.  The benchmarks are also
+ *		summarized by phase, the part of the name before the first
+ *		slash, as the geometric mean of the ratios of the medians.
+ */
+
+# include <cmath>
+# include <cstdio>
+# include <cctype>
+# include <cstdlib>
+# include <fstream>
+# include <sstream>
+# include <iomanip>
+# include <iostream>
+# include <algorithm>
+# include <unistd.h>
+# include <sys/utsname.h>
+# include "baseline.h"
+
+using namespace std;
+
+static const double ALPHA = 0.05;
+static const double Z = 1.959964;
+
+struct Change {
+    double p, estimate, low, high;
+};
+
+struct Reader {
+    const string &text;
+    size_t pos;
+};
+
+
+/*
+ * Function:	command
+ *
+ * Description:	Return the first line written by the given shell command,
+ *		or the empty string if there is none.
+ */
+
+static string command(const char *text)
+{
+    char line[256];
+    string result;
+    FILE *fp;
+
+
+    if ((fp = popen(text, "r")) == nullptr)
+	return result;
+
+    if (fgets(line, sizeof(line), fp) != nullptr)
+	result = line;
+
+    pclose(fp);
+
+    while (!result.empty() && isspace((unsigned char) result.back()))
+	result.pop_back();
+
+    return result;
+}
+
+
+/*
+ * Function:	commitName
+ *
+ * Description:	Return the name of the current commit, marked if the tree
+ *		has been changed since, or "unknown" outside of git.
+ */
+
+string commitName()
+{
+    string name = command("git describe --always --dirty 2> /dev/null");
+
+
+    return name.empty() ? "unknown" : name;
+}
+
+
+/*
+ * Function:	machineName
+ *
+ * Description:	Return the name of this machine and its architecture.
+ */
+
+string machineName()
+{
+    struct utsname u;
+    string name;
+
+
+    if (uname(&u) < 0)
+	return "unknown";
+
+    name = string(u.nodename) + "-" + u.machine;
+
+    for (auto &c : name)
+	if (!isalnum((unsigned char) c) && c != '-' && c != '_' && c != '.')
+	    c = '_';
+
+    return name;
+}
+
+
+/*
+ * Function:	quote
+ *
+ * Description:	Return the given text as a JSON string.
+ */
+
+static string quote(const string &text)
+{
+    string s = "\"";
+
+
+    for (auto c : text) {
+	if (c == '"' || c == '\\')
+	    s += '\\';
+
+	s += c;
+    }
+
+    return s + "\"";
+}
+
+
+/*
+ * Function:	saveBaseline
+ *
+ * Description:	Write the given baseline to the given file.  Return
+ *		whether it was written.
+ */
+
+bool saveBaseline(const string &path, const Baseline &baseline)
+{
+    ofstream out(path);
+
+
+    out << "{\n  \"commit\": " << quote(baseline.commit) << ",\n";
+    out << "  \"machine\": " << quote(baseline.machine) << ",\n";
+    out << "  \"unit\": \"ns/op\",\n  \"benchmarks\": {";
+    out << setprecision(10);
+
+    for (size_t i = 0; i < baseline.benchmarks.size(); i ++) {
+	const Samples &b = baseline.benchmarks[i];
+
+	out << (i > 0 ? ",\n    " : "\n    ") << quote(b.name) << ": [";
+
+	for (size_t j = 0; j < b.values.size(); j ++)
+	    out << (j > 0 ? ", " : "") << b.values[j];
+
+	out << "]";
+    }
+
+    out << "\n  }\n}\n";
+    out.close();
+    return !out.fail();
+}
+
+
+/*
+ * Function:	space
+ *
+ * Description:	Skip any white space in the given JSON.
+ */
+
+static void space(Reader &r)
+{
+    while (r.pos < r.text.size() && isspace((unsigned char) r.text[r.pos]))
+	r.pos ++;
+}
+
+
+/*
+ * Function:	take
+ *
+ * Description:	Skip the given character next in the given JSON, if it is
+ *		next, and return whether it was.
+ */
+
+static bool take(Reader &r, char c)
+{
+    space(r);
+
+    if (r.pos == r.text.size() || r.text[r.pos] != c)
+	return false;
+
+    r.pos ++;
+    return true;
+}
+
+
+/*
+ * Function:	text
+ *
+ * Description:	Read a string from the given JSON.  Return whether there
+ *		was one.
+ */
+
+static bool text(Reader &r, string &s)
+{
+    if (!take(r, '"'))
+	return false;
+
+    for (s.clear(); r.pos < r.text.size() && r.text[r.pos] != '"'; r.pos ++) {
+	if (r.text[r.pos] == '\\' && r.pos + 1 < r.text.size())
+	    r.pos ++;
+
+	s += r.text[r.pos];
+    }
+
+    return take(r, '"');
+}
+
+
+/*
+ * Function:	number
+ *
+ * Description:	Read a number from the given JSON.  Return whether there
+ *		was one.
+ */
+
+static bool number(Reader &r, double &value)
+{
+    const char *start;
+    char *end;
+
+
+    space(r);
+    start = r.text.c_str() + r.pos;
+    value = strtod(start, &end);
+    r.pos += end - start;
+    return end != start;
+}
+
+
+/*
+ * Function:	skip
+ *
+ * Description:	Skip a value of any kind in the given JSON.  Return
+ *		whether there was one.
+ */
+
+static bool skip(Reader &r)
+{
+    size_t start;
+    double value;
+    string s;
+
+
+    space(r);
+
+    if (r.pos < r.text.size() && r.text[r.pos] == '"')
+	return text(r, s);
+
+    if (take(r, '[')) {
+	while (!take(r, ']'))
+	    if (!take(r, ',') && !skip(r))
+		return false;
+
+	return true;
+    }
+
+    if (take(r, '{')) {
+	while (!take(r, '}'))
+	    if (!take(r, ',') && !(text(r, s) && take(r, ':') && skip(r)))
+		return false;
+
+	return true;
+    }
+
+    if (number(r, value))
+	return true;
+
+    for (start = r.pos; r.pos < r.text.size() && isalpha((unsigned char) r.text[r.pos]); )
+	r.pos ++;
+
+    return r.pos > start;
+}
+
+
+/*
+ * Function:	loadBaseline
+ *
+ * Description:	Read the baseline in the given file.  Return whether it
+ *		could be read.
+ */
+
+bool loadBaseline(const string &path, Baseline &baseline)
+{
+    ifstream in(path);
+    stringstream contents;
+    string json, key;
+    double value;
+
+
+    if (!in)
+	return false;
+
+    contents << in.rdbuf();
+    json = contents.str();
+    Reader r {json, 0};
+
+    if (!take(r, '{'))
+	return false;
+
+    while (!take(r, '}')) {
+	if (take(r, ','))
+	    continue;
+
+	if (!text(r, key) || !take(r, ':'))
+	    return false;
+
+	if (key == "commit")
+	    text(r, baseline.commit);
+	else if (key == "machine")
+	    text(r, baseline.machine);
+	else if (key == "benchmarks" && take(r, '{')) {
+	    while (!take(r, '}')) {
+		if (take(r, ','))
+		    continue;
+
+		Samples b;
+
+		if (!text(r, b.name) || !take(r, ':') || !take(r, '['))
+		    return false;
+
+		while (!take(r, ']'))
+		    if (number(r, value))
+			b.values.push_back(value);
+		    else if (!take(r, ','))
+			return false;
+
+		baseline.benchmarks.push_back(b);
+	    }
+	} else if (!skip(r))
+	    return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	median
+ *
+ * Description:	Return the median of the given values.
+ */
+
+static double median(vector<double> values)
+{
+    size_t n = values.size();
+
+
+    if (n == 0)
+	return 0;
+
+    sort(values.begin(), values.end());
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+
+/*
+ * Function:	compare
+ *
+ * Description:	Compare the given samples, and return the significance of
+ *		the difference and the estimated change from the first to
+ *		the second, with its confidence interval.
+ */
+
+static Change compare(const vector<double> &x, const vector<double> &y)
+{
+    vector<pair<double, int>> all;
+    vector<double> differences;
+    double n1 = x.size(), n2 = y.size(), n = n1 + n2;
+    double rank, ties, u, variance, z;
+    size_t i, j, k;
+    Change c;
+
+
+    for (auto v : x)
+	all.emplace_back(v, 0);
+
+    for (auto v : y)
+	all.emplace_back(v, 1);
+
+    sort(all.begin(), all.end());
+
+    for (i = 0, rank = ties = 0; i < all.size(); i = j) {
+	for (j = i; j < all.size() && all[j].first == all[i].first; j ++)
+	    continue;
+
+	for (k = i; k < j; k ++)
+	    if (all[k].second == 0)
+		rank += (i + j + 1) / 2.0;
+
+	ties += pow(j - i, 3) - (j - i);
+    }
+
+    u = rank - n1 * (n1 + 1) / 2;
+    variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+
+    if (variance > 0) {
+	z = (fabs(u - n1 * n2 / 2) - 0.5) / sqrt(variance);
+	c.p = min(1.0, erfc(max(z, 0.0) / sqrt(2)));
+    } else
+	c.p = 1;
+
+    for (auto b : x)
+	for (auto a : y)
+	    differences.push_back(a - b);
+
+    sort(differences.begin(), differences.end());
+    k = max(0.0, floor(n1 * n2 / 2 - Z * sqrt(n1 * n2 * (n + 1) / 12)));
+    k = min(k, (differences.size() - 1) / 2);
+
+    c.estimate = median(differences);
+    c.low = differences[k];
+    c.high = differences[differences.size() - 1 - k];
+    return c;
+}
+
+
+/*
+ * Function:	compareBaseline
+ *
+ * Description:	Write a comparison of the given runs, and return the
+ *		number of benchmarks that regressed by more than the
+ *		given percentage.
+ */
+
+unsigned compareBaseline(const Baseline &before, const Baseline &after, double threshold)
+{
+    vector<pair<string, double>> phases;
+    vector<unsigned> counts;
+    unsigned regressions = 0;
+    double base, scale;
+    string phase;
+    Change c;
+
+
+    cout << "baseline " << before.commit << " on " << before.machine;
+    cout << ", current " << after.commit << " on " << after.machine << endl;
+
+    if (before.machine != after.machine)
+	cout << "warning: the runs are from different machines" << endl;
+
+    cout << left << setw(32) << "benchmark" << right << setw(14) << "before ns";
+    cout << setw(14) << "after ns" << setw(10) << "change";
+    cout << setw(22) << "95% interval" << setw(9) << "p" << endl;
+
+    for (auto &b : after.benchmarks) {
+	auto it = find_if(before.benchmarks.begin(), before.benchmarks.end(),
+	    [&b](const Samples &s) { return s.name == b.name; });
+
+	if (it == before.benchmarks.end() || it->values.empty() || b.values.empty()) {
+	    cout << left << setw(32) << b.name << right << setw(28) << "(new)" << endl;
+	    continue;
+	}
+
+	base = median(it->values);
+	scale = base > 0 ? 100 / base : 0;
+	c = compare(it->values, b.values);
+
+	cout << left << setw(32) << b.name << right << fixed << setprecision(1);
+	cout << setw(14) << base << setw(14) << median(b.values);
+	cout << showpos << setw(9) << c.estimate * scale << "%";
+	cout << "  [" << setw(7) << c.low * scale << "%, " << setw(7) << c.high * scale << "%]";
+	cout << noshowpos << setprecision(3) << setw(9) << c.p;
+
+	if (c.p < ALPHA && c.estimate * scale > threshold) {
+	    cout << "  REGRESSION";
+	    regressions ++;
+	} else if (c.p < ALPHA && c.estimate * scale < -threshold)
+	    cout << "  faster";
+
+	cout << endl;
+
+	phase = b.name.substr(0, b.name.find('/'));
+
+	if (phases.empty() || phases.back().first != phase) {
+	    phases.emplace_back(phase, 0);
+	    counts.push_back(0);
+	}
+
+	phases.back().second += log(median(b.values) / base);
+	counts.back() ++;
+    }
+
+    for (size_t i = 0; i < phases.size(); i ++) {
+	cout << "phase " << left << setw(12) << phases[i].first << right;
+	cout << showpos << fixed << setprecision(1);
+	cout << setw(8) << (exp(phases[i].second / counts[i]) - 1) * 100 << "%";
+	cout << noshowpos << " over " << counts[i] << " benchmarks" << endl;
+    }
+
+    cout << regressions << " regressions above " << threshold << "%" << endl;
+    return regressions;
+}
@@ -0,0 +1,30 @@
+/*
+ * File:	baseline.h
+ *
+ * Description:	This file contains the public type and function declarations
+ *		for recording the results of the benchmarks as baselines and
+ *		comparing later results against them.
+ */
+
+# ifndef BASELINE_H
+# define BASELINE_H
+# include <string>
+# include <vector>
+
+struct Samples {
+    std::string name;
+    std::vector<double> values;
+};
+
+struct Baseline {
+    std::string commit, machine;
+    std::vector<Samples> benchmarks;
+};
+
+std::string commitName();
+std::string machineName();
+bool saveBaseline(const std::string &path, const Baseline &baseline);
+bool loadBaseline(const std::string &path, Baseline &baseline);
+unsigned compareBaseline(const Baseline &before, const Baseline &after, double threshold);
+
+# endif /* BASELINE_H */
@@ -0,0 +1,338 @@
+/*
+ * File:	batch.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for checking many translation units in
+ *		a single process using a pool of worker threads.
+ *
+ *		The files are sorted by size, largest first, and dealt out
+ *		to the workers in turn.  Each worker takes files from the
+ *		front of its own queue, and once its queue is empty, it
+ *		steals from the back of the other queues.  The largest
+ *		files are therefore started early, and the small files left
+ *		at the end keep everyone busy until the very end.
+ *
+ *		The results are written in the order the files were given,
+ *		as soon as all earlier files are finished.  In text format,
+ *		the symbols for each file are preceded by the name of the
+ *		file.  In binary format, the dumps are simply concatenated,
+ *		since each dump records its own size.  Any errors for a
+ *		file are prefixed with its name and followed by its exit
+ *		status.
+ *
+ *		The files are read ahead of the workers in the same order
+ *		in which they were dealt out.  The time the workers spend
+ *		waiting for their files is reported at the end if asked.
+ *
+ *		If metrics are kept, every file is asked for when the batch
+ *		starts, so its queue wait lasts until a worker takes it,
+ *		and its latency until its result is ready.
+ */
+
+# include <deque>
+# include <mutex>
+# include <thread>
+# include <cerrno>
+# include <cstdlib>
+# include <cstring>
+# include <iomanip>
+# include <iostream>
+# include <algorithm>
+# include <unistd.h>
+# include <sys/stat.h>
+# include "ReadAhead.h"
+# include "Trace.h"
+# include "Metrics.h"
+# include "batch.h"
+# include "scc.h"
+
+using namespace std;
+
+static const unsigned IO_THREADS = 4;
+
+struct Queue {
+    mutex lock;
+    deque<unsigned> jobs;
+};
+
+struct Batch {
+    vector<Job> jobs;
+    vector<Queue> queues;
+    Options options;
+    ReadAhead *reader;
+
+    mutex lock;
+    unsigned next;
+    int status;
+    double asked;
+
+    Batch(size_t n, unsigned workers) : jobs(n), queues(workers) {}
+};
+
+
+/*
+ * Function:	readFile
+ *
+ * Description:	Read the entire contents of the given file descriptor into
+ *		the buffer.  Return whether the read was successful.
+ */
+
+bool readFile(int fd, string &buf)
+{
+    struct stat st;
+    size_t size;
+    ssize_t n;
+
+
+    buf.clear();
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+	buf.reserve(st.st_size);
+
+    while (1) {
+	size = buf.size();
+	buf.resize(size + 65536);
+	n = read(fd, &buf[size], 65536);
+	buf.resize(size + (n > 0 ? n : 0));
+
+	if (n == 0)
+	    return true;
+
+	if (n < 0 && errno != EINTR)
+	    return false;
+    }
+}
+
+
+/*
+ * Function:	checkJob
+ *
+ * Description:	Check the file for the given job.
+ */
+
+static void checkJob(Batch &b, Context &context, unsigned n)
+{
+    Job &job = b.jobs[n];
+    Trace::Span span("file");
+    string buf;
+    int error;
+
+
+    span.name(job.path);
+
+    {
+	Trace::Span wait("read", "wait");
+	error = b.reader->get(n, buf);
+    }
+
+    if (error != 0) {
+	job.diagnostics = string(strerror(error)) + "\n";
+	job.status = EXIT_FAILURE;
+	return;
+    }
+
+    span.arg("bytes", buf.size());
+    const Result &result = context.check(buf.data(), buf.size());
+    job.status = result.status;
+    job.output = result.symbols;
+    job.diagnostics = result.diagnostics;
+}
+
+
+/*
+ * Function:	take
+ *
+ * Description:	Take the next job for the given worker, first from its own
+ *		queue and then from the others.  Return whether there was
+ *		any work left at all.
+ */
+
+static bool take(Batch &b, unsigned self, unsigned &job)
+{
+    unsigned n = b.queues.size();
+
+
+    for (unsigned i = 0; i < n; i ++) {
+	Queue &q = b.queues[(self + i) % n];
+	lock_guard<mutex> guard(q.lock);
+
+	if (!q.jobs.empty()) {
+	    if (i == 0) {
+		job = q.jobs.front();
+		q.jobs.pop_front();
+	    } else {
+		job = q.jobs.back();
+		q.jobs.pop_back();
+	    }
+
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+
+/*
+ * Function:	writeJob
+ *
+ * Description:	Write the results of the given job and release them.
+ */
+
+void writeJob(Job &job, Output::Format format)
+{
+    Trace::Span span("output", "write");
+    string::size_type start, end;
+
+
+    span.arg("bytes", job.output.size());
+
+    if (format == Output::TEXT)
+	cout << job.path << ":\n";
+
+    cout.write(job.output.data(), job.output.size());
+
+    for (start = 0; start < job.diagnostics.size(); start = end + 1) {
+	end = job.diagnostics.find('\n', start);
+
+	if (end == string::npos)
+	    end = job.diagnostics.size();
+
+	cerr << job.path << ": ";
+	cerr.write(job.diagnostics.data() + start, end - start);
+	cerr << '\n';
+    }
+
+    cerr << job.path << ": exit status " << job.status << '\n';
+
+    string().swap(job.output);
+    string().swap(job.diagnostics);
+}
+
+
+/*
+ * Function:	finish
+ *
+ * Description:	Mark the given job as done and write the results of all
+ *		consecutive finished jobs that have not yet been written.
+ */
+
+static void finish(Batch &b, unsigned job)
+{
+    lock_guard<mutex> guard(b.lock);
+
+
+    b.jobs[job].done = true;
+
+    while (b.next < b.jobs.size() && b.jobs[b.next].done) {
+	Job &j = b.jobs[b.next ++];
+
+	if (j.status != EXIT_SUCCESS)
+	    b.status = EXIT_FAILURE;
+
+	writeJob(j, b.options.format);
+    }
+}
+
+
+/*
+ * Function:	worker
+ *
+ * Description:	Check files until there are none left.
+ */
+
+static void worker(Batch &b, unsigned self)
+{
+    Trace::Span span("worker", "worker");
+    Context context(b.options);
+    double started;
+    unsigned job;
+
+
+    if (trace != nullptr)
+	trace->thread("worker " + to_string(self));
+
+    while (take(b, self, job)) {
+	started = Metrics::now();
+	checkJob(b, context, job);
+
+	if (metrics != nullptr)
+	    metrics->record(b.asked, started, b.jobs[job].size,
+		b.jobs[job].status != EXIT_SUCCESS);
+
+	finish(b, job);
+    }
+}
+
+
+/*
+ * Function:	batch
+ *
+ * Description:	Check the given files using the given number of worker
+ *		threads, reading up to WINDOW files ahead of them.  If
+ *		REPORT is true, the bytes read and the time spent waiting
+ *		for them are written to the standard error.  Return
+ *		EXIT_SUCCESS if every file was checked successfully and
+ *		EXIT_FAILURE otherwise.
+ */
+
+int batch(const vector<string> &paths, unsigned workers, unsigned window, bool report, const Options &options)
+{
+    vector<unsigned> order;
+    vector<thread> threads;
+    struct stat st;
+
+
+    if (workers == 0)
+	workers = 1;
+
+    if (workers > paths.size())
+	workers = paths.size();
+
+    Batch b(paths.size(), workers);
+    b.options = options;
+    b.next = 0;
+    b.status = EXIT_SUCCESS;
+    b.asked = Metrics::now();
+
+    for (unsigned i = 0; i < paths.size(); i ++) {
+	b.jobs[i].path = paths[i];
+	b.jobs[i].size = stat(paths[i].c_str(), &st) == 0 ? st.st_size : 0;
+	b.jobs[i].done = false;
+	order.push_back(i);
+    }
+
+    stable_sort(order.begin(), order.end(), [&b](unsigned x, unsigned y) {
+	return b.jobs[x].size > b.jobs[y].size;
+    });
+
+    for (unsigned i = 0; i < order.size(); i ++)
+	b.queues[i % workers].jobs.push_back(order[i]);
+
+    ReadAhead reader(paths, order, window, IO_THREADS);
+    b.reader = &reader;
+
+    for (unsigned i = 1; i < workers; i ++)
+	threads.push_back(thread(worker, ref(b), i));
+
+    worker(b, 0);
+
+    for (auto &t : threads)
+	t.join();
+
+    cout.flush();
+
+    if (report) {
+	cerr << "scc: " << paths.size() << " files, " << reader.bytes();
+	cerr << " bytes read using " << (reader.uring() ? "io_uring" : "threads");
+	cerr << ", I/O wait " << fixed << setprecision(3) << reader.wait();
+	cerr << " s" << endl;
+    }
+
+    if (metrics != nullptr) {
+	metrics->stop();
+	metrics->write(cerr);
+    }
+
+    return b.status;
+}
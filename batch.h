@@ -0,0 +1,27 @@
+/*
+ * File:	batch.h
+ *
+ * Description:	This file contains the public type and function declarations
+ *		for checking many translation units in a single process.
+ */
+
+# ifndef BATCH_H
+# define BATCH_H
+# include <string>
+# include <vector>
+# include <sys/types.h>
+# include "scc.h"
+
+struct Job {
+    std::string path;
+    off_t size;
+    bool done;
+    int status;
+    std::string output, diagnostics;
+};
+
+bool readFile(int fd, std::string &buf);
+void writeJob(Job &job, Output::Format format);
+int batch(const std::vector<std::string> &paths, unsigned workers, unsigned window, bool report, const Options &options);
+
+# endif /* BATCH_H */
@@ -0,0 +1,509 @@
+/*
+ * File:	bench.cpp
+ *
+ * Description:	This file contains the main function for the benchmarks
+ *		of the Simple C compiler, which time the lexer, scopes,
+ *		types, each of the checking rules, and the checking of
+ *		whole translation units.
+ *
+ *		usage: scc-bench [-r repetitions] [-t seconds] [-f filter]
+ *			[-g] [-B directory] [-s] [-c commit [-T percent]]
+ *			[file | @list] ...
+ *
+ *		-r	number of samples to take of each benchmark (default 10)
+ *		-t	least time each sample should take (default 0.02)
+ *		-f	run only the benchmarks whose names contain the text
+ *		-g	also time gcc -fsyntax-only on the same files
+ *		-B	directory of baselines (default baselines)
+ *		-s	save the samples as the baseline of this commit
+ *		-c	compare the samples against the baseline of a commit
+ *		-T	least slowdown that counts as a regression (default 5)
+ *
+ *		Each benchmark is first run until one sample would take
+ *		the requested time, which also warms the caches, and is
+ *		then run that many times per sample.  The median time per
+ *		operation is reported, with the spread of the samples as a
+ *		percentage of the median and the throughput at the median.
+ *		If no files are given, a translation unit from the workload
+ *		generator is checked instead.
+ *
+ *		The baselines of each machine are kept apart, in a
+ *		subdirectory named for the machine, one file per commit.
+ *		When comparing, the exit status is a failure if any
+ *		benchmark has regressed.
+ */
+
+# include <chrono>
+# include <cstdlib>
+# include <cstring>
+# include <fstream>
+# include <sstream>
+# include <iomanip>
+# include <iostream>
+# include <algorithm>
+# include <functional>
+# include <unistd.h>
+# include <sys/stat.h>
+# include "baseline.h"
+# include "Generator.h"
+# include "checker.h"
+# include "tokens.h"
+# include "lexer.h"
+# include "scc.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct Input {
+    string path, text;
+    size_t tokens;
+};
+
+static unsigned repetitions = 10;
+static double target = 0.02;
+static const char *filter = nullptr;
+static volatile uint64_t sink;
+static Baseline results;
+
+
+/*
+ * Function:	elapsed
+ *
+ * Description:	Return the time taken by the given number of calls to the
+ *		given body, in seconds.
+ */
+
+static double elapsed(const function<void()> &body, uint64_t calls)
+{
+    Clock::time_point start = Clock::now();
+
+
+    for (uint64_t i = 0; i < calls; i ++)
+	body();
+
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+
+/*
+ * Function:	run
+ *
+ * Description:	Time the given body, each call to which is one operation
+ *		of the given number of bytes and items of the given unit,
+ *		and write a line of the report.
+ */
+
+static void run(const string &name, double bytes, double items, const char *unit, const function<void()> &body)
+{
+    vector<double> samples;
+    double median, low, high;
+    uint64_t calls;
+
+
+    if (filter != nullptr && name.find(filter) == string::npos)
+	return;
+
+    for (calls = 1; elapsed(body, calls) < target && calls < (1ULL << 40); calls *= 2)
+	continue;
+
+    for (unsigned i = 0; i < repetitions; i ++)
+	samples.push_back(elapsed(body, calls) * 1e9 / calls);
+
+    results.benchmarks.push_back(Samples {name, samples});
+    sort(samples.begin(), samples.end());
+    median = samples[samples.size() / 2];
+    low = samples[samples.size() / 10];
+    high = samples[samples.size() - 1 - samples.size() / 10];
+
+    cout << left << setw(32) << name << right << fixed;
+    cout << setw(14) << setprecision(1) << median << " ns/op";
+    cout << setw(8) << setprecision(1) << (high - low) * 100 / median << "%";
+
+    if (bytes > 0)
+	cout << setw(10) << setprecision(1) << bytes * 1e3 / median << " MB/s";
+
+    if (items > 0)
+	cout << setw(10) << setprecision(2) << items * 1e3 / median << " M" << unit << "/s";
+
+    cout << endl;
+}
+
+
+/*
+ * Function:	count
+ *
+ * Description:	Return the number of tokens in the given text.
+ */
+
+static size_t count(const string &text)
+{
+    ostringstream discard;
+    ostream *old = diagnostics;
+    string lexbuf;
+    size_t n = 0;
+
+
+    diagnostics = &discard;
+    lexinit(text.data(), text.size());
+
+    while (lexan(lexbuf) != DONE)
+	n ++;
+
+    diagnostics = old;
+    return n;
+}
+
+
+/*
+ * Function:	benchLexer
+ *
+ * Description:	Time the lexer over all of the inputs.
+ */
+
+static void benchLexer(const vector<Input> &inputs, double bytes, double tokens)
+{
+    ostringstream discard;
+    string lexbuf;
+
+
+    diagnostics = &discard;
+
+    run("lex/all", bytes, tokens, "tokens", [&]() {
+	for (auto &input : inputs) {
+	    lexinit(input.text.data(), input.text.size());
+
+	    while (lexan(lexbuf) != DONE)
+		continue;
+	}
+
+	discard.str("");
+    });
+}
+
+
+/*
+ * Function:	benchScopes
+ *
+ * Description:	Time finding names in scopes of various sizes, and looking
+ *		up names through various numbers of enclosing scopes.
+ */
+
+static void benchScopes()
+{
+    for (unsigned size : {1, 16, 256, 4096, 65536}) {
+	Scope scope;
+	vector<string> names, missing;
+	size_t i = 0;
+
+	for (unsigned n = 0; n < size; n ++) {
+	    names.push_back("name" + to_string(n));
+	    missing.push_back("other" + to_string(n));
+	    scope.insert(new Symbol(names.back(), Type(INT)));
+	}
+
+	run("scope/find/" + to_string(size), 0, 0, nullptr, [&]() {
+	    sink += scope.find(names[i]) != nullptr;
+	    i = i + 1 < size ? i + 1 : 0;
+	});
+
+	run("scope/find-miss/" + to_string(size), 0, 0, nullptr, [&]() {
+	    sink += scope.find(missing[i]) != nullptr;
+	    i = i + 1 < size ? i + 1 : 0;
+	});
+
+	for (auto symbol : scope.symbols())
+	    delete symbol;
+    }
+
+    for (unsigned depth : {1, 8, 64, 512}) {
+	vector<Scope *> scopes;
+	Scope *scope = nullptr;
+
+	for (unsigned d = 0; d < depth; d ++) {
+	    scopes.push_back(scope = new Scope(scope));
+
+	    for (unsigned n = 0; n < 16; n ++)
+		scope->insert(new Symbol("s" + to_string(d) + "_" + to_string(n), Type(INT)));
+	}
+
+	run("scope/lookup-depth/" + to_string(depth), 0, 0, nullptr, [&]() {
+	    sink += scope->lookup("s0_7") != nullptr;
+	});
+
+	while (!scopes.empty()) {
+	    for (auto symbol : scopes.back()->symbols())
+		delete symbol;
+
+	    delete scopes.back();
+	    scopes.pop_back();
+	}
+    }
+}
+
+
+/*
+ * Function:	benchTypes
+ *
+ * Description:	Time comparing, promoting, and checking the compatibility
+ *		of types.
+ */
+
+static void benchTypes()
+{
+    Parameters *a = new Parameters {Type(INT), Type(CHAR, 1), Type(INT, 2), Type(CHAR)};
+    Parameters *b = new Parameters(*a);
+    Type scalar(INT, 1), array(CHAR, 0, 10), f(INT, 0, a), g(INT, 0, b);
+
+
+    run("type/equal-scalar", 0, 0, nullptr, [&]() {
+	sink += scalar == Type(INT, 1);
+    });
+
+    run("type/equal-array", 0, 0, nullptr, [&]() {
+	sink += array == Type(CHAR, 0, 10);
+    });
+
+    run("type/equal-function", 0, 0, nullptr, [&]() {
+	sink += f == g;
+    });
+
+    run("type/promote-array", 0, 0, nullptr, [&]() {
+	sink += array.promote().indirection();
+    });
+
+    run("type/compatible", 0, 0, nullptr, [&]() {
+	sink += scalar.isCompatibleWith(Type(VOID, 1));
+    });
+}
+
+
+/*
+ * Function:	benchRules
+ *
+ * Description:	Time each of the rules of the checker on operands that
+ *		pass, so that no errors are reported.
+ */
+
+static void benchRules()
+{
+    Type integer(INT), character(CHAR), pointer(INT, 1), array(CHAR, 0, 10);
+    string times = "*", plus = "+", equals = "==", less = "<", logical = "||";
+    Output discard;
+    bool lvalue;
+
+
+    output = &discard;
+    openScope();
+    declareVariable("x", integer);
+
+    run("rule/identifier", 0, 0, nullptr, [&]() {
+	sink += checkIdentifier("x") != nullptr;
+    });
+
+    run("rule/multiplicative", 0, 0, nullptr, [&]() {
+	sink += checkMultiplicative(integer, character, times).isError();
+    });
+
+    run("rule/additive", 0, 0, nullptr, [&]() {
+	sink += checkAdditive(pointer, integer, plus).isError();
+    });
+
+    run("rule/equality", 0, 0, nullptr, [&]() {
+	sink += checkEquality(pointer, Type(VOID, 1), equals).isError();
+    });
+
+    run("rule/relational", 0, 0, nullptr, [&]() {
+	sink += checkRelational(integer, character, less).isError();
+    });
+
+    run("rule/logical", 0, 0, nullptr, [&]() {
+	sink += checkLogical(pointer, integer, logical).isError();
+    });
+
+    run("rule/postfix", 0, 0, nullptr, [&]() {
+	sink += checkPostfix(array, integer).isError();
+    });
+
+    run("rule/deref", 0, 0, nullptr, [&]() {
+	sink += checkDeref(pointer, lvalue).isError();
+    });
+
+    run("rule/addr", 0, 0, nullptr, [&]() {
+	lvalue = true;
+	sink += checkAddr(integer, lvalue).isError();
+    });
+
+    run("rule/not", 0, 0, nullptr, [&]() {
+	sink += checkNot(pointer, lvalue).isError();
+    });
+
+    run("rule/neg", 0, 0, nullptr, [&]() {
+	sink += checkNeg(character, lvalue).isError();
+    });
+
+    run("rule/sizeof", 0, 0, nullptr, [&]() {
+	sink += checkSizeof(array, lvalue).isError();
+    });
+
+    closeScope();
+    output = nullptr;
+}
+
+
+/*
+ * Function:	benchCheck
+ *
+ * Description:	Time checking all of the inputs, and, if requested,
+ *		running gcc -fsyntax-only on the same files.
+ */
+
+static void benchCheck(const vector<Input> &inputs, double bytes, double tokens, bool gcc)
+{
+    Context context;
+    string command;
+
+
+    run("check/all", bytes, tokens, "tokens", [&]() {
+	for (auto &input : inputs)
+	    sink += context.check(input.text.data(), input.text.size()).status;
+    });
+
+    if (!gcc)
+	return;
+
+    for (auto &input : inputs)
+	if (!input.path.empty())
+	    command += " '" + input.path + "'";
+
+    if (command.empty()) {
+	cerr << "scc-bench: gcc needs files to check" << endl;
+	return;
+    }
+
+    command = "gcc -fsyntax-only -w -x c" + command + " > /dev/null 2>&1";
+
+    run("gcc/all", bytes, tokens, "tokens", [&]() {
+	sink += system(command.c_str());
+    });
+}
+
+
+/*
+ * Function:	main
+ *
+ * Description:	Read the inputs and run every benchmark.
+ */
+
+int main(int argc, char *argv[])
+{
+    vector<Input> inputs;
+    vector<string> paths;
+    double bytes, tokens, threshold = 5;
+    const char *commit = nullptr;
+    string line, directory = "baselines", path;
+    bool gcc = false, save = false;
+    Generator::Knobs knobs;
+    Baseline baseline;
+    int opt;
+
+
+    while ((opt = getopt(argc, argv, "B:c:f:gr:st:T:")) != -1)
+	if (opt == 'B')
+	    directory = optarg;
+	else if (opt == 'c')
+	    commit = optarg;
+	else if (opt == 'f')
+	    filter = optarg;
+	else if (opt == 'g')
+	    gcc = true;
+	else if (opt == 's')
+	    save = true;
+	else if (opt == 'T')
+	    threshold = atof(optarg);
+	else if (opt == 'r')
+	    repetitions = max(atoi(optarg), 1);
+	else if (opt == 't')
+	    target = atof(optarg);
+	else {
+	    cerr << "usage: " << argv[0] << " [-r repetitions] [-t seconds] [-f filter] [-g]" << endl;
+	    cerr << "       [-B directory] [-s] [-c commit [-T percent]] [file | @list] ..." << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+    for (int i = optind; i < argc; i ++)
+	if (argv[i][0] == '@') {
+	    ifstream list(argv[i] + 1);
+
+	    while (getline(list, line))
+		if (!line.empty())
+		    paths.push_back(line);
+	} else
+	    paths.push_back(argv[i]);
+
+    for (auto &path : paths) {
+	ifstream file(path);
+	ostringstream text;
+
+	if (!file) {
+	    cerr << argv[0] << ": cannot open " << path << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	text << file.rdbuf();
+	inputs.push_back(Input {path, text.str(), 0});
+    }
+
+    if (inputs.empty()) {
+	knobs.functions = 250;
+	inputs.push_back(Input {"", Generator(knobs).generate(), 0});
+    }
+
+    bytes = tokens = 0;
+
+    for (auto &input : inputs) {
+	input.tokens = count(input.text);
+	bytes += input.text.size();
+	tokens += input.tokens;
+    }
+
+    cout << inputs.size() << " files, " << (size_t) bytes << " bytes, ";
+    cout << (size_t) tokens << " tokens, " << repetitions << " samples" << endl;
+
+    benchLexer(inputs, bytes, tokens);
+    benchScopes();
+    benchTypes();
+    benchRules();
+    benchCheck(inputs, bytes, tokens, gcc);
+
+    results.commit = commitName();
+    results.machine = machineName();
+    directory += "/" + results.machine;
+
+    if (save) {
+	mkdir(directory.substr(0, directory.rfind('/')).c_str(), 0777);
+	mkdir(directory.c_str(), 0777);
+	path = directory + "/" + results.commit + ".json";
+
+	if (!saveBaseline(path, results)) {
+	    cerr << argv[0] << ": cannot write " << path << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	cout << "saved " << path << endl;
+    }
+
+    if (commit != nullptr) {
+	path = directory + "/" + commit + ".json";
+
+	if (!loadBaseline(path, baseline)) {
+	    cerr << argv[0] << ": cannot read " << path << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	if (compareBaseline(baseline, results, threshold) > 0)
+	    exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
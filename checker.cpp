@@ -9,9 +9,18 @@
  *
  *		Extra functionality:
  *		- inserting an undeclared symbol with the error type
+ *
+ *		If an incremental engine is given, it is told of each
+ *		global name consulted or declared and each symbol written,
+ *		so that it knows what each global or function depends on.
+ *
+ *		A closed scope other than the outermost one is kept, with
+ *		its symbols, until released.  The syntax tree and the
+ *		cross-reference index know symbols by their addresses, so
+ *		the addresses must not be reused until the translation unit
+ *		is finished.
  */
 
-# include <iostream>
 # include <string>
 # include "lexer.h"
 # include "checker.h"
@@ -19,11 +28,21 @@
 # include "Symbol.h"
 # include "Scope.h"
 # include "Type.h"
+# include "Output.h"
+# include "Incremental.h"
+# include "Stats.h"
+# include "Memory.h"
+# include "probes.h"
 
 
 using namespace std;
 
-static Scope *outermost, *toplevel;
+thread_local Output *output;
+thread_local const Prelude *prelude;
+thread_local Scope *initial;
+thread_local Incremental *incremental;
+static thread_local Scope *outermost, *toplevel;
+static thread_local vector<Scope *> closed;
 static const Type error;
 
 static string redefined = "redefinition of '%s'";
@@ -40,16 +59,38 @@ static string bad_lvalue = "lvalue required in expression";
 /*
  * Function:	openScope
  *
- * Description:	Create a scope and make it the new top-level scope.
+ * Description:	Create a scope and make it the new top-level scope.  A
+ *		new outermost scope starts with the symbols of the current
+ *		prelude, if any, which are not written to the output.  If
+ *		an initial scope has been given, it is used just once as
+ *		the next outermost scope instead.
  */
 
 Scope *openScope()
 {
+    Memory::Tag tag(Memory::SCOPES);
+
+
+    if (stats != nullptr)
+	stats->open();
+
+    if (toplevel == nullptr && initial != nullptr) {
+	toplevel = outermost = initial;
+	initial = nullptr;
+	PROBE2(scope__open, toplevel, toplevel->enclosing());
+	return toplevel;
+    }
+
     toplevel = new Scope(toplevel);
 
-    if (outermost == nullptr)
+    if (outermost == nullptr) {
 	outermost = toplevel;
 
+	if (prelude != nullptr)
+	    prelude->install(outermost);
+    }
+
+    PROBE2(scope__open, toplevel, toplevel->enclosing());
     return toplevel;
 }
 
@@ -58,17 +99,66 @@ Scope *openScope()
  * Function:	closeScope
  *
  * Description:	Remove the top-level scope, and make its enclosing scope
- *		the new top-level scope.
+ *		the new top-level scope.  Closing the outermost scope
+ *		finishes the translation unit, so that the next scope
+ *		opened will be a new outermost scope.
  */
 
 Scope *closeScope()
 {
     Scope *old = toplevel;
     toplevel = toplevel->enclosing();
+    PROBE2(scope__close, old, old->symbols().size());
+
+    if (stats != nullptr)
+	stats->close(old->symbols().size());
+
+    if (toplevel == nullptr)
+	outermost = nullptr;
+    else
+	closed.push_back(old);
+
     return old;
 }
 
 
+/*
+ * Function:	deleteScope
+ *
+ * Description:	Delete the given scope, which must be closed, along with
+ *		its symbols and the parameters of their function types,
+ *		which belong to them.
+ */
+
+void deleteScope(Scope *scope)
+{
+    for (auto symbol : scope->symbols()) {
+	if (symbol->type().isFunction())
+	    delete symbol->type().parameters();
+
+	delete symbol;
+    }
+
+    delete scope;
+}
+
+
+/*
+ * Function:	releaseScopes
+ *
+ * Description:	Delete the scopes other than the outermost one that have
+ *		been closed since they were last released.
+ */
+
+void releaseScopes()
+{
+    for (auto scope : closed)
+	deleteScope(scope);
+
+    closed.clear();
+}
+
+
 /*
  * Function:	defineFunction
  *
@@ -80,9 +170,17 @@ Scope *closeScope()
 
 Symbol *defineFunction(const string &name, const Type &type)
 {
-    cout << name << ": " << type << endl;
+    Stats::Timer timer(Stats::CHECK);
+    PROBE2(check, "defineFunction", lineno);
+    Memory::Tag tag(Memory::SYMBOLS);
+    output->write(name, type);
     Symbol *symbol = outermost->find(name);
 
+    if (incremental != nullptr) {
+	incremental->write(name, type);
+	incremental->define(name, symbol);
+    }
+
     if (symbol != nullptr) {
 	if (symbol->type().isFunction() && symbol->type().parameters()) {
 	    report(redefined, name);
@@ -111,9 +209,17 @@ Symbol *defineFunction(const string &name, const Type &type)
 
 Symbol *declareFunction(const string &name, const Type &type)
 {
-    cout << name << ": " << type << endl;
+    Stats::Timer timer(Stats::CHECK);
+    PROBE2(check, "declareFunction", lineno);
+    Memory::Tag tag(Memory::SYMBOLS);
+    output->write(name, type);
     Symbol *symbol = outermost->find(name);
 
+    if (incremental != nullptr) {
+	incremental->write(name, type);
+	incremental->define(name, symbol);
+    }
+
     if (symbol == nullptr) {
 	symbol = new Symbol(name, type);
 	outermost->insert(symbol);
@@ -138,9 +244,19 @@ Symbol *declareFunction(const string &name, const Type &type)
 
 Symbol *declareVariable(const string &name, const Type &type)
 {
-    cout << name << ": " << type << endl;
+    Stats::Timer timer(Stats::CHECK);
+    PROBE2(check, "declareVariable", lineno);
+    Memory::Tag tag(Memory::SYMBOLS);
+    output->write(name, type);
     Symbol *symbol = toplevel->find(name);
 
+    if (incremental != nullptr) {
+	incremental->write(name, type);
+
+	if (toplevel == outermost)
+	    incremental->define(name, symbol);
+    }
+
     if (symbol == nullptr) {
 	if (type.specifier() == VOID && type.indirection() == 0)
 	    report(void_object, name);
@@ -168,8 +284,14 @@ Symbol *declareVariable(const string &name, const Type &type)
 
 Symbol *checkIdentifier(const string &name)
 {
+    Stats::Timer timer(Stats::CHECK);
+    PROBE2(check, "checkIdentifier", lineno);
+    Memory::Tag tag(Memory::SYMBOLS);
     Symbol *symbol = toplevel->lookup(name);
 
+    if (incremental != nullptr && (symbol == nullptr || outermost->find(name) == symbol))
+	incremental->use(name, symbol);
+
     if (symbol == nullptr) {
 	report(undeclared, name);
 	symbol = new Symbol(name, error);
@@ -181,6 +303,11 @@ Symbol *checkIdentifier(const string &name)
 
 Type checkMultiplicative(const Type& left, const Type& right, const string& op)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkMultiplicative", lineno);
+	if(left.isError() || right.isError())
+		return error;
+
 	if(left.promote().isInteger() && right.promote().isInteger())
 		return left;
 	else{
@@ -191,6 +318,11 @@ Type checkMultiplicative(const Type& left, const Type& right, const string& op)
 
 Type checkEquality(const Type& left, const Type& right, const string& op)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkEquality", lineno);
+	if(left.isError() || right.isError())
+		return error;
+
 	if(left.isCompatibleWith(right))
 		return Type(INT);
 
@@ -200,6 +332,11 @@ Type checkEquality(const Type& left, const Type& right, const string& op)
 
 Type checkRelational(const Type& left, const Type& right, const string& op)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkRelational", lineno);
+	if(left.isError() || right.isError())
+		return error;
+
 	Type l = left.promote();
 	Type r = right.promote();
 
@@ -215,6 +352,11 @@ Type checkRelational(const Type& left, const Type& right, const string& op)
 
 Type checkLogical(const Type& left, const Type& right, const string& op)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkLogical", lineno);
+	if(left.isError() || right.isError())
+		return error;
+
 	Type l = left.promote();
 	Type r = right.promote();
 
@@ -227,6 +369,8 @@ Type checkLogical(const Type& left, const Type& right, const string& op)
 
 Type checkPostfix(const Type& operand, const Type& expr)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkPostfix", lineno);
 	Type o = operand.promote();
 	Type e = expr.promote();
 
@@ -241,6 +385,11 @@ Type checkPostfix(const Type& operand, const Type& expr)
 
 Type checkAdditive(const Type& left, const Type& right, const string& op)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkAdditive", lineno);
+	if(left.isError() || right.isError())
+		return error;
+
 	Type l = left.promote();
 	Type r = right.promote();
 
@@ -264,6 +413,8 @@ Type checkAdditive(const Type& left, const Type& right, const string& op)
 
 Type checkDeref(const Type& operand, bool& lvalue)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkDeref", lineno);
 	Type o = operand.promote();
 	if(o.isPointer() && o.specifier() != VOID){
 		lvalue = true;
@@ -275,6 +426,8 @@ Type checkDeref(const Type& operand, bool& lvalue)
 }
 
 Type checkAddr(const Type& operand, bool& lvalue){
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkAddr", lineno);
 
 	if(lvalue){
 		lvalue = false;
@@ -285,6 +438,8 @@ Type checkAddr(const Type& operand, bool& lvalue){
 }
 
 Type checkNot(const Type& operand, bool& lvalue){
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkNot", lineno);
 	lvalue = false;
 	if(operand.isValue())
 		return Type(INT);
@@ -295,6 +450,8 @@ Type checkNot(const Type& operand, bool& lvalue){
 
 Type checkNeg(const Type& operand, bool& lvalue)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkNeg", lineno);
 	lvalue = false;
 	if(operand.promote().isInteger())
 		return Type(INT);
@@ -306,6 +463,8 @@ Type checkNeg(const Type& operand, bool& lvalue)
 
 Type checkSizeof(const Type& operand, bool& lvalue)
 {
+	Stats::Timer timer(Stats::CHECK);
+	PROBE2(check, "checkSizeof", lineno);
 	lvalue = false;
 	if(operand.isValue())
 		return Type(INT);
@@ -8,12 +8,23 @@
 # ifndef CHECKER_H
 # define CHECKER_H
 # include "Scope.h"
+# include "Output.h"
+# include "Prelude.h"
 # include <string>
 
 using namespace std;
 
+class Incremental;
+
+extern thread_local Output *output;
+extern thread_local const Prelude *prelude;
+extern thread_local Scope *initial;
+extern thread_local Incremental *incremental;
+
 Scope *openScope();
 Scope *closeScope();
+void deleteScope(Scope *scope);
+void releaseScopes();
 
 Symbol *defineFunction(const std::string &name, const Type &type);
 Symbol *declareFunction(const std::string &name, const Type &type);
@@ -0,0 +1,424 @@
+/*
+ * File:	forkserver.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for running the checker as a fork
+ *		server.  The server checks a prelude once, keeping its
+ *		outermost scope, and then forks a child for each file it is
+ *		asked to check.  The child starts from the scope it
+ *		inherited, so it needs no initialization at all, and since
+ *		the pages holding the scope are only copied when a child
+ *		writes to them, the scope is shared by all of the children
+ *		running at once.  Nothing a child does can disturb the
+ *		server or the other children.
+ *
+ *		The server speaks a subset of the protocol of the threaded
+ *		server, over the standard input and output or a Unix domain
+ *		socket:
+ *
+ *		  check path		check the named file
+ *		  quit			stop the server once the checks
+ *					in flight are answered
+ *
+ *		Each child sends its answer, in the same form as that of
+ *		the threaded server, back through a pipe, and the server
+ *		passes it on to the client once it is complete.  A child
+ *		that dies is answered with "error path: message".  At most
+ *		JOBS children run at once, and further requests wait.  A
+ *		client that goes away before its answer is ready is simply
+ *		not answered.
+ *
+ *		The server itself never starts a thread, which is what
+ *		makes forking it safe.
+ */
+
+# include <deque>
+# include <memory>
+# include <cerrno>
+# include <csignal>
+# include <cstdlib>
+# include <cstring>
+# include <sstream>
+# include <iostream>
+# include <poll.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/un.h>
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include "forkserver.h"
+# include "checker.h"
+# include "parser.h"
+# include "lexer.h"
+# include "batch.h"
+
+using namespace std;
+
+struct Connection {
+    int in, out;
+    string input;
+    bool closed;
+};
+
+struct Child {
+    pid_t pid;
+    int fd;
+    string path, answer;
+    shared_ptr<Connection> client;
+};
+
+struct Request {
+    string path;
+    shared_ptr<Connection> client;
+};
+
+
+/*
+ * Function:	writeAll
+ *
+ * Description:	Write all of the given bytes to a file descriptor.  Return
+ *		whether the write was successful.
+ */
+
+static bool writeAll(int fd, const string &data)
+{
+    const char *p = data.data();
+    size_t left = data.size();
+    ssize_t n;
+
+
+    while (left > 0) {
+	if ((n = write(fd, p, left)) < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    return false;
+
+	p += n;
+	left -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	send
+ *
+ * Description:	Write the given data to a client, unless it has gone away.
+ */
+
+static void send(Connection &client, const string &data)
+{
+    if (!client.closed && !writeAll(client.out, data))
+	client.closed = true;
+}
+
+
+/*
+ * Function:	child
+ *
+ * Description:	Check the given file starting from the given scope and
+ *		write the answer to the given file descriptor.  This runs
+ *		in the child process, and never returns.
+ */
+
+static void child(int fd, const string &path, Scope *scope, const Options &options)
+{
+    ostringstream header;
+    Result result;
+    string buf;
+    int file;
+
+
+    if ((file = open(path.c_str(), O_RDONLY)) < 0 || !readFile(file, buf)) {
+	writeAll(fd, "error " + path + ": " + strerror(errno) + "\n");
+	_exit(EXIT_FAILURE);
+    }
+
+    initial = scope;
+    result = check(buf.data(), buf.size(), options);
+
+    header << "result " << path << " " << result.status << " ";
+    header << result.symbols.size() << " ";
+    header << result.diagnostics.size() << "\n";
+
+    writeAll(fd, header.str() + result.symbols + result.diagnostics);
+    _exit(EXIT_SUCCESS);
+}
+
+
+/*
+ * Function:	spawn
+ *
+ * Description:	Fork a child to answer the given request.
+ */
+
+static void spawn(vector<Child> &children, const Request &r, Scope *scope, const Options &options)
+{
+    int fds[2];
+    pid_t pid;
+
+
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+	send(*r.client, "error " + r.path + ": " + strerror(errno) + "\n");
+	return;
+    }
+
+    if ((pid = fork()) == 0) {
+	close(fds[0]);
+	child(fds[1], r.path, scope, options);
+    }
+
+    close(fds[1]);
+
+    if (pid < 0) {
+	close(fds[0]);
+	send(*r.client, "error " + r.path + ": " + strerror(errno) + "\n");
+	return;
+    }
+
+    children.push_back(Child {pid, fds[0], r.path, "", r.client});
+}
+
+
+/*
+ * Function:	finish
+ *
+ * Description:	Reap a child whose pipe has closed and pass its answer on
+ *		to its client.
+ */
+
+static void finish(Child &c)
+{
+    int status;
+
+
+    close(c.fd);
+
+    while (waitpid(c.pid, &status, 0) < 0 && errno == EINTR)
+	continue;
+
+    if (WIFSIGNALED(status))
+	send(*c.client, "error " + c.path + ": killed by signal " +
+	    to_string(WTERMSIG(status)) + "\n");
+    else if (c.answer.empty())
+	send(*c.client, "error " + c.path + ": no answer\n");
+    else
+	send(*c.client, c.answer);
+}
+
+
+/*
+ * Function:	request
+ *
+ * Description:	Queue the next complete request from a client, if there
+ *		is one.  Return whether a request was handled.
+ */
+
+static bool request(shared_ptr<Connection> client, deque<Request> &pending, bool &stopping)
+{
+    string line, command, argument;
+    string::size_type end, space;
+
+
+    if ((end = client->input.find('\n')) == string::npos)
+	return false;
+
+    line = client->input.substr(0, end);
+    client->input.erase(0, end + 1);
+
+    space = line.find(' ');
+    command = line.substr(0, space);
+    argument = space == string::npos ? "" : line.substr(space + 1);
+
+    if (command == "check")
+	pending.push_back(Request {argument, client});
+
+    else if (command == "quit")
+	stopping = true;
+
+    else if (!line.empty())
+	send(*client, "error unknown request '" + command + "'\n");
+
+    return true;
+}
+
+
+/*
+ * Function:	warm
+ *
+ * Description:	Check the given prelude and return its outermost scope, or
+ *		a null pointer if it has errors or cannot be read.
+ */
+
+static Scope *warm(const char *path, const Options &options)
+{
+    Output discard;
+    Scope *scope;
+    string buf;
+    bool ok;
+    int fd;
+
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+	cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	return nullptr;
+    }
+
+    ok = readFile(fd, buf);
+    close(fd);
+
+    if (!ok) {
+	cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	return nullptr;
+    }
+
+    output = &discard;
+    prelude = options.prelude;
+    ok = translationUnit(buf.data(), buf.size(), &scope) == EXIT_SUCCESS && numerrors == 0;
+    output = nullptr;
+
+    if (!ok) {
+	cerr << "scc: " << path << ": prelude has errors" << endl;
+	return nullptr;
+    }
+
+    return scope;
+}
+
+
+/*
+ * Function:	forkServe
+ *
+ * Description:	Check the given prelude and then serve requests on the
+ *		given Unix domain socket, or on the standard input and
+ *		output if no socket is given, until told to quit.  Return
+ *		the exit status of the server.
+ *
+ *		The cache is not used, since its keys know nothing of a
+ *		prelude checked from source.
+ */
+
+int forkServe(const char *path, const char *source, unsigned jobs, const Options &options)
+{
+    vector<shared_ptr<Connection>> clients;
+    vector<struct pollfd> fds;
+    vector<Child> children;
+    deque<Request> pending;
+    struct sockaddr_un addr;
+    Options unit = options;
+    int fd, listener;
+    char buf[65536];
+    bool stopping;
+    Scope *scope;
+    unsigned i;
+    ssize_t n;
+
+
+    if ((scope = warm(source, options)) == nullptr)
+	return EXIT_FAILURE;
+
+    if (jobs == 0)
+	jobs = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    unit.cache = nullptr;
+    unit.prelude = nullptr;
+    listener = -1;
+    stopping = false;
+
+    if (path == nullptr)
+	clients.push_back(make_shared<Connection>(Connection {STDIN_FILENO, STDOUT_FILENO, "", false}));
+
+    else {
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+
+	if ((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+		bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+		listen(listener, SOMAXCONN) < 0) {
+	    cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	    return EXIT_FAILURE;
+	}
+    }
+
+    cout.flush();
+    cerr.flush();
+
+    while (!children.empty() || !pending.empty() ||
+	    (!stopping && (listener >= 0 || !clients.empty()))) {
+	while (!pending.empty() && children.size() < jobs) {
+	    spawn(children, pending.front(), scope, unit);
+	    pending.pop_front();
+	}
+
+	fds.clear();
+
+	for (auto &c : children)
+	    fds.push_back({c.fd, POLLIN, 0});
+
+	fds.push_back({stopping ? -1 : listener, POLLIN, 0});
+
+	for (auto &c : clients)
+	    fds.push_back({stopping ? -1 : c->in, POLLIN, 0});
+
+	if (poll(fds.data(), fds.size(), -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    break;
+	}
+
+	for (i = children.size(); i -- > 0; ) {
+	    if (fds[i].revents == 0)
+		continue;
+
+	    if ((n = read(children[i].fd, buf, sizeof(buf))) > 0)
+		children[i].answer.append(buf, n);
+
+	    else if (n == 0 || errno != EINTR) {
+		finish(children[i]);
+		children.erase(children.begin() + i);
+	    }
+	}
+
+	fds.erase(fds.begin(), fds.end() - clients.size() - 1);
+
+	if (fds[0].revents & POLLIN)
+	    if ((fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) >= 0)
+		clients.push_back(make_shared<Connection>(Connection {fd, fd, "", false}));
+
+	for (i = fds.size(); i -- > 1; ) {
+	    shared_ptr<Connection> client = clients[i - 1];
+
+	    if (fds[i].revents == 0)
+		continue;
+
+	    if ((n = read(client->in, buf, sizeof(buf))) > 0) {
+		client->input.append(buf, n);
+
+		while (!stopping && request(client, pending, stopping))
+		    continue;
+
+	    } else if (n == 0 || errno != EINTR) {
+		client->closed = true;
+
+		if (client->in != STDIN_FILENO)
+		    close(client->in);
+
+		clients.erase(clients.begin() + i - 1);
+	    }
+	}
+    }
+
+    if (listener >= 0) {
+	close(listener);
+	unlink(path);
+    }
+
+    return EXIT_SUCCESS;
+}
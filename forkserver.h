@@ -0,0 +1,15 @@
+/*
+ * File:	forkserver.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		running the checker as a server that forks a process for
+ *		each file from a prelude checked once in advance.
+ */
+
+# ifndef FORKSERVER_H
+# define FORKSERVER_H
+# include "scc.h"
+
+int forkServe(const char *socket, const char *source, unsigned jobs, const Options &options);
+
+# endif /* FORKSERVER_H */
@@ -0,0 +1,107 @@
+/*
+ * File:	generate.cpp
+ *
+ * Description:	This file contains the main function for the workload
+ *		generator for the Simple C compiler, which writes a
+ *		translation unit of a requested shape to the standard
+ *		output.  The same seed and knobs always give the same
+ *		translation unit, so a scaling problem found with one can
+ *		be reproduced anywhere.
+ *
+ *		usage: scc-gen [-p preset] [-s seed] [-g globals]
+ *			[-f functions] [-d depth] [-x expression-depth]
+ *			[-l declarators] [-i identifier-length]
+ *			[-S string-size] [-n statements] [-c chain]
+ *			[-e error-rate]
+ *
+ *		-p	start from a preset (see below)
+ *		-s	seed of the random numbers (default 1)
+ *		-g	number of global declarations (default 100)
+ *		-f	number of functions (default 100)
+ *		-d	depth to which blocks are nested (default 3)
+ *		-x	depth of expressions (default 4)
+ *		-l	number of declarators per declaration (default 3)
+ *		-i	least length of identifiers (default 1)
+ *		-S	size of string literals (default 16)
+ *		-n	number of statements per block (default 4)
+ *		-c	length of a chain of || in each function (default 0)
+ *		-e	fraction of declarations and statements with an error
+ *
+ *		presets: globals (a million globals), deep (blocks nested
+ *		ten thousand deep), or-chain (a hundred thousand || in a
+ *		row), string (a string literal of 100 MB).  Any other
+ *		knobs given override those of the preset.
+ *
+ *		The generator itself is in the library, where the
+ *		benchmarks and tests use it too.
+ */
+
+# include <cstdlib>
+# include <iostream>
+# include <unistd.h>
+# include "Generator.h"
+
+using namespace std;
+
+static Generator::Knobs knobs;
+
+
+/*
+ * Function:	main
+ *
+ * Description:	Write a translation unit of the shape given by the knobs.
+ */
+
+int main(int argc, char *argv[])
+{
+    static const char *options = "c:d:e:f:g:i:l:n:p:s:x:S:";
+    int opt;
+
+
+    while ((opt = getopt(argc, argv, options)) != -1)
+	if (opt == 'p' && !Generator::preset(optarg, knobs)) {
+	    cerr << argv[0] << ": unknown preset " << optarg << endl;
+	    exit(EXIT_FAILURE);
+	} else if (opt == '?')
+	    exit(EXIT_FAILURE);
+
+    optind = 1;
+
+    while ((opt = getopt(argc, argv, options)) != -1)
+	if (opt == 'c')
+	    knobs.chain = strtoul(optarg, nullptr, 0);
+	else if (opt == 'd')
+	    knobs.depth = strtoul(optarg, nullptr, 0);
+	else if (opt == 'e')
+	    knobs.errors = atof(optarg);
+	else if (opt == 'f')
+	    knobs.functions = strtoul(optarg, nullptr, 0);
+	else if (opt == 'g')
+	    knobs.globals = strtoul(optarg, nullptr, 0);
+	else if (opt == 'i')
+	    knobs.identifier = strtoul(optarg, nullptr, 0);
+	else if (opt == 'l')
+	    knobs.declarators = strtoul(optarg, nullptr, 0);
+	else if (opt == 'n')
+	    knobs.statements = strtoul(optarg, nullptr, 0);
+	else if (opt == 's')
+	    knobs.seed = strtoull(optarg, nullptr, 0);
+	else if (opt == 'x')
+	    knobs.expression = strtoul(optarg, nullptr, 0);
+	else if (opt == 'S')
+	    knobs.literal = strtoul(optarg, nullptr, 0);
+
+    if (optind < argc) {
+	cerr << argv[0] << ": unexpected argument " << argv[optind] << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    Generator(knobs).write(cout);
+
+    if (!cout.flush()) {
+	cerr << argv[0] << ": cannot write standard output" << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
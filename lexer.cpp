@@ -18,14 +18,28 @@
 # include "string.h"
 # include "tokens.h"
 # include "lexer.h"
+# include "Stats.h"
+# include "Memory.h"
+# include "Trace.h"
+# include "probes.h"
 
 using namespace std;
-int numerrors, lineno = 1;
+thread_local int numerrors, lineno = 1;
+thread_local ostream *diagnostics = &cerr;
+
+static thread_local const char *base, *cursor, *limit, *start;
+static thread_local bool eof;
+static thread_local int c, startline;
+
+static const unsigned CHUNK = 4096;
+static thread_local unsigned chunked;
+static thread_local double chunkstart;
+static thread_local int chunkline;
 
 
 /* Later, we will associate token values with each keyword */
 
-static map<string, int> keywords = {
+static const map<string, int> keywords = {
     {"auto", AUTO},
     {"break", BREAK},
     {"case", CASE},
@@ -76,21 +90,124 @@ void report(const string &str, const string &arg)
     char buf[1000];
 
     snprintf(buf, sizeof(buf), str.c_str(), arg.c_str());
-    cerr << "line " << lineno << ": " << buf << endl;
+    *diagnostics << "line " << lineno << ": " << buf << endl;
     numerrors ++;
+    PROBE2(diagnostic, lineno, buf);
+
+    if (stats != nullptr)
+	stats->diagnostic();
 }
 
 
 /*
- * Function:	lexan
+ * Function:	get
  *
- * Description:	Read and tokenize the standard input stream.  The lexeme is
- *		stored in a buffer.
+ * Description:	Read the next character from the input buffer, just like
+ *		istream::get() would, including setting the end-of-file
+ *		flag once we try to read past the end.
  */
 
-int lexan(string &lexbuf)
+static int get()
+{
+    if (cursor < limit)
+	return (unsigned char) *cursor ++;
+
+    eof = true;
+    return EOF;
+}
+
+
+/*
+ * Function:	lexinit
+ *
+ * Description:	Prepare to tokenize the given buffer, which starts on the
+ *		given line.  All of the lexer's state is local to the
+ *		calling thread, so different threads can tokenize
+ *		different buffers at the same time.
+ */
+
+void lexinit(const char *buf, size_t length, int line)
+{
+    base = start = cursor = buf;
+    limit = buf + length;
+    eof = false;
+
+    lineno = startline = line;
+    numerrors = 0;
+    chunked = 0;
+    c = get();
+}
+
+
+/*
+ * Function:	lexseek
+ *
+ * Description:	Continue tokenizing the current buffer from the given
+ *		offset, which is on the given line, as though the most
+ *		recent token started at the given offset, the given number
+ *		of lines earlier.  The offsets are those returned by
+ *		lexstart() and lexpos().
+ */
+
+void lexseek(size_t token, size_t offset, int line, int lead)
+{
+    start = base + token;
+    cursor = base + offset;
+    eof = false;
+
+    lineno = line;
+    startline = line - lead;
+    c = get();
+}
+
+
+/*
+ * Function:	lexstart
+ *
+ * Description:	Return the offset in the buffer of the most recent token.
+ */
+
+size_t lexstart()
+{
+    return start - base;
+}
+
+
+/*
+ * Function:	lexline
+ *
+ * Description:	Return the line on which the most recent token started.
+ */
+
+int lexline()
+{
+    return startline;
+}
+
+
+/*
+ * Function:	lexpos
+ *
+ * Description:	Return the offset in the buffer of the next character to be
+ *		classified, which is just past the most recent token.
+ */
+
+size_t lexpos()
 {
-    static int c = cin.get();
+    return (eof ? limit : cursor - 1) - base;
+}
+
+
+/*
+ * Function:	scan
+ *
+ * Description:	Read and tokenize the input buffer.  The lexeme is stored
+ *		in a buffer.
+ */
+
+static int scan(string &lexbuf)
+{
+    map<string, int>::const_iterator keyword;
     bool invalid, overflow;
     long val;
     int p;
@@ -100,7 +217,7 @@ int lexan(string &lexbuf)
        and is ready to be classified.  In this way, we eliminate having to
        push back characters onto the stream, merely to read them again. */
 
-    while (!cin.eof()) {
+    while (!eof) {
 	lexbuf.clear();
 
 
@@ -110,20 +227,23 @@ int lexan(string &lexbuf)
 	    if (c == '\n')
 		lineno ++;
 
-	    c = cin.get();
+	    c = get();
 	}
 
+	start = eof ? limit : cursor - 1;
+	startline = lineno;
+
 
 	/* Check for an identifier or a keyword */
 
 	if (isalpha(c) || c == '_') {
 	    do {
 		lexbuf += c;
-		c = cin.get();
+		c = get();
 	    } while (isalnum(c) || c == '_');
 
-	    if (keywords.count(lexbuf) > 0)
-		return keywords[lexbuf];
+	    if ((keyword = keywords.find(lexbuf)) != keywords.end())
+		return keyword->second;
 
 	    return ID;
 
@@ -133,7 +253,7 @@ int lexan(string &lexbuf)
 	} else if (isdigit(c)) {
 	    do {
 		lexbuf += c;
-		c = cin.get();
+		c = get();
 	    } while (isdigit(c));
 
 	    errno = 0;
@@ -159,11 +279,11 @@ int lexan(string &lexbuf)
 	    /* Check for '||' */
 
 	    case '|':
-		c = cin.get();
+		c = get();
 
 		if (c == '|') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		}
 
 		return OR;
@@ -172,11 +292,11 @@ int lexan(string &lexbuf)
 	    /* Check for '=' and '==' */
 
 	    case '=':
-		c = cin.get();
+		c = get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return EQL;
 		}
 
@@ -186,11 +306,11 @@ int lexan(string &lexbuf)
 	    /* Check for '&' and '&&' */
 
 	    case '&':
-		c = cin.get();
+		c = get();
 
 		if (c == '&') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return AND;
 		}
 
@@ -200,11 +320,11 @@ int lexan(string &lexbuf)
 	    /* Check for '!' and '!=' */
 
 	    case '!':
-		c = cin.get();
+		c = get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return NEQ;
 		}
 
@@ -214,11 +334,11 @@ int lexan(string &lexbuf)
 	    /* Check for '<' and '<=' */
 
 	    case '<':
-		c = cin.get();
+		c = get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return LEQ;
 		}
 
@@ -228,11 +348,11 @@ int lexan(string &lexbuf)
 	    /* Check for '>' and '>=' */
 
 	    case '>':
-		c = cin.get();
+		c = get();
 
 		if (c == '=') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return GEQ;
 		}
 
@@ -242,16 +362,16 @@ int lexan(string &lexbuf)
 	    /* Check for '-', '--', and '->' */
 
 	    case '-':
-		c = cin.get();
+		c = get();
 
 		if (c == '-') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return DEC;
 
 		} else if (c == '>') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return ARROW;
 		}
 
@@ -261,11 +381,11 @@ int lexan(string &lexbuf)
 	    /* Check for '+' and '++' */
 
 	    case '+':
-		c = cin.get();
+		c = get();
 
 		if (c == '+') {
 		    lexbuf += c;
-		    c = cin.get();
+		    c = get();
 		    return INC;
 		}
 
@@ -277,28 +397,28 @@ int lexan(string &lexbuf)
 	    case '*': case '%': case ':': case ';':
 	    case '(': case ')': case '[': case ']':
 	    case '{': case '}': case '.': case ',':
-		c = cin.get();
+		c = get();
 		return lexbuf[0];
 
 
 	    /* Check for '/' or a comment */
 
 	    case '/':
-		c = cin.get();
+		c = get();
 
 		if (c == '*') {
 		    do {
-			while (c != '*' && !cin.eof()) {
+			while (c != '*' && !eof) {
 			    if (c == '\n')
 				lineno ++;
 
-			    c = cin.get();
+			    c = get();
 			}
 
-			c = cin.get();
-		    } while (c != '/' && !cin.eof());
+			c = get();
+		    } while (c != '/' && !eof);
 
-		    c = cin.get();
+		    c = get();
 		    break;
 
 		} else
@@ -310,15 +430,15 @@ int lexan(string &lexbuf)
 	    case '"':
 		do {
 		    p = c;
-		    c = cin.get();
+		    c = get();
 		    lexbuf += c;
 
 		    if (c == '\n')
 			lineno ++;
 
-		} while (p == '\\' || (c != '"' && c != '\n' && !cin.eof()));
+		} while (p == '\\' || (c != '"' && c != '\n' && !eof));
 
-		if (c == '\n' || cin.eof())
+		if (c == '\n' || eof)
 		    report("prematured end of string literal");
 		else {
 		    parseString(lexbuf, invalid, overflow);
@@ -329,7 +449,7 @@ int lexan(string &lexbuf)
 			report("escape sequence out of range in string literal");
 		}
 
-		c = cin.get();
+		c = get();
 		return STRING;
 
 
@@ -342,7 +462,7 @@ int lexan(string &lexbuf)
 	    /* Everything else is illegal */
 
 	    default:
-		c = cin.get();
+		c = get();
 		return ERROR;
 	    }
 	}
@@ -350,3 +470,73 @@ int lexan(string &lexbuf)
 
     return DONE;
 }
+
+
+/*
+ * Function:	chunk
+ *
+ * Description:	Count the given token toward the current chunk of tokens,
+ *		and record the chunk in the trace once it is full or the
+ *		input is finished.  A span for every token would cost far
+ *		more than the token itself.
+ */
+
+static void chunk(int token)
+{
+    if (chunked ++ == 0) {
+	chunkstart = trace->now();
+	chunkline = lineno;
+    }
+
+    if (chunked == CHUNK || token == DONE) {
+	trace->record("lex", "tokens", chunkstart, "\"tokens\": " +
+	    to_string(chunked) + ", \"line\": " + to_string(chunkline));
+	chunked = 0;
+    }
+}
+
+
+/*
+ * Function:	next
+ *
+ * Description:	Read and return the next token, firing its probe.
+ */
+
+static int next(string &lexbuf)
+{
+    int token = scan(lexbuf);
+
+
+    PROBE3(token, token, lineno, lexbuf.c_str());
+    return token;
+}
+
+
+/*
+ * Function:	lexan
+ *
+ * Description:	Return the next token from the input buffer, counting it
+ *		and the time taken if statistics are being gathered, and
+ *		recording it if a trace is being kept.
+ */
+
+int lexan(string &lexbuf)
+{
+    Memory::Tag tag(Memory::LEXEMES);
+    int token;
+
+
+    if (stats == nullptr && trace == nullptr)
+	return next(lexbuf);
+
+    Stats::Timer timer(Stats::LEX);
+    token = next(lexbuf);
+
+    if (stats != nullptr)
+	stats->token(token, lexbuf);
+
+    if (trace != nullptr)
+	chunk(token);
+
+    return token;
+}
@@ -8,9 +8,16 @@
 # ifndef LEXER_H
 # define LEXER_H
 # include <string>
+# include <ostream>
 
-extern int lineno, numerrors;
+extern thread_local int lineno, numerrors;
+extern thread_local std::ostream *diagnostics;
 
+void lexinit(const char *buf, size_t length, int line = 1);
+void lexseek(size_t token, size_t offset, int line, int lead);
+size_t lexstart();
+int lexline();
+size_t lexpos();
 int lexan(std::string &lexbuf);
 void report(const std::string &str, const std::string &arg = "");
 
@@ -0,0 +1,273 @@
+/*
+ * File:	link.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for checking that the globals of many
+ *		translation units agree, as a linker would.  The checker
+ *		only catches conflicting types within one translation
+ *		unit, so a function declared one way in one file and
+ *		defined another way in another goes unnoticed.
+ *
+ *		Each worker thread summarizes the next file in turn and
+ *		hands each of its globals to a partition chosen by a hash
+ *		of the name.  The globals are gathered in a small buffer
+ *		per partition, and a full buffer is merged into its
+ *		partition under the lock of that partition alone, so with
+ *		many more partitions than workers, they rarely wait.  A
+ *		partition keeps only the distinct types of each name, each
+ *		with the first file and line that declares it, so memory
+ *		grows with the number of names and not the number of
+ *		declarations.
+ *
+ *		Two types agree if they are the same, or if both are
+ *		functions with the same result and at least one has no
+ *		parameters specified, just as in the checker.  Each name
+ *		with two types that disagree is reported with every type
+ *		it has, and the report is ordered by name and then by the
+ *		order in which the files were given, so it is the same no
+ *		matter how the work was divided.
+ */
+
+# include <mutex>
+# include <atomic>
+# include <thread>
+# include <cstdlib>
+# include <iostream>
+# include <algorithm>
+# include <unordered_map>
+# include <fcntl.h>
+# include <unistd.h>
+# include "Cache.h"
+# include "batch.h"
+# include "link.h"
+
+using namespace std;
+
+static const unsigned PARTITIONS_PER_WORKER = 16;
+static const size_t BUFFER_SIZE = 1024;
+
+struct Variant {
+    uint32_t type;
+    uint32_t file;
+    uint32_t line;
+};
+
+struct Partition {
+    mutex lock;
+    vector<string> types;
+    unordered_map<string, uint32_t> numbers;
+    unordered_map<string, vector<Variant>> names;
+};
+
+struct Declaration {
+    string name, type;
+    uint32_t file, line;
+};
+
+struct Conflict {
+    const string *name;
+    const Partition *partition;
+    vector<Variant> *variants;
+};
+
+struct Link {
+    const vector<string> *paths;
+    Options options;
+    vector<Partition> partitions;
+    atomic<size_t> next;
+    atomic<int> status;
+
+    Link(unsigned n) : partitions(n), next(0), status(EXIT_SUCCESS) {}
+};
+
+
+/*
+ * Function:	agree
+ *
+ * Description:	Return whether the given types, as text, agree.
+ */
+
+static bool agree(const string &a, const string &b)
+{
+    size_t i = a.find('('), j = b.find('(');
+
+
+    if (a == b)
+	return true;
+
+    if (i == string::npos || j == string::npos || a.compare(0, i, b, 0, j) != 0)
+	return false;
+
+    return a.compare(i, string::npos, "()") == 0 || b.compare(j, string::npos, "()") == 0;
+}
+
+
+/*
+ * Function:	merge
+ *
+ * Description:	Merge the given declarations into the given partition,
+ *		and empty the list.
+ */
+
+static void merge(Partition &p, vector<Declaration> &declarations)
+{
+    lock_guard<mutex> guard(p.lock);
+    uint32_t type;
+
+
+    for (auto &d : declarations) {
+	auto it = p.numbers.find(d.type);
+
+	if (it != p.numbers.end())
+	    type = it->second;
+	else {
+	    type = p.numbers[d.type] = p.types.size();
+	    p.types.push_back(d.type);
+	}
+
+	vector<Variant> &variants = p.names[d.name];
+	auto v = variants.begin();
+
+	while (v != variants.end() && v->type != type)
+	    v ++;
+
+	if (v == variants.end())
+	    variants.push_back(Variant {type, d.file, d.line});
+	else if (d.file < v->file)
+	    *v = Variant {type, d.file, d.line};
+    }
+
+    declarations.clear();
+}
+
+
+/*
+ * Function:	worker
+ *
+ * Description:	Summarize each file not yet taken, and merge its globals
+ *		into their partitions.  A file that cannot be read or
+ *		parsed is reported and left out.
+ */
+
+static void worker(Link &l)
+{
+    vector<vector<Declaration>> buffers(l.partitions.size());
+    vector<Global> globals;
+    string buf;
+    size_t i, p;
+    int fd;
+
+
+    while ((i = l.next ++) < l.paths->size()) {
+	const string &path = (*l.paths)[i];
+
+	if ((fd = open(path.c_str(), O_RDONLY)) < 0 || !readFile(fd, buf)) {
+	    cerr << path << ": cannot read file" << endl;
+	    l.status = EXIT_FAILURE;
+
+	    if (fd >= 0)
+		close(fd);
+
+	    continue;
+	}
+
+	close(fd);
+
+	if (summarize(buf.data(), buf.size(), l.options, globals) != EXIT_SUCCESS) {
+	    cerr << path << ": cannot be parsed, left out of the link" << endl;
+	    l.status = EXIT_FAILURE;
+	    continue;
+	}
+
+	for (auto &global : globals) {
+	    if (global.type == "error")
+		continue;
+
+	    p = fingerprint(global.name.data(), global.name.size()) % buffers.size();
+	    buffers[p].push_back(Declaration {global.name, global.type, (uint32_t) i, global.line});
+
+	    if (buffers[p].size() >= BUFFER_SIZE)
+		merge(l.partitions[p], buffers[p]);
+	}
+    }
+
+    for (p = 0; p < buffers.size(); p ++)
+	if (!buffers[p].empty())
+	    merge(l.partitions[p], buffers[p]);
+}
+
+
+/*
+ * Function:	conflicts
+ *
+ * Description:	Append the names in the given partition whose types
+ *		disagree to the given list, with their types in order by
+ *		file.
+ */
+
+static void conflicts(Partition &p, vector<Conflict> &list)
+{
+    for (auto &name : p.names) {
+	vector<Variant> &variants = name.second;
+	bool found = false;
+
+	for (size_t i = 0; !found && i < variants.size(); i ++)
+	    for (size_t j = i + 1; !found && j < variants.size(); j ++)
+		found = !agree(p.types[variants[i].type], p.types[variants[j].type]);
+
+	if (!found)
+	    continue;
+
+	sort(variants.begin(), variants.end(), [](const Variant &a, const Variant &b) {
+	    return a.file < b.file;
+	});
+
+	list.push_back(Conflict {&name.first, &p, &variants});
+    }
+}
+
+
+/*
+ * Function:	linkFiles
+ *
+ * Description:	Check that the globals of the given files agree, using the
+ *		given number of workers, and report those that do not.
+ *		Return the exit status, which is a failure if any do not
+ *		or if any file was left out.
+ */
+
+int linkFiles(const vector<string> &paths, unsigned workers, const Options &options)
+{
+    vector<Conflict> list;
+    vector<thread> threads;
+
+
+    if (workers == 0)
+	workers = 1;
+
+    Link l(workers * PARTITIONS_PER_WORKER);
+    l.paths = &paths;
+    l.options = options;
+
+    for (unsigned i = 0; i < workers && i < paths.size(); i ++)
+	threads.emplace_back(worker, ref(l));
+
+    for (auto &t : threads)
+	t.join();
+
+    for (auto &p : l.partitions)
+	conflicts(p, list);
+
+    sort(list.begin(), list.end(), [](const Conflict &a, const Conflict &b) {
+	return *a.name < *b.name;
+    });
+
+    for (auto &c : list) {
+	cerr << "conflicting types for '" << *c.name << "' across files" << endl;
+
+	for (auto &v : *c.variants)
+	    cerr << "\t" << paths[v.file] << ":" << v.line << ": " << c.partition->types[v.type] << endl;
+    }
+
+    return list.empty() ? (int) l.status : EXIT_FAILURE;
+}
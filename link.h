@@ -0,0 +1,16 @@
+/*
+ * File:	link.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		checking that the globals of many translation units agree.
+ */
+
+# ifndef LINK_H
+# define LINK_H
+# include <string>
+# include <vector>
+# include "scc.h"
+
+int linkFiles(const std::vector<std::string> &paths, unsigned workers, const Options &options);
+
+# endif /* LINK_H */
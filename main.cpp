@@ -0,0 +1,434 @@
+/*
+ * File:	main.cpp
+ *
+ * Description:	This file contains the main function for the Simple C
+ *		compiler, which checks either the standard input stream or
+ *		a list of files.
+ *
+ *		usage: scc [options] [-j jobs] [-w window] [file | @list] ...
+ *		       scc [options] --shards count [file | @list] ...
+ *		       scc [options] [-j jobs] --server [--socket path]
+ *		       scc [options] [-j jobs] --fork-server prelude [--socket path]
+ *
+ *		       scc [options] [-j jobs] --database dir [file | @list] ...
+ *		       scc --database dir --query name
+ *		       scc [options] [-j jobs] --link [file | @list] ...
+ *
+ *		       scc [options] --emit-prelude image
+ *		       scc [options] --tree image
+ *
+ *		options: [-b] [--cache dir [--cache-size bytes]] [--prelude image]
+ *			 [--stats [--counters] [--top count]] [--mem-report]
+ *			 [--trace file] [--metrics file [--metrics-interval seconds]]
+ *
+ *		-b, --binary	write a binary symbol dump instead of text
+ *		-j, --jobs	number of worker threads for a list of files
+ *				or a server
+ *		-w, --window	number of files to read ahead of the workers
+ *		    --shards	number of worker processes for a list of files
+ *		-s, --server	serve check requests on the standard input
+ *		    --socket	serve check requests on a Unix domain socket
+ *		    --fork-server	check a prelude once and then serve
+ *				check requests by forking a process per file
+ *		    --cache	directory of cached results to reuse and fill
+ *		    --cache-size	limit on the size of the cache (default 256M)
+ *		    --prelude	precompiled declarations to start each file with
+ *		    --emit-prelude	precompile the declarations on the standard
+ *				input into an image
+ *		    --tree	also write the syntax tree of the standard input
+ *				as an image
+ *		    --database	directory of per-file symbol shards and their
+ *				index to update with the files given
+ *		    --query	write where the given global is declared and
+ *				referenced across the database
+ *		    --link	report globals whose types disagree across
+ *				the files given, leaving out any that do not
+ *				parse
+ *		    --stats	write the time taken by each phase and counts
+ *				of the work done in checking the standard
+ *				input to the standard error, or for a list
+ *				of files, the bytes read and the time spent
+ *				waiting for them, and for a list of files or
+ *				a server, a summary of their latency
+ *		    --counters	also count hardware events in each phase and
+ *				declaration, if the machine allows it
+ *		    --top	number of the most expensive declarations to
+ *				list with the statistics (default 10)
+ *		    --mem-report	write the memory allocated by each part of
+ *				the front end in checking the standard input
+ *				to the standard error
+ *		    --trace	write a timeline of the declarations,
+ *				functions, files, and workers checked to the
+ *				given file, for Perfetto or chrome://tracing
+ *		    --metrics	file to write the latency and throughput of a
+ *				batch or server to, in the Prometheus text
+ *				format, while it runs, with a summary to the
+ *				standard error at the end
+ *		    --metrics-interval	seconds between writes of the
+ *				metrics (default 10)
+ *
+ *		An argument beginning with an at-sign names a response
+ *		file containing further file names, one per line.
+ */
+
+# include <thread>
+# include <cstdlib>
+# include <cstring>
+# include <fstream>
+# include <iostream>
+# include <getopt.h>
+# include <unistd.h>
+# include "checker.h"
+# include "Cache.h"
+# include "Tree.h"
+# include "lexer.h"
+# include "parser.h"
+# include "forkserver.h"
+# include "server.h"
+# include "shard.h"
+# include "batch.h"
+# include "repository.h"
+# include "link.h"
+# include "Stats.h"
+# include "Memory.h"
+# include "Trace.h"
+# include "Metrics.h"
+
+using namespace std;
+
+
+/*
+ * Function:	usage
+ *
+ * Description:	Write a usage message and terminate the program.
+ */
+
+static void usage(const char *name)
+{
+    cerr << "usage: " << name << " [options] [-j jobs] [-w window] [file | @list] ..." << endl;
+    cerr << "       " << name << " [options] --shards count [file | @list] ..." << endl;
+    cerr << "       " << name << " [options] [-j jobs] --server [--socket path]" << endl;
+    cerr << "       " << name << " [options] [-j jobs] --fork-server prelude [--socket path]" << endl;
+    cerr << "       " << name << " [options] [-j jobs] --database dir [file | @list] ..." << endl;
+    cerr << "       " << name << " --database dir --query name" << endl;
+    cerr << "       " << name << " [options] [-j jobs] --link [file | @list] ..." << endl;
+    cerr << "       " << name << " [options] --emit-prelude image" << endl;
+    cerr << "       " << name << " [options] --tree image" << endl;
+    cerr << "options: [-b] [--cache dir [--cache-size bytes]] [--prelude image]" << endl;
+    cerr << "         [--stats [--counters] [--top count]] [--mem-report] [--trace file]" << endl;
+    cerr << "         [--metrics file [--metrics-interval seconds]]" << endl;
+    exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Function:	finishTrace
+ *
+ * Description:	Write the trace being kept to its file.  This is done at
+ *		exit, since every mode of the program exits rather than
+ *		returning.
+ */
+
+static const char *timeline;
+
+static void finishTrace()
+{
+    if (!trace->save(timeline))
+	cerr << "scc: cannot write " << timeline << endl;
+}
+
+
+/*
+ * Function:	measure
+ *
+ * Description:	Start measuring the latency and throughput of inputs of the
+ *		given kind, writing them to the given file, if any, every
+ *		given number of seconds.
+ */
+
+static void measure(const char *item, const char *path, unsigned interval)
+{
+    metrics = new Metrics(item);
+
+    if (path != nullptr)
+	metrics->start(path, interval);
+}
+
+
+/*
+ * Function:	parseSize
+ *
+ * Description:	Return the number of bytes in the given size, which may end
+ *		with K, M, or G.
+ */
+
+static uint64_t parseSize(const char *s)
+{
+    char *end;
+    uint64_t n;
+
+
+    n = strtoull(s, &end, 10);
+
+    if (*end == 'K' || *end == 'k')
+	n <<= 10;
+    else if (*end == 'M' || *end == 'm')
+	n <<= 20;
+    else if (*end == 'G' || *end == 'g')
+	n <<= 30;
+
+    return n;
+}
+
+
+/*
+ * Function:	main
+ *
+ * Description:	Analyze the standard input stream, or each of the files
+ *		named on the command line.  The symbols are written to the
+ *		standard output, as text by default or as a binary dump if
+ *		requested.
+ */
+
+int main(int argc, char *argv[])
+{
+    static struct option longopts[] = {
+	{"binary", no_argument, nullptr, 'b'},
+	{"jobs", required_argument, nullptr, 'j'},
+	{"window", required_argument, nullptr, 'w'},
+	{"shards", required_argument, nullptr, 'P'},
+	{"server", no_argument, nullptr, 's'},
+	{"socket", required_argument, nullptr, 'S'},
+	{"fork-server", required_argument, nullptr, 'F'},
+	{"cache", required_argument, nullptr, 'C'},
+	{"cache-size", required_argument, nullptr, 'Z'},
+	{"prelude", required_argument, nullptr, 'p'},
+	{"emit-prelude", required_argument, nullptr, 'E'},
+	{"tree", required_argument, nullptr, 'T'},
+	{"database", required_argument, nullptr, 'D'},
+	{"query", required_argument, nullptr, 'Q'},
+	{"link", no_argument, nullptr, 'L'},
+	{"stats", no_argument, nullptr, 'R'},
+	{"counters", no_argument, nullptr, 'H'},
+	{"mem-report", no_argument, nullptr, 'M'},
+	{"trace", required_argument, nullptr, 'X'},
+	{"top", required_argument, nullptr, 'N'},
+	{"metrics", required_argument, nullptr, 'O'},
+	{"metrics-interval", required_argument, nullptr, 'I'},
+	{nullptr, 0, nullptr, 0},
+    };
+
+    uint64_t limit = 256 << 20;
+    const char *directory = nullptr, *image = nullptr, *emit = nullptr;
+    const char *ast = nullptr, *database = nullptr, *query = nullptr;
+    unsigned workers = thread::hardware_concurrency();
+    unsigned window = 32, shards = 0, top = 10, interval = 10;
+    const char *socket = nullptr, *source = nullptr, *published = nullptr;
+    bool server = false, link = false, report = false, counters = false;
+    bool allocations = false;
+    Options options;
+    vector<string> paths;
+    string buf, line;
+    int opt, status;
+
+
+    while ((opt = getopt_long(argc, argv, "bj:sw:", longopts, nullptr)) != -1)
+	if (opt == 'b')
+	    options.format = Output::BINARY;
+	else if (opt == 'j')
+	    workers = atoi(optarg);
+	else if (opt == 'w')
+	    window = atoi(optarg);
+	else if (opt == 'P')
+	    shards = atoi(optarg);
+	else if (opt == 's')
+	    server = true;
+	else if (opt == 'S')
+	    server = true, socket = optarg;
+	else if (opt == 'F')
+	    source = optarg;
+	else if (opt == 'C')
+	    directory = optarg;
+	else if (opt == 'Z')
+	    limit = parseSize(optarg);
+	else if (opt == 'p')
+	    image = optarg;
+	else if (opt == 'E')
+	    emit = optarg;
+	else if (opt == 'T')
+	    ast = optarg;
+	else if (opt == 'D')
+	    database = optarg;
+	else if (opt == 'Q')
+	    query = optarg;
+	else if (opt == 'L')
+	    link = true;
+	else if (opt == 'R')
+	    report = true;
+	else if (opt == 'H')
+	    report = counters = true;
+	else if (opt == 'M')
+	    allocations = true;
+	else if (opt == 'X')
+	    timeline = optarg;
+	else if (opt == 'N')
+	    report = true, top = atoi(optarg);
+	else if (opt == 'O')
+	    published = optarg;
+	else if (opt == 'I')
+	    interval = atoi(optarg);
+	else
+	    usage(argv[0]);
+
+    if (timeline != nullptr) {
+	trace = new Trace();
+	trace->thread("main");
+	atexit(finishTrace);
+    }
+
+    if (image != nullptr) {
+	Prelude *loaded = new Prelude();
+
+	if (!loaded->open(image)) {
+	    cerr << argv[0] << ": cannot load prelude " << image << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	options.prelude = loaded;
+    }
+
+    if (directory != nullptr)
+	options.cache = new Cache(directory, limit);
+
+    if (source != nullptr)
+	exit(forkServe(socket, source, workers, options));
+
+    if (server) {
+	if (published != nullptr || report)
+	    measure("request", published, interval);
+
+	exit(serve(socket, workers, options));
+    }
+
+    for (int i = optind; i < argc; i ++)
+	if (argv[i][0] == '@') {
+	    ifstream list(argv[i] + 1);
+
+	    if (!list) {
+		cerr << argv[0] << ": cannot open " << argv[i] + 1 << endl;
+		exit(EXIT_FAILURE);
+	    }
+
+	    while (getline(list, line))
+		if (!line.empty())
+		    paths.push_back(line);
+	} else
+	    paths.push_back(argv[i]);
+
+    if (query != nullptr && database != nullptr)
+	exit(queryRepository(database, query));
+
+    if (query != nullptr)
+	usage(argv[0]);
+
+    if (database != nullptr)
+	exit(indexRepository(database, paths, workers, options));
+
+    if (link)
+	exit(linkFiles(paths, workers, options));
+
+    if (optind < argc && (counters || allocations))
+	usage(argv[0]);
+
+    if (optind < argc && shards > 0)
+	exit(shard(paths, shards, options));
+
+    if (optind < argc) {
+	if (published != nullptr || report)
+	    measure("file", published, interval);
+
+	exit(batch(paths, workers, window, report, options));
+    }
+
+    if (!readFile(STDIN_FILENO, buf)) {
+	cerr << argv[0] << ": cannot read standard input" << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    prelude = options.prelude;
+
+    if (emit != nullptr) {
+	Output discard;
+	Scope *scope;
+
+	output = &discard;
+	status = translationUnit(buf.data(), buf.size(), &scope);
+
+	if (status != EXIT_SUCCESS || numerrors > 0) {
+	    cerr << argv[0] << ": prelude has errors" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	if (!Prelude::save(scope, emit)) {
+	    cerr << argv[0] << ": cannot write " << emit << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	exit(EXIT_SUCCESS);
+    }
+
+    if (options.cache != nullptr && ast == nullptr && !report && !allocations) {
+	const Result &result = check(buf.data(), buf.size(), options);
+
+	cout << result.symbols << flush;
+	cerr << result.diagnostics;
+
+	if (!cout) {
+	    cerr << argv[0] << ": cannot write standard output" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	exit(result.status);
+    }
+
+    Output symbols(STDOUT_FILENO, options.format);
+    output = &symbols;
+
+    if (ast != nullptr)
+	tree = new Tree();
+
+    if (allocations)
+	memory = new Memory();
+
+    if (report) {
+	stats = new Stats(top);
+
+	if (counters && !stats->count())
+	    cerr << argv[0] << ": hardware counters unavailable, timing only" << endl;
+
+	stats->start();
+    }
+
+    status = translationUnit(buf.data(), buf.size());
+
+    if (!symbols.close()) {
+	cerr << argv[0] << ": cannot write standard output: ";
+	cerr << strerror(symbols.error()) << endl;
+	status = EXIT_FAILURE;
+    }
+
+    if (stats != nullptr) {
+	stats->stop();
+	stats->write(cerr);
+    }
+
+    if (memory != nullptr)
+	memory->write(cerr, lineno);
+
+    if (tree != nullptr && !tree->save(ast, status, numerrors)) {
+	cerr << argv[0] << ": cannot write " << ast << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    exit(status);
+}
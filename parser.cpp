@@ -4,18 +4,43 @@
  * Description:	This file contains the public and private function and
  *		variable definitions for the recursive-descent parser for
  *		Simple C.
+ *
+ *		If a tree is given, each construct is recorded in it as
+ *		soon as it is finished, so that the children of a node are
+ *		always recorded before the node itself.  Parentheses are
+ *		not recorded.
+ *
+ *		If a cross-reference index is given, each declaration and
+ *		use of a symbol is noted in it, at the identifier that
+ *		names it, along with each call.
+ *
+ *		If an incremental engine is given, and no tree or index,
+ *		each global or function that the engine can replay is
+ *		skipped.
  */
 
 # include <cstdlib>
-# include <iostream>
 # include "checker.h"
+# include "parser.h"
 # include "tokens.h"
 # include "lexer.h"
-# include <unistd.h>
+# include "Tree.h"
+# include "Xref.h"
+# include "Incremental.h"
+# include "Memory.h"
+# include "Trace.h"
+# include "Stats.h"
+
 using namespace std;
 
-static int lookahead;
-static string lexbuf;
+struct Abandon {};
+
+thread_local const atomic<bool> *cancelled;
+thread_local Tree *tree;
+thread_local Xref *xref;
+static thread_local int lookahead, idline;
+static thread_local size_t idoffset;
+static thread_local string lexbuf;
 
 static Type expression(bool&);
 static void statement();
@@ -24,7 +49,7 @@ static void statement();
 /*
  * Function:	error
  *
- * Description:	Report a syntax error to standard error.
+ * Description:	Report a syntax error and abandon the translation unit.
  */
 
 static void error()
@@ -34,7 +59,7 @@ static void error()
     else
 	report("syntax error at '%s'", lexbuf);
 
-    exit(EXIT_FAILURE);
+    throw Abandon();
 }
 
 
@@ -43,7 +68,9 @@ static void error()
  *
  * Description:	Match the next token against the specified token.  A
  *		failure indicates a syntax error and will terminate the
- *		program since our parser does not do error recovery.
+ *		translation unit since our parser does not do error
+ *		recovery.  We also give up here if someone has cancelled
+ *		the check.
  */
 
 static void match(int t)
@@ -51,6 +78,9 @@ static void match(int t)
     if (lookahead != t)
 	error();
 
+    if (cancelled != nullptr && *cancelled)
+	throw Abandon();
+
     lookahead = lexan(lexbuf);
 }
 
@@ -76,14 +106,18 @@ static unsigned number()
  * Function:	identifier
  *
  * Description:	Match the next token as an identifier and return its name.
+ *		Its offset and line are kept for the cross-reference index.
  */
 
 static string identifier()
 {
+    Memory::Tag tag(Memory::LEXEMES);
     string buf;
 
 
     buf = lexbuf;
+    idoffset = lexstart();
+    idline = lexline();
     match(ID);
     return buf;
 }
@@ -166,6 +200,7 @@ static unsigned pointers()
 static void declarator(int typespec)
 {
     unsigned indirection;
+    Symbol *symbol;
     string name;
 
 
@@ -174,10 +209,16 @@ static void declarator(int typespec)
 
     if (lookahead == '[') {
 	match('[');
-	declareVariable(name, Type(typespec, indirection, number()));
+	symbol = declareVariable(name, Type(typespec, indirection, number()));
 	match(']');
     } else
-	declareVariable(name, Type(typespec, indirection));
+	symbol = declareVariable(name, Type(typespec, indirection));
+
+    if (tree != nullptr)
+	tree->declaration(symbol);
+
+    if (xref != nullptr)
+	xref->declaration(symbol, idoffset, idline);
 }
 
 
@@ -258,12 +299,18 @@ static Type primaryExpression(bool& lvalue)
 	lvalue = false;
 
     } else if (lookahead == STRING) {
+	if (tree != nullptr)
+	    tree->literal(TREE_STRING, Type(CHAR, 0, 0u), lexbuf);
+
 	match(STRING);
 	unsigned len = 0;
 	expr = Type(CHAR, 0, len);
 	lvalue = false;
 
     } else if (lookahead == NUM) {
+	if (tree != nullptr)
+	    tree->literal(TREE_NUMBER, Type(INT), lexbuf);
+
 	match(NUM);
 	expr = Type(INT);
 	lvalue = false;
@@ -273,6 +320,15 @@ static Type primaryExpression(bool& lvalue)
 	expr = id->type();
 	lvalue = true;
 
+	if (tree != nullptr)
+	    tree->reference(id);
+
+	if (xref != nullptr) {
+	    xref->reference(id, idoffset, idline);
+
+	    if (lookahead == '(')
+		xref->call(id);
+	}
 
 	if (lookahead == '(') {
 	    match('(');
@@ -290,7 +346,12 @@ static Type primaryExpression(bool& lvalue)
 
 	    match(')');
 		Type spec = expr;
-		expr = Type(spec.specifier(), spec.indirection(), &params);
+
+		if (!spec.isError())
+		    expr = Type(spec.specifier(), spec.indirection(), &params);
+
+		if (tree != nullptr)
+		    tree->node(TREE_CALL, params.size() + 1, spec.isError() ? spec : Type(spec.specifier(), spec.indirection()));
 	}
 
     } else{
@@ -321,6 +382,9 @@ static Type postfixExpression(bool& lvalue)
 	match(']');
 	expr = checkPostfix(expr, index_expr);
 	lvalue = true;
+
+	if (tree != nullptr)
+	    tree->node(TREE_INDEX, 2, expr);
     }
 	return expr;
 }
@@ -348,26 +412,41 @@ static Type prefixExpression(bool& lvalue)
 	expr = prefixExpression(lvalue);
 	expr = checkNot(expr, lvalue);
 
+	if (tree != nullptr)
+	    tree->node(TREE_NOT, 1, expr);
+
     } else if (lookahead == '-') {
 	match('-');
 	expr = prefixExpression(lvalue);
 	expr = checkNeg(expr, lvalue);
 
+	if (tree != nullptr)
+	    tree->node(TREE_NEG, 1, expr);
+
     } else if (lookahead == '*') {
 	match('*');
 	expr = prefixExpression(lvalue);
 	expr = checkDeref(expr, lvalue);
 
+	if (tree != nullptr)
+	    tree->node(TREE_DEREF, 1, expr);
+
     } else if (lookahead == '&') {
 	match('&');
 	expr = prefixExpression(lvalue);
 	expr = checkAddr(expr, lvalue);
 
+	if (tree != nullptr)
+	    tree->node(TREE_ADDR, 1, expr);
+
     } else if (lookahead == SIZEOF) {
 	match(SIZEOF);
 	expr = prefixExpression(lvalue);
 	expr = checkSizeof(expr, lvalue);
 
+	if (tree != nullptr)
+	    tree->node(TREE_SIZEOF, 1, expr);
+
     } else{
 	expr = postfixExpression(lvalue);
 	}
@@ -398,21 +477,30 @@ static Type multiplicativeExpression(bool& lvalue)
 	if (lookahead == '*') {
 	    match('*');
 	    Type right = prefixExpression(lvalue);
-		Type left = checkMultiplicative(left, right, "*");
+		left = checkMultiplicative(left, right, "*");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_MUL, 2, left);
+
 	} else if (lookahead == '/') {
 	    match('/');
 	    Type right = prefixExpression(lvalue);
-		Type left = checkMultiplicative(left, right, "/");
+		left = checkMultiplicative(left, right, "/");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_DIV, 2, left);
+
 	} else if (lookahead == '%') {
 	    match('%');
 	    Type right = prefixExpression(lvalue);
-		Type left = checkMultiplicative(left, right, "%");
+		left = checkMultiplicative(left, right, "%");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_REM, 2, left);
+
 	} else
 	    break;
 
@@ -440,15 +528,21 @@ static Type  additiveExpression(bool& lvalue)
 	if (lookahead == '+') {
 	    match('+');
 	    Type right = multiplicativeExpression(lvalue);
-		Type left = checkAdditive(left, right, "+");
+		left = checkAdditive(left, right, "+");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_ADD, 2, left);
+
 	} else if (lookahead == '-') {
 	    match('-');
 	    Type right = multiplicativeExpression(lvalue);
-		Type left = checkAdditive(left, right, "-");
+		left = checkAdditive(left, right, "-");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_SUB, 2, left);
+
 	} else
 	    break;
 
@@ -481,27 +575,39 @@ static Type  relationalExpression(bool& lvalue)
 	if (lookahead == '<') {
 	    match('<');
 	    Type right = additiveExpression(lvalue);
-		Type left = checkRelational(left, right, "<");
+		left = checkRelational(left, right, "<");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_LTN, 2, left);
+
 	} else if (lookahead == '>') {
 	    match('>');
 	    Type right = additiveExpression(lvalue);
-		Type left = checkRelational(left, right, "<");
+		left = checkRelational(left, right, "<");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_GTN, 2, left);
+
 	} else if (lookahead == LEQ) {
 	    match(LEQ);
 	    Type right = additiveExpression(lvalue);
-		Type left = checkRelational(left, right, "<=");
+		left = checkRelational(left, right, "<=");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_LEQ, 2, left);
+
 	} else if (lookahead == GEQ) {
 	    match(GEQ);
 	    Type right = additiveExpression(lvalue);
-	    Type left = checkRelational(left, right, ">=");
+	    left = checkRelational(left, right, ">=");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_GEQ, 2, left);
+
 	} else
 	    break;
 
@@ -531,12 +637,18 @@ static Type equalityExpression(bool &lvalue)
 	    Type right = relationalExpression(lvalue);
 		left = checkEquality(left, right, "==");
 		lvalue = false;
+
+		if (tree != nullptr)
+		    tree->node(TREE_EQL, 2, left);
 	} else if (lookahead == NEQ) {
 	    match(NEQ);
 	    Type right = relationalExpression(lvalue);
 	    left = checkEquality(left, right, "!=");
 		lvalue = false;
 
+		if (tree != nullptr)
+		    tree->node(TREE_NEQ, 2, left);
+
 	} else
 	    break;
 		
@@ -566,6 +678,9 @@ static Type logicalAndExpression(bool &lvalue)
 		Type right = equalityExpression(lvalue);	
 		left = checkLogical(left, right, "&&");
 		lvalue = false;
+
+		if (tree != nullptr)
+		    tree->node(TREE_AND, 2, left);
     }
 	return left;
 }
@@ -592,6 +707,9 @@ static Type expression(bool& lvalue)
 		Type right = logicalAndExpression(lvalue);
 		left = checkLogical(left, right, "||");
 		lvalue = false;
+
+		if (tree != nullptr)
+		    tree->node(TREE_OR, 2, left);
     }
 	return left;
 }
@@ -634,6 +752,9 @@ static void assignment(bool& lvalue)
     if (lookahead == '=') {
 	match('=');
 	expression(lvalue);
+
+	if (tree != nullptr)
+	    tree->node(TREE_ASSIGN, 2);
     }
 }
 
@@ -657,13 +778,19 @@ static void assignment(bool& lvalue)
 static void statement()
 {
 	bool lvalue = false;
+	unsigned mark;
 
     if (lookahead == '{') {
 		match('{');
+		mark = tree != nullptr ? tree->pending() : 0;
 		openScope();
 		declarations();
 		statements();
 		closeScope();
+
+		if (tree != nullptr)
+		    tree->node(TREE_BLOCK, tree->pending() - mark);
+
 		match('}');
 
     } else if (lookahead == RETURN) {
@@ -671,6 +798,9 @@ static void statement()
 		expression(lvalue);
 		match(';');
 
+		if (tree != nullptr)
+		    tree->node(TREE_RETURN, 1);
+
     } else if (lookahead == WHILE) {
 		match(WHILE);
 		match('(');
@@ -678,6 +808,9 @@ static void statement()
 		match(')');
 		statement();
 
+		if (tree != nullptr)
+		    tree->node(TREE_WHILE, 2);
+
     } else if (lookahead == FOR) {
 		match(FOR);
 		match('(');
@@ -689,6 +822,9 @@ static void statement()
 		match(')');
 		statement();
 
+		if (tree != nullptr)
+		    tree->node(TREE_FOR, 4);
+
     } else if (lookahead == IF) {
 		match(IF);
 		match('(');
@@ -699,7 +835,12 @@ static void statement()
 	if (lookahead == ELSE) {
 		match(ELSE);
 	    statement();
-	}
+
+		if (tree != nullptr)
+		    tree->node(TREE_IF, 3);
+
+	} else if (tree != nullptr)
+	    tree->node(TREE_IF, 2);
 
     } else {
 		assignment(lvalue);
@@ -722,6 +863,7 @@ static Type parameter()
 {
     int typespec;
     unsigned indirection;
+    Symbol *symbol;
     string name;
     Type type;
 
@@ -731,7 +873,14 @@ static Type parameter()
     name = identifier();
 
     type = Type(typespec, indirection);
-    declareVariable(name, type);
+    symbol = declareVariable(name, type);
+
+    if (tree != nullptr)
+	tree->declaration(symbol);
+
+    if (xref != nullptr)
+	xref->declaration(symbol, idoffset, idline);
+
     return type;
 }
 
@@ -755,9 +904,11 @@ static Type parameter()
 
 static Parameters *parameters()
 {
+    Memory::Tag tag(Memory::PARAMETERS);
     int typespec;
     unsigned indirection;
     Parameters *params;
+    Symbol *symbol;
     string name;
     Type type;
 
@@ -778,9 +929,15 @@ static Parameters *parameters()
     name = identifier();
 
     type = Type(typespec, indirection);
-    declareVariable(name, type);
+    symbol = declareVariable(name, type);
     params->push_back(type);
 
+    if (tree != nullptr)
+	tree->declaration(symbol);
+
+    if (xref != nullptr)
+	xref->declaration(symbol, idoffset, idline);
+
     while (lookahead == ',') {
 	match(',');
 	params->push_back(parameter());
@@ -806,6 +963,7 @@ static Parameters *parameters()
 static void globalDeclarator(int typespec)
 {
     unsigned indirection;
+    Symbol *symbol;
     string name;
 
 
@@ -814,16 +972,22 @@ static void globalDeclarator(int typespec)
 
     if (lookahead == '(') {
 	match('(');
-	declareFunction(name, Type(typespec, indirection, nullptr));
+	symbol = declareFunction(name, Type(typespec, indirection, nullptr));
 	match(')');
 
     } else if (lookahead == '[') {
 	match('[');
-	declareVariable(name, Type(typespec, indirection, number()));
+	symbol = declareVariable(name, Type(typespec, indirection, number()));
 	match(']');
 
     } else
-	declareVariable(name, Type(typespec, indirection));
+	symbol = declareVariable(name, Type(typespec, indirection));
+
+    if (tree != nullptr)
+	tree->declaration(symbol);
+
+    if (xref != nullptr)
+	xref->declaration(symbol, idoffset, idline);
 }
 
 
@@ -862,62 +1026,261 @@ static void remainingDeclarators(int typespec)
 
 static void globalOrFunction()
 {
-    int typespec;
-    unsigned indirection;
+    Trace::Span span("declaration");
+    int typespec, line;
+    unsigned indirection, mark, body;
+    size_t offset;
+    Symbol *symbol;
     string name;
 
 
+    if (stats != nullptr)
+	stats->begin();
+
     typespec = specifier();
     indirection = pointers();
     name = identifier();
+    span.name(name);
+    span.arg("line", idline);
+
+    if (stats != nullptr)
+	stats->declare(name, idline);
 
     if (lookahead == '[') {
 	match('[');
-	declareVariable(name, Type(typespec, indirection, number()));
+	symbol = declareVariable(name, Type(typespec, indirection, number()));
 	match(']');
+
+	if (tree != nullptr)
+	    tree->declaration(symbol);
+
+	if (xref != nullptr)
+	    xref->declaration(symbol, idoffset, idline);
+
 	remainingDeclarators(typespec);
 
     } else if (lookahead == '(') {
 	match('(');
 
 	if (lookahead == ')') {
-	    declareFunction(name, Type(typespec, indirection, nullptr));
+	    symbol = declareFunction(name, Type(typespec, indirection, nullptr));
 	    match(')');
+
+	    if (tree != nullptr)
+		tree->declaration(symbol);
+
+	    if (xref != nullptr)
+		xref->declaration(symbol, idoffset, idline);
+
 	    remainingDeclarators(typespec);
 
 	} else {
+	    Trace::Span check("function");
+	    check.name(name);
+
+	    mark = tree != nullptr ? tree->pending() : 0;
+	    offset = idoffset;
+	    line = idline;
 	    openScope();
-	    defineFunction(name, Type(typespec, indirection, parameters()));
+
+	    if (xref != nullptr)
+		xref->enter();
+
+	    symbol = defineFunction(name, Type(typespec, indirection, parameters()));
+
+	    if (xref != nullptr)
+		xref->function(symbol, offset, line);
+
 	    match(')');
 	    match('{');
+	    body = tree != nullptr ? tree->pending() : 0;
 	    declarations();
 	    statements();
 	    closeScope();
+
+	    if (tree != nullptr) {
+		tree->node(TREE_BLOCK, tree->pending() - body);
+		tree->function(symbol, tree->pending() - mark);
+	    }
+
+	    if (xref != nullptr)
+		xref->leave();
+
 	    match('}');
 	}
 
     } else {
-	declareVariable(name, Type(typespec, indirection));
+	symbol = declareVariable(name, Type(typespec, indirection));
+
+	if (tree != nullptr)
+	    tree->declaration(symbol);
+
+	if (xref != nullptr)
+	    xref->declaration(symbol, idoffset, idline);
+
 	remainingDeclarators(typespec);
     }
+
+    if (stats != nullptr)
+	stats->end();
+}
+
+
+/*
+ * Function:	unit
+ *
+ * Description:	Replay the next global or function from the incremental
+ *		engine if it can be, and otherwise parse it, recording it
+ *		for next time.
+ */
+
+static void unit(Scope *outermost)
+{
+    size_t start = lexstart();
+
+
+    if (incremental->replay(start, lineno, outermost, lookahead, lexbuf))
+	return;
+
+    incremental->enter(start, lineno);
+    globalOrFunction();
+    incremental->leave(outermost, lookahead, lexbuf);
+}
+
+
+/*
+ * Function:	translationUnit
+ *
+ * Description:	Parse and check the translation unit in the given buffer.
+ *		Symbols are written to the current output and errors to the
+ *		current diagnostics stream.  Since our parser does not do
+ *		error recovery, a syntax error abandons the remainder of
+ *		the translation unit, as does cancelling the check.  Return
+ *		the exit status of the unit, and the outermost scope if
+ *		requested, which then belongs to the caller.  All other
+ *		scopes and their symbols are deleted once the unit is
+ *		finished.
+ *
+ *		translation-unit:
+ *		  empty
+ *		  global-or-function translation-unit
+ */
+
+int translationUnit(const char *buf, size_t length, Scope **scope)
+{
+    Scope *outermost;
+    bool replaying;
+
+
+    lexinit(buf, length);
+    outermost = openScope();
+    replaying = tree == nullptr && xref == nullptr && incremental != nullptr;
+
+    if (tree != nullptr)
+	tree->clear();
+
+    if (xref != nullptr)
+	xref->clear();
+
+    if (replaying)
+	incremental->begin(buf, length);
+
+    try {
+	lookahead = lexan(lexbuf);
+
+	while (lookahead != DONE)
+	    if (replaying)
+		unit(outermost);
+	    else
+		globalOrFunction();
+
+    } catch (const Abandon &) {
+	if (stats != nullptr)
+	    stats->end();
+
+	if (replaying)
+	    incremental->abandon(outermost);
+
+	while ((outermost = closeScope())->enclosing() != nullptr)
+	    continue;
+
+	if (tree != nullptr)
+	    tree->finish();
+
+	if (xref != nullptr)
+	    xref->finish();
+
+	releaseScopes();
+
+	if (scope != nullptr)
+	    *scope = outermost;
+	else
+	    deleteScope(outermost);
+
+	return EXIT_FAILURE;
+    }
+
+    outermost = closeScope();
+
+    if (tree != nullptr)
+	tree->finish();
+
+    if (xref != nullptr)
+	xref->finish();
+
+    releaseScopes();
+
+    if (scope != nullptr)
+	*scope = outermost;
+    else
+	deleteScope(outermost);
+
+    return EXIT_SUCCESS;
 }
 
 
 /*
- * Function:	main
+ * Function:	globals
  *
- * Description:	Analyze the standard input stream.
+ * Description:	Parse and check the globals and functions in the given
+ *		buffer, which starts on the given line, in the given
+ *		outermost scope, until the next one would start at or after
+ *		the given offset.  Each is recorded by, or replayed from,
+ *		the current incremental engine, which must be given.
+ *		Return the exit status, and the offset at which the next
+ *		global or function starts, which is the length of the
+ *		buffer if there is none.
  */
 
-int main()
+int globals(const char *buf, size_t length, int line, Scope *scope, size_t stop, size_t &next)
 {
-	sleep(10);
+    lexinit(buf, length, line);
+    initial = scope;
     openScope();
-    lookahead = lexan(lexbuf);
+    incremental->begin(buf, length);
+
+    try {
+	lookahead = lexan(lexbuf);
+
+	while (lookahead != DONE && lexstart() < stop)
+	    unit(scope);
+
+    } catch (const Abandon &) {
+	if (stats != nullptr)
+	    stats->end();
 
-    while (lookahead != DONE)
-	globalOrFunction();
+	incremental->abandon(scope);
+
+	while (closeScope()->enclosing() != nullptr)
+	    continue;
+
+	releaseScopes();
+	next = length;
+	return EXIT_FAILURE;
+    }
 
     closeScope();
-    exit(EXIT_SUCCESS);
+    releaseScopes();
+    next = lookahead == DONE ? length : lexstart();
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,24 @@
+/*
+ * File:	parser.h
+ *
+ * Description:	This file contains the public function declarations for the
+ *		recursive-descent parser for Simple C.
+ */
+
+# ifndef PARSER_H
+# define PARSER_H
+# include <atomic>
+# include <cstddef>
+
+class Scope;
+class Tree;
+class Xref;
+
+extern thread_local const std::atomic<bool> *cancelled;
+extern thread_local Tree *tree;
+extern thread_local Xref *xref;
+
+int translationUnit(const char *buf, size_t length, Scope **scope = nullptr);
+int globals(const char *buf, size_t length, int line, Scope *scope, size_t stop, size_t &next);
+
+# endif /* PARSER_H */
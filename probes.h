@@ -0,0 +1,77 @@
+/*
+ * File:	probes.h
+ *
+ * Description:	This file contains the macro definitions for the static
+ *		tracepoints of Simple C, in the format of the sys/sdt.h
+ *		header of SystemTap, which bpftrace, perf, and SystemTap
+ *		all understand, but without needing that header.
+ *
+ *		A probe is a single nop instruction, and a note in a
+ *		section of its own, which is never loaded, giving the
+ *		address of the nop, the provider and name of the probe,
+ *		and where to find each of its arguments once the nop is
+ *		reached.  A tracer that attaches replaces the nop with a
+ *		breakpoint; until then a probe costs a nop and the moves
+ *		of its arguments into place.  Every argument is passed as
+ *		a signed 64-bit value, so strings are passed as pointers,
+ *		for str() in bpftrace to read.  The provider is "scc":
+ *
+ *		  bpftrace -e 'usdt:./scc:scc:token { @[arg0] = count(); }'
+ *
+ *		On machines other than x86-64 and AArch64, where we have
+ *		not checked the format of the operands, or if NO_PROBES is
+ *		defined, the probes are defined as nothing at all.
+ */
+
+# ifndef PROBES_H
+# define PROBES_H
+
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__)) && !defined(NO_PROBES)
+
+# define PROBE_NOTE(name, args) \
+    "990:	nop\n" \
+    "	.pushsection .note.stapsdt, \"?\", \"note\"\n" \
+    "	.balign 4\n" \
+    "	.4byte 992f - 991f, 994f - 993f, 3\n" \
+    "991:	.asciz \"stapsdt\"\n" \
+    "992:	.balign 4\n" \
+    "993:	.8byte 990b\n" \
+    "	.8byte _.stapsdt.base\n" \
+    "	.8byte 0\n" \
+    "	.asciz \"scc\"\n" \
+    "	.asciz \"" #name "\"\n" \
+    "	.asciz \"" args "\"\n" \
+    "994:	.balign 4\n" \
+    "	.popsection\n" \
+    "	.ifndef _.stapsdt.base\n" \
+    "	.pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n" \
+    "	.weak _.stapsdt.base\n" \
+    "	.hidden _.stapsdt.base\n" \
+    "_.stapsdt.base:\n" \
+    "	.space 1\n" \
+    "	.size _.stapsdt.base, 1\n" \
+    "	.popsection\n" \
+    "	.endif\n"
+
+# define PROBE_ARG(a) "nor" ((long) (a))
+
+# define PROBE1(name, a) \
+    __asm__ __volatile__ (PROBE_NOTE(name, "-8@%0") :: PROBE_ARG(a))
+
+# define PROBE2(name, a, b) \
+    __asm__ __volatile__ (PROBE_NOTE(name, "-8@%0 -8@%1") \
+	:: PROBE_ARG(a), PROBE_ARG(b))
+
+# define PROBE3(name, a, b, c) \
+    __asm__ __volatile__ (PROBE_NOTE(name, "-8@%0 -8@%1 -8@%2") \
+	:: PROBE_ARG(a), PROBE_ARG(b), PROBE_ARG(c))
+
+# else
+
+# define PROBE1(name, a)
+# define PROBE2(name, a, b)
+# define PROBE3(name, a, b, c)
+
+# endif
+
+# endif /* PROBES_H */
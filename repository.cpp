@@ -0,0 +1,128 @@
+/*
+ * File:	repository.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for indexing and querying the symbols
+ *		of a whole repository with a symbol database.
+ *
+ *		Indexing checks the given files with a pool of worker
+ *		threads, each taking the next file in turn, and replaces
+ *		the shards of those that changed.  A file that cannot be
+ *		read is removed from the database.  The index is rebuilt
+ *		once there is none yet or the journal has grown long
+ *		enough that queries would spend more time in the shards of
+ *		journaled files than a merge would take.
+ */
+
+# include <mutex>
+# include <atomic>
+# include <thread>
+# include <cstdlib>
+# include <iostream>
+# include <fcntl.h>
+# include <unistd.h>
+# include "repository.h"
+# include "Database.h"
+# include "batch.h"
+
+using namespace std;
+
+static const size_t MERGE_THRESHOLD = 256;
+
+
+/*
+ * Function:	worker
+ *
+ * Description:	Update the database with each file not yet taken.
+ */
+
+static void worker(Database &database, const vector<string> &paths, atomic<size_t> &next, atomic<int> &status)
+{
+    string buf;
+    size_t i;
+    int fd;
+
+
+    while ((i = next ++) < paths.size()) {
+	if ((fd = open(paths[i].c_str(), O_RDONLY)) < 0 || !readFile(fd, buf)) {
+	    cerr << paths[i] << ": cannot read file" << endl;
+	    database.remove(paths[i]);
+	    status = EXIT_FAILURE;
+
+	    if (fd >= 0)
+		close(fd);
+
+	    continue;
+	}
+
+	close(fd);
+
+	if (!database.update(paths[i], buf.data(), buf.size())) {
+	    cerr << paths[i] << ": cannot write shard" << endl;
+	    status = EXIT_FAILURE;
+	}
+    }
+}
+
+
+/*
+ * Function:	indexRepository
+ *
+ * Description:	Bring the database in the given directory up to date with
+ *		the given files, using the given number of workers, and
+ *		merge it if necessary.  Return the exit status.
+ */
+
+int indexRepository(const string &directory, const vector<string> &paths, unsigned workers, const Options &options)
+{
+    Database database(directory, options);
+    vector<thread> threads;
+    atomic<size_t> next(0);
+    atomic<int> status(EXIT_SUCCESS);
+
+
+    if (workers == 0)
+	workers = 1;
+
+    for (unsigned i = 0; i < workers && i < paths.size(); i ++)
+	threads.emplace_back(worker, ref(database), cref(paths), ref(next), ref(status));
+
+    for (auto &t : threads)
+	t.join();
+
+    if (database.generation() == 0 || database.pending() >= MERGE_THRESHOLD)
+	if (!database.merge()) {
+	    cerr << directory << ": cannot write index" << endl;
+	    status = EXIT_FAILURE;
+	}
+
+    return status;
+}
+
+
+/*
+ * Function:	queryRepository
+ *
+ * Description:	Write the definitions and references of every global with
+ *		the given name in the database in the given directory.
+ *		Return the exit status, which is a failure if there are
+ *		none.
+ */
+
+int queryRepository(const string &directory, const string &name)
+{
+    Database database(directory);
+    vector<Database::Hit> hits;
+
+
+    hits = database.lookup(name);
+
+    for (auto &hit : hits) {
+	cout << hit.path << ":" << hit.line << ": " << name << ": " << hit.type << endl;
+
+	for (auto line : hit.references)
+	    cout << hit.path << ":" << line << endl;
+    }
+
+    return hits.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+/*
+ * File:	repository.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		indexing and querying the symbols of a whole repository.
+ */
+
+# ifndef REPOSITORY_H
+# define REPOSITORY_H
+# include <string>
+# include <vector>
+# include "scc.h"
+
+int indexRepository(const std::string &directory, const std::vector<std::string> &paths, unsigned workers, const Options &options);
+int queryRepository(const std::string &directory, const std::string &name);
+
+# endif /* REPOSITORY_H */
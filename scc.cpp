@@ -0,0 +1,223 @@
+/*
+ * File:	scc.cpp
+ *
+ * Description:	This file contains the public function definitions for the
+ *		Simple C front end as a library.
+ */
+
+# include <cstring>
+# include <sstream>
+# include <algorithm>
+# include "Cache.h"
+# include "Scope.h"
+# include "Xref.h"
+# include "checker.h"
+# include "parser.h"
+# include "lexer.h"
+# include "scc.h"
+
+using namespace std;
+
+
+/*
+ * Function:	Context::Context (constructor)
+ *
+ * Description:	Initialize this context with the given options.
+ */
+
+Context::Context(const Options &options)
+    : _options(options)
+{
+}
+
+
+/*
+ * Function:	Context::check
+ *
+ * Description:	Check the translation unit in the given buffer and return
+ *		the result, which remains valid until the next check using
+ *		this context.  The output, diagnostics, prelude,
+ *		incremental engine, and cross-reference index of the
+ *		calling thread are restored afterward.  A cancelled check
+ *		is never stored in the cache, since its result is
+ *		incomplete.
+ */
+
+const Result &Context::check(const char *buf, size_t length)
+{
+    Output *oldOutput = output;
+    ostream *oldDiagnostics = diagnostics;
+    const atomic<bool> *oldCancelled = cancelled;
+    const Prelude *oldPrelude = prelude;
+    Incremental *oldIncremental = incremental;
+    Xref *oldXref = xref;
+    Output sink(-1, _options.format);
+    ostringstream stream;
+    uint64_t key = 0;
+
+
+    if (_options.cache != nullptr) {
+	key = _options.cache->key(buf, length, _options);
+
+	if (_options.xref == nullptr && _options.cache->find(key, length, _result))
+	    return _result;
+    }
+
+    output = &sink;
+    diagnostics = &stream;
+    cancelled = _options.cancelled;
+    prelude = _options.prelude;
+    incremental = _options.incremental;
+    xref = _options.xref;
+
+    _result.status = translationUnit(buf, length);
+    _result.errors = numerrors;
+
+    sink.close();
+    _result.symbols.assign(sink.contents());
+    _result.diagnostics.assign(stream.str());
+
+    output = oldOutput;
+    diagnostics = oldDiagnostics;
+    cancelled = oldCancelled;
+    prelude = oldPrelude;
+    incremental = oldIncremental;
+    xref = oldXref;
+
+    if (_options.cache != nullptr && !(_options.cancelled && *_options.cancelled))
+	_options.cache->insert(key, length, _result);
+
+    return _result;
+}
+
+
+/*
+ * Function:	Context::options (accessor)
+ *
+ * Description:	Return the options of this context.
+ */
+
+const Options &Context::options() const
+{
+    return _options;
+}
+
+
+/*
+ * Function:	check
+ *
+ * Description:	Check the translation unit in the given buffer using the
+ *		given options and return the result.
+ */
+
+Result check(const char *buf, size_t length, const Options &options)
+{
+    Context context(options);
+    return context.check(buf, length);
+}
+
+
+/*
+ * Function:	signature
+ *
+ * Description:	Return the text of the given type, including the types of
+ *		the parameters of a function if they are specified.  The
+ *		given stream is used as scratch space.
+ */
+
+static string signature(const Type &type, ostringstream &text)
+{
+    Parameters *params;
+
+
+    text.str("");
+    text << type;
+
+    if (type.isFunction() && (params = type.parameters()) != nullptr) {
+	text.seekp(-1, ios_base::cur);
+
+	if (params->empty())
+	    text << "void";
+
+	for (size_t i = 0; i < params->size(); i ++)
+	    text << (i > 0 ? ", " : "") << (*params)[i];
+
+	text << ")";
+    }
+
+    return text.str();
+}
+
+
+/*
+ * Function:	summarize
+ *
+ * Description:	Check the translation unit in the given buffer using the
+ *		given options, and fill in the given list with its globals
+ *		in order by name.  Return the exit status.  Symbols from a
+ *		prelude are never declared by the translation unit itself,
+ *		and so are left out.  The state of the calling thread is
+ *		restored afterward, as for a check.
+ */
+
+int summarize(const char *buf, size_t length, const Options &options, vector<Global> &globals)
+{
+    Output *oldOutput = output;
+    ostream *oldDiagnostics = diagnostics;
+    const atomic<bool> *oldCancelled = cancelled;
+    const Prelude *oldPrelude = prelude;
+    Incremental *oldIncremental = incremental;
+    Xref *oldXref = xref;
+    Tree *oldTree = tree;
+    Output sink;
+    ostringstream stream, text;
+    vector<uint32_t> ids;
+    Symbol *symbol;
+    Scope *scope;
+    Xref index;
+    int status;
+
+
+    output = &sink;
+    diagnostics = &stream;
+    cancelled = options.cancelled;
+    prelude = options.prelude;
+    incremental = nullptr;
+    xref = &index;
+    tree = nullptr;
+
+    status = translationUnit(buf, length, &scope);
+
+    output = oldOutput;
+    diagnostics = oldDiagnostics;
+    cancelled = oldCancelled;
+    prelude = oldPrelude;
+    incremental = oldIncremental;
+    xref = oldXref;
+    tree = oldTree;
+
+    ids = index.globals();
+    sort(ids.begin(), ids.end(), [&index](uint32_t a, uint32_t b) {
+	return strcmp(index.name(a), index.name(b)) < 0;
+    });
+
+    globals.clear();
+    globals.reserve(ids.size());
+
+    for (auto id : ids) {
+	if ((symbol = scope->find(index.name(id))) == nullptr)
+	    continue;
+
+	globals.emplace_back();
+	Global &global = globals.back();
+	global.name = index.name(id);
+	global.type = signature(symbol->type(), text);
+	global.line = index.definition(id).line;
+
+	for (auto &location : index.references(id))
+	    global.references.push_back(location.line);
+    }
+
+    deleteScope(scope);
+    return status;
+}
@@ -0,0 +1,88 @@
+/*
+ * File:	scc.h
+ *
+ * Description:	This file contains the public interface to the Simple C
+ *		front end as a library.  A translation unit in memory is
+ *		checked by calling check(), which returns the symbols and
+ *		errors rather than writing them anywhere, and which never
+ *		terminates the program.
+ *
+ *		All of the state of the lexer, parser, and checker belongs
+ *		to the calling thread, so check() may be called any number
+ *		of times, and from any number of threads at once.  A
+ *		context keeps the options and the buffers for a series of
+ *		checks, so that repeated checks on one thread reuse their
+ *		memory.  A context itself must not be shared by threads.
+ *
+ *		If the options name a cache, results are looked up there
+ *		first and stored there afterward, so that unchanged input
+ *		is never checked twice.  If the options name a prelude, each
+ *		translation unit starts with its declarations.  If they
+ *		name an incremental engine, the globals and functions that
+ *		are unchanged since its last check are not checked again.
+ *		An engine, like a context, belongs to one thread at a time.
+ *		If they name a cross-reference index, it is filled in for
+ *		each translation unit checked, which is then never looked
+ *		up in the cache or replayed by an engine.  The version of
+ *		the checker is part of every cache key.  It must be bumped
+ *		whenever the symbols or diagnostics written for any
+ *		translation unit change, so that a cache never replays the
+ *		result of an older checker.
+ *
+ *		A translation unit may also be summarized, which gives the
+ *		globals it declares with their final types and the lines
+ *		of their definitions and references.  The type of a
+ *		function includes its parameters, if they are specified.
+ */
+
+# ifndef SCC_H
+# define SCC_H
+# include <atomic>
+# include <string>
+# include <vector>
+# include <cstddef>
+# include "Output.h"
+
+# define SCC_VERSION "1.1"	/* bumped whenever any output changes */
+
+class Cache;
+class Prelude;
+class Incremental;
+class Xref;
+
+struct Options {
+    Output::Format format = Output::TEXT;
+    const std::atomic<bool> *cancelled = nullptr;
+    Cache *cache = nullptr;
+    const Prelude *prelude = nullptr;
+    Incremental *incremental = nullptr;
+    Xref *xref = nullptr;
+};
+
+struct Result {
+    int status = 0;
+    unsigned errors = 0;
+    std::string symbols, diagnostics;
+};
+
+struct Global {
+    std::string name, type;
+    unsigned line;
+    std::vector<unsigned> references;
+};
+
+class Context {
+    Options _options;
+    Result _result;
+
+public:
+    Context(const Options &options = Options());
+
+    const Result &check(const char *buf, size_t length);
+    const Options &options() const;
+};
+
+Result check(const char *buf, size_t length, const Options &options = Options());
+int summarize(const char *buf, size_t length, const Options &options, std::vector<Global> &globals);
+
+# endif /* SCC_H */
@@ -0,0 +1,714 @@
+/*
+ * File:	server.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for running the checker as a server.
+ *		The server talks to a single client over the standard input
+ *		and output, or to any number of clients over a Unix domain
+ *		socket.  Requests are lines of text:
+ *
+ *		  check path		check the named file
+ *		  buffer name length	check the LENGTH bytes that follow
+ *		  edit name offset removed length
+ *					replace REMOVED bytes at OFFSET of
+ *					the text last checked under NAME
+ *					with the LENGTH bytes that follow,
+ *					and check it
+ *		  watch path		check the file now and whenever it
+ *					changes
+ *		  unwatch path		stop watching the file
+ *		  quit			stop the server
+ *
+ *		The answer to a check is a header line followed by the
+ *		symbols and then the errors:
+ *
+ *		  result name status symbols-length errors-length
+ *
+ *		Checks are queued for a fixed pool of worker threads, each
+ *		of which keeps its lexer, parser, and checker state warm
+ *		from one check to the next.  A newer request for the same
+ *		name cancels any check still queued or in flight for that
+ *		name, which is answered with "cancelled name" instead, so
+ *		the answers keep up with the latest edit.  A cancelled
+ *		check that has not started is never started at all.
+ *		Problems with a request are answered with "error message".
+ *
+ *		Each name also keeps an incremental engine, so that after
+ *		an edit only the globals and functions that changed, or
+ *		that depend on ones that did, are checked again.  Checks
+ *		of the same name take turns with its engine.  Only the
+ *		engines of the names checked most recently are kept, so
+ *		that a server seeing many names does not grow without
+ *		bound.  An edit is passed on to the engine, which then
+ *		reads only the text near it rather than the whole text.
+ *
+ *		A client whose input ends is still sent the answers to the
+ *		requests it has made, and only then closed.  Its watches
+ *		are removed as soon as its input ends.
+ *
+ *		The keyword table and other static state are built once
+ *		and stay warm for the life of the server.
+ *
+ *		If metrics are kept, the latency of each request is
+ *		measured from when it is started to when it is answered,
+ *		and its queue wait until it has its turn with the engine
+ *		for its name.
+ */
+
+# include <map>
+# include <deque>
+# include <memory>
+# include <atomic>
+# include <thread>
+# include <cerrno>
+# include <csignal>
+# include <cstdlib>
+# include <cstring>
+# include <sstream>
+# include <iostream>
+# include <condition_variable>
+# include <poll.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/un.h>
+# include <sys/socket.h>
+# include <sys/inotify.h>
+# include "server.h"
+# include "batch.h"
+# include "scc.h"
+# include "Sessions.h"
+# include "Metrics.h"
+
+using namespace std;
+
+static const unsigned WATCH_EVENTS =
+    IN_CLOSE_WRITE | IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF;
+
+static const size_t SESSIONS = 256;
+static const size_t EDITS = 64;
+
+struct Client {
+    int in, out;
+    string input;
+    bool closed, ended;
+    unsigned pending;
+};
+
+struct Check {
+    atomic<bool> cancelled;
+    double asked;
+};
+
+struct Watch {
+    string path;
+    shared_ptr<Client> client;
+};
+
+struct Task {
+    shared_ptr<Client> client;
+    shared_ptr<Check> state;
+    shared_ptr<Sessions::Session> session;
+    string name, buf;
+};
+
+struct Server {
+    Options options;
+    int inotify, listener;
+    bool stopping;
+
+    vector<shared_ptr<Client>> clients;
+    map<string, shared_ptr<Check>> checks;
+    Sessions sessions {SESSIONS};
+    map<int, Watch> watches;
+
+    deque<Task> queue;
+    vector<thread> workers;
+
+    mutex lock;
+    condition_variable work;
+    bool draining;
+};
+
+
+/*
+ * Function:	send
+ *
+ * Description:	Write the given data to a client, unless it has gone away.
+ *		The server lock must be held.
+ */
+
+static void send(Client &client, const string &data)
+{
+    const char *p = data.data();
+    size_t left = data.size();
+    ssize_t n;
+
+
+    while (!client.closed && left > 0) {
+	n = write(client.out, p, left);
+
+	if (n < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    client.closed = true;
+	else {
+	    p += n;
+	    left -= n;
+	}
+    }
+}
+
+
+/*
+ * Function:	finish
+ *
+ * Description:	Close a client whose input has ended, once it has been sent
+ *		the answers to all of its requests.  The server lock must
+ *		be held.
+ */
+
+static void finish(Client &client)
+{
+    if (!client.ended || client.pending > 0)
+	return;
+
+    client.closed = true;
+
+    if (client.in != STDIN_FILENO)
+	close(client.in);
+}
+
+
+/*
+ * Function:	note
+ *
+ * Description:	Tell the engine of a session how its text has changed since
+ *		its last check.  The server lock and that of the session
+ *		must be held.
+ */
+
+static void note(Sessions::Session &session)
+{
+    if (session.replaced)
+	session.engine.replace();
+
+    for (auto &e : session.edits)
+	session.engine.edit(e.offset, e.removed, e.inserted);
+
+    session.edits.clear();
+    session.replaced = false;
+}
+
+
+/*
+ * Function:	run
+ *
+ * Description:	Check the buffer of the given task on behalf of its client
+ *		and send it the result, unless the check was cancelled in
+ *		the meantime, in which case it may never be started.  The
+ *		changes to the text of its session are noted only if the
+ *		check is to start, since a later one would include more.
+ */
+
+static void run(Server &s, Task &task)
+{
+    ostringstream header;
+    Options options = s.options;
+    Check &state = *task.state;
+    Result result;
+    double started;
+
+
+    options.cancelled = &state.cancelled;
+    options.incremental = &task.session->engine;
+
+    {
+	lock_guard<mutex> turn(task.session->lock);
+
+	{
+	    lock_guard<mutex> guard(s.lock);
+
+	    if (!state.cancelled)
+		note(*task.session);
+	}
+
+	started = Metrics::now();
+
+	if (!state.cancelled)
+	    result = check(task.buf.data(), task.buf.size(), options);
+    }
+
+    lock_guard<mutex> guard(s.lock);
+
+    if (state.cancelled)
+	send(*task.client, "cancelled " + task.name + "\n");
+    else {
+	header << "result " << task.name << " " << result.status << " ";
+	header << result.symbols.size() << " ";
+	header << result.diagnostics.size() << "\n";
+	send(*task.client, header.str() + result.symbols + result.diagnostics);
+    }
+
+    if (metrics != nullptr)
+	metrics->record(state.asked, started, task.buf.size(),
+	    state.cancelled || result.status != EXIT_SUCCESS);
+
+    if (s.checks[task.name] == task.state)
+	s.checks.erase(task.name);
+
+    task.client->pending --;
+    finish(*task.client);
+}
+
+
+/*
+ * Function:	worker
+ *
+ * Description:	Run the queued tasks one at a time until the server is
+ *		drained and there are none left.
+ */
+
+static void worker(Server &s)
+{
+    unique_lock<mutex> lock(s.lock);
+    Task task;
+
+
+    while (1) {
+	while (s.queue.empty() && !s.draining)
+	    s.work.wait(lock);
+
+	if (s.queue.empty())
+	    break;
+
+	task = move(s.queue.front());
+	s.queue.pop_front();
+
+	lock.unlock();
+	run(s, task);
+	task = Task();
+	lock.lock();
+    }
+}
+
+
+/*
+ * Function:	enqueue
+ *
+ * Description:	Queue a check of the given buffer under the given name in
+ *		the given session, cancelling any check already queued or
+ *		in flight for that name.  The server lock must be held.
+ */
+
+static void enqueue(Server &s, shared_ptr<Client> client, const string &name,
+	shared_ptr<Sessions::Session> session, string buf)
+{
+    shared_ptr<Check> state = make_shared<Check>();
+    shared_ptr<Check> &previous = s.checks[name];
+
+
+    if (previous)
+	previous->cancelled = true;
+
+    state->cancelled = false;
+    state->asked = Metrics::now();
+    previous = state;
+    client->pending ++;
+
+    s.queue.push_back(Task {client, state, session, name, move(buf)});
+    s.work.notify_one();
+}
+
+
+/*
+ * Function:	start
+ *
+ * Description:	Queue a check of the given buffer under the given name,
+ *		which becomes the text of its session.
+ */
+
+static void start(Server &s, shared_ptr<Client> client, const string &name, string &buf)
+{
+    lock_guard<mutex> guard(s.lock);
+    shared_ptr<Sessions::Session> session = s.sessions.find(name);
+
+
+    session->text = buf;
+    session->edits.clear();
+    session->replaced = true;
+    enqueue(s, client, name, session, move(buf));
+}
+
+
+/*
+ * Function:	change
+ *
+ * Description:	Replace the given number of bytes at the given offset of
+ *		the text of the session of the given name with the given
+ *		text, and queue a check of the result.  Too many edits in
+ *		a row without a check are noted as a replacement instead.
+ */
+
+static void change(Server &s, shared_ptr<Client> client, const string &name,
+	size_t offset, size_t removed, const string &text)
+{
+    lock_guard<mutex> guard(s.lock);
+    shared_ptr<Sessions::Session> session;
+
+
+    if (!s.sessions.contains(name)) {
+	send(*client, "error " + name + ": no text to edit\n");
+	return;
+    }
+
+    session = s.sessions.find(name);
+
+    if (offset > session->text.size() || removed > session->text.size() - offset) {
+	send(*client, "error " + name + ": edit out of range\n");
+	return;
+    }
+
+    session->text.replace(offset, removed, text);
+
+    if (session->edits.size() == EDITS) {
+	session->edits.clear();
+	session->replaced = true;
+    }
+
+    if (!session->replaced)
+	session->edits.push_back(Sessions::Edit {offset, removed, text.size()});
+
+    enqueue(s, client, name, session, session->text);
+}
+
+
+/*
+ * Function:	reply
+ *
+ * Description:	Send an error message to a client.
+ */
+
+static void reply(Server &s, Client &client, const string &message)
+{
+    lock_guard<mutex> guard(s.lock);
+    send(client, "error " + message + "\n");
+}
+
+
+/*
+ * Function:	checkFile
+ *
+ * Description:	Read the given file and start checking it.
+ */
+
+static void checkFile(Server &s, shared_ptr<Client> client, const string &path)
+{
+    string buf;
+    bool ok;
+    int fd;
+
+
+    if ((fd = open(path.c_str(), O_RDONLY)) < 0) {
+	reply(s, *client, path + ": " + strerror(errno));
+	return;
+    }
+
+    ok = readFile(fd, buf);
+    close(fd);
+
+    if (!ok)
+	reply(s, *client, path + ": " + strerror(errno));
+    else
+	start(s, client, path, buf);
+}
+
+
+/*
+ * Function:	request
+ *
+ * Description:	Handle the next complete request from a client, if there
+ *		is one.  Return whether a request was handled.
+ */
+
+static bool request(Server &s, shared_ptr<Client> client)
+{
+    string line, command, argument, name, buf;
+    string::size_type end, space;
+    unsigned long length, offset, removed;
+    istringstream numbers;
+    char *rest;
+    int wd;
+
+
+    if ((end = client->input.find('\n')) == string::npos)
+	return false;
+
+    line = client->input.substr(0, end);
+    space = line.find(' ');
+    command = line.substr(0, space);
+    argument = space == string::npos ? "" : line.substr(space + 1);
+
+    if (command == "buffer") {
+	space = argument.rfind(' ');
+	name = argument.substr(0, space);
+	length = strtoul(argument.c_str() + space + 1, &rest, 10);
+
+	if (space == string::npos || *rest != '\0' || name.empty()) {
+	    client->input.erase(0, end + 1);
+	    reply(s, *client, "usage: buffer name length");
+	    return true;
+	}
+
+	if (client->input.size() - end - 1 < length)
+	    return false;
+
+	buf = client->input.substr(end + 1, length);
+	client->input.erase(0, end + 1 + length);
+	start(s, client, name, buf);
+	return true;
+    }
+
+    if (command == "edit") {
+	space = argument.size();
+
+	for (unsigned i = 0; i < 3 && space != string::npos && space > 0; i ++)
+	    space = argument.rfind(' ', space - 1);
+
+	name = space == string::npos ? "" : argument.substr(0, space);
+	numbers.str(space == string::npos ? "" : argument.substr(space + 1));
+
+	if (name.empty() || !(numbers >> offset >> removed >> length) || !numbers.eof()) {
+	    client->input.erase(0, end + 1);
+	    reply(s, *client, "usage: edit name offset removed length");
+	    return true;
+	}
+
+	if (client->input.size() - end - 1 < length)
+	    return false;
+
+	buf = client->input.substr(end + 1, length);
+	client->input.erase(0, end + 1 + length);
+	change(s, client, name, offset, removed, buf);
+	return true;
+    }
+
+    client->input.erase(0, end + 1);
+
+    if (command == "check")
+	checkFile(s, client, argument);
+
+    else if (command == "watch") {
+	if ((wd = inotify_add_watch(s.inotify, argument.c_str(), WATCH_EVENTS)) < 0)
+	    reply(s, *client, argument + ": " + strerror(errno));
+	else {
+	    s.watches[wd].path = argument;
+	    s.watches[wd].client = client;
+	    checkFile(s, client, argument);
+	}
+
+    } else if (command == "unwatch") {
+	for (auto &w : s.watches)
+	    if (w.second.path == argument && w.second.client == client) {
+		inotify_rm_watch(s.inotify, w.first);
+		s.watches.erase(w.first);
+		break;
+	    }
+
+    } else if (command == "quit")
+	s.stopping = true;
+
+    else if (!line.empty())
+	reply(s, *client, "unknown request '" + command + "'");
+
+    return true;
+}
+
+
+/*
+ * Function:	forget
+ *
+ * Description:	Remove all of the watches of a client whose input has ended.
+ */
+
+static void forget(Server &s, const shared_ptr<Client> &client)
+{
+    for (auto w = s.watches.begin(); w != s.watches.end(); )
+	if (w->second.client == client) {
+	    inotify_rm_watch(s.inotify, w->first);
+	    w = s.watches.erase(w);
+	} else
+	    ++ w;
+}
+
+
+/*
+ * Function:	changed
+ *
+ * Description:	Handle the pending file system events by re-checking the
+ *		watched files that have changed.  A file replaced by an
+ *		editor loses its watch, so we watch the new file instead.
+ */
+
+static void changed(Server &s)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    map<int, Watch> recheck;
+    struct inotify_event *event;
+    ssize_t n;
+    int wd;
+
+
+    if ((n = read(s.inotify, buf, sizeof(buf))) <= 0)
+	return;
+
+    for (char *p = buf; p < buf + n; p += sizeof(*event) + event->len) {
+	event = (struct inotify_event *) p;
+
+	if (s.watches.count(event->wd) == 0)
+	    continue;
+
+	recheck[event->wd] = s.watches[event->wd];
+
+	if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+	    Watch w = s.watches[event->wd];
+
+	    inotify_rm_watch(s.inotify, event->wd);
+	    s.watches.erase(event->wd);
+	    recheck.erase(event->wd);
+
+	    if ((wd = inotify_add_watch(s.inotify, w.path.c_str(), WATCH_EVENTS)) >= 0) {
+		s.watches[wd] = w;
+		recheck[wd] = w;
+	    }
+	}
+    }
+
+    for (auto &w : recheck)
+	checkFile(s, w.second.client, w.second.path);
+}
+
+
+/*
+ * Function:	serve
+ *
+ * Description:	Serve requests on the given Unix domain socket, or on the
+ *		standard input and output if no socket is given, using the
+ *		given number of worker threads, until told to quit.  Return
+ *		the exit status of the server.
+ */
+
+int serve(const char *path, unsigned workers, const Options &options)
+{
+    struct sockaddr_un addr;
+    vector<struct pollfd> fds;
+    char buf[65536];
+    unsigned i;
+    ssize_t n;
+    int fd;
+
+
+    Server s;
+    s.options = options;
+    s.stopping = false;
+    s.draining = false;
+    s.listener = -1;
+
+    if ((s.inotify = inotify_init1(IN_CLOEXEC)) < 0) {
+	cerr << "scc: inotify: " << strerror(errno) << endl;
+	return EXIT_FAILURE;
+    }
+
+    if (path == nullptr)
+	s.clients.push_back(make_shared<Client>(Client {STDIN_FILENO, STDOUT_FILENO, "", false, false, 0}));
+
+    else {
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+
+	if ((s.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+		bind(s.listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+		listen(s.listener, SOMAXCONN) < 0) {
+	    cerr << "scc: " << path << ": " << strerror(errno) << endl;
+	    return EXIT_FAILURE;
+	}
+    }
+
+    if (workers == 0)
+	workers = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < workers; i ++)
+	s.workers.push_back(thread(worker, ref(s)));
+
+    while (!s.stopping && (s.listener >= 0 || !s.clients.empty())) {
+	fds.clear();
+	fds.push_back({s.inotify, POLLIN, 0});
+	fds.push_back({s.listener, POLLIN, 0});
+
+	for (auto &c : s.clients)
+	    fds.push_back({c->in, POLLIN, 0});
+
+	if (poll(fds.data(), fds.size(), -1) < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    break;
+	}
+
+	if (fds[0].revents & POLLIN)
+	    changed(s);
+
+	if (fds[1].revents & POLLIN)
+	    if ((fd = accept4(s.listener, nullptr, nullptr, SOCK_CLOEXEC)) >= 0)
+		s.clients.push_back(make_shared<Client>(Client {fd, fd, "", false, false, 0}));
+
+	for (i = fds.size(); i -- > 2; ) {
+	    shared_ptr<Client> client = s.clients[i - 2];
+
+	    if (fds[i].revents == 0)
+		continue;
+
+	    if ((n = read(client->in, buf, sizeof(buf))) > 0) {
+		client->input.append(buf, n);
+
+		while (!s.stopping && request(s, client))
+		    continue;
+
+	    } else if (n == 0 || errno != EINTR) {
+		forget(s, client);
+		s.clients.erase(s.clients.begin() + i - 2);
+
+		lock_guard<mutex> guard(s.lock);
+		client->ended = true;
+		finish(*client);
+	    }
+	}
+    }
+
+    {
+	lock_guard<mutex> guard(s.lock);
+	s.draining = true;
+	s.work.notify_all();
+    }
+
+    for (auto &t : s.workers)
+	t.join();
+
+    close(s.inotify);
+
+    if (s.listener >= 0) {
+	close(s.listener);
+	unlink(path);
+    }
+
+    if (metrics != nullptr) {
+	metrics->stop();
+	metrics->write(cerr);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,14 @@
+/*
+ * File:	server.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		running the checker as a long-lived server.
+ */
+
+# ifndef SERVER_H
+# define SERVER_H
+# include "scc.h"
+
+int serve(const char *socket, unsigned workers, const Options &options);
+
+# endif /* SERVER_H */
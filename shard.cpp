@@ -0,0 +1,381 @@
+/*
+ * File:	shard.cpp
+ *
+ * Description:	This file contains the public and private function and
+ *		variable definitions for checking many translation units
+ *		across worker processes.  A coordinator partitions the
+ *		files into shards of roughly equal total size and forks one
+ *		worker process per shard, talking to it over a Unix domain
+ *		socket.  Since the workers only ever see the socket, they
+ *		are a local stand-in for workers on other machines.
+ *
+ *		Each request is the length of a path followed by the path.
+ *		Each answer is the exit status of the file, the lengths of
+ *		its symbols and errors, and then the symbols and errors.
+ *		Files are handed out one at a time, so if a worker dies on
+ *		a pathological input, only that file is lost.  The file is
+ *		reported as failed, and a new worker takes over the rest
+ *		of the shard.
+ *
+ *		The results are written in the order the files were given,
+ *		exactly as in a batch run, so the report is the same no
+ *		matter how the work was divided.
+ */
+
+# include <cerrno>
+# include <cstdint>
+# include <cstdlib>
+# include <cstring>
+# include <iostream>
+# include <algorithm>
+# include <poll.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/wait.h>
+# include <sys/stat.h>
+# include <sys/socket.h>
+# include "shard.h"
+# include "batch.h"
+# include "scc.h"
+
+using namespace std;
+
+struct Worker {
+    pid_t pid;
+    int fd;
+    int current;
+    unsigned next;
+    vector<unsigned> files;
+};
+
+
+/*
+ * Function:	sendAll
+ *
+ * Description:	Write all of the given bytes to a socket.  Return whether
+ *		the write was successful.
+ */
+
+static bool sendAll(int fd, const void *data, size_t length)
+{
+    const char *p = (const char *) data;
+    ssize_t n;
+
+
+    while (length > 0) {
+	if ((n = send(fd, p, length, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    return false;
+
+	p += n;
+	length -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	receiveAll
+ *
+ * Description:	Read exactly the given number of bytes from a socket.
+ *		Return whether the read was successful.
+ */
+
+static bool receiveAll(int fd, void *data, size_t length)
+{
+    char *p = (char *) data;
+    ssize_t n;
+
+
+    while (length > 0) {
+	if ((n = recv(fd, p, length, 0)) < 0 && errno == EINTR)
+	    continue;
+
+	if (n <= 0)
+	    return false;
+
+	p += n;
+	length -= n;
+    }
+
+    return true;
+}
+
+
+/*
+ * Function:	receiveString
+ *
+ * Description:	Read a string of the given length from a socket.
+ */
+
+static bool receiveString(int fd, string &s, uint32_t length)
+{
+    s.resize(length);
+    return length == 0 || receiveAll(fd, &s[0], length);
+}
+
+
+/*
+ * Function:	serveShard
+ *
+ * Description:	Check each file the coordinator asks for and send back the
+ *		results, until the coordinator closes the socket.
+ */
+
+static int serveShard(int fd, const Options &options)
+{
+    uint32_t length, header[3];
+    Result failure;
+    string path, buf;
+    int file;
+
+
+    Context context(options);
+    failure.status = EXIT_FAILURE;
+
+    while (receiveAll(fd, &length, sizeof(length))) {
+	if (!receiveString(fd, path, length))
+	    break;
+
+	const Result *result = &failure;
+
+	if ((file = open(path.c_str(), O_RDONLY)) < 0 || !readFile(file, buf))
+	    failure.diagnostics = string(strerror(errno)) + "\n";
+	else
+	    result = &context.check(buf.data(), buf.size());
+
+	if (file >= 0)
+	    close(file);
+
+	header[0] = result->status;
+	header[1] = result->symbols.size();
+	header[2] = result->diagnostics.size();
+
+	if (!sendAll(fd, header, sizeof(header)) ||
+		!sendAll(fd, result->symbols.data(), result->symbols.size()) ||
+		!sendAll(fd, result->diagnostics.data(), result->diagnostics.size()))
+	    break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Function:	spawn
+ *
+ * Description:	Start a worker process for the given shard.
+ */
+
+static void spawn(vector<Worker> &workers, unsigned n, const Options &options)
+{
+    int sv[2];
+    pid_t pid;
+
+
+    workers[n].current = -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+	workers[n].pid = -1;
+	workers[n].fd = -1;
+	return;
+    }
+
+    cout.flush();
+    cerr.flush();
+
+    if ((pid = fork()) == 0) {
+	for (auto &w : workers)
+	    if (w.fd >= 0)
+		close(w.fd);
+
+	close(sv[0]);
+	_exit(serveShard(sv[1], options));
+    }
+
+    close(sv[1]);
+    workers[n].pid = pid;
+    workers[n].fd = pid < 0 ? -1 : sv[0];
+
+    if (pid < 0)
+	close(sv[0]);
+}
+
+
+/*
+ * Function:	reap
+ *
+ * Description:	Wait for the given worker to exit and return a description
+ *		of how it died.
+ */
+
+static string reap(Worker &w)
+{
+    int status;
+
+
+    close(w.fd);
+    w.fd = -1;
+
+    if (w.pid < 0 || waitpid(w.pid, &status, 0) < 0)
+	return "worker could not be started";
+
+    if (WIFSIGNALED(status))
+	return "worker killed by signal " + to_string(WTERMSIG(status));
+
+    return "worker exited with status " + to_string(WEXITSTATUS(status));
+}
+
+
+/*
+ * Function:	dispatch
+ *
+ * Description:	Send the next file in its shard to an idle worker.  Return
+ *		false if the shard is finished.
+ */
+
+static bool dispatch(Worker &w, vector<Job> &jobs)
+{
+    uint32_t length;
+
+
+    if (w.next == w.files.size())
+	return false;
+
+    w.current = w.files[w.next ++];
+    length = jobs[w.current].path.size();
+
+    sendAll(w.fd, &length, sizeof(length));
+    sendAll(w.fd, jobs[w.current].path.data(), length);
+    return true;
+}
+
+
+/*
+ * Function:	shard
+ *
+ * Description:	Check the given files using the given number of worker
+ *		processes.  Return EXIT_SUCCESS if every file was checked
+ *		successfully and EXIT_FAILURE otherwise.
+ */
+
+int shard(const vector<string> &paths, unsigned shards, const Options &options)
+{
+    vector<Job> jobs(paths.size());
+    vector<struct pollfd> fds;
+    vector<unsigned> order, ready;
+    vector<off_t> load;
+    uint32_t header[3];
+    unsigned i, least, next;
+    struct stat st;
+    int status;
+
+
+    if (shards == 0)
+	shards = 1;
+
+    if (shards > paths.size())
+	shards = paths.size();
+
+    for (i = 0; i < paths.size(); i ++) {
+	jobs[i].path = paths[i];
+	jobs[i].size = stat(paths[i].c_str(), &st) == 0 ? st.st_size : 0;
+	jobs[i].done = false;
+	order.push_back(i);
+    }
+
+    stable_sort(order.begin(), order.end(), [&jobs](unsigned x, unsigned y) {
+	return jobs[x].size > jobs[y].size;
+    });
+
+    vector<Worker> workers(shards);
+    load.resize(shards);
+
+    for (auto file : order) {
+	least = min_element(load.begin(), load.end()) - load.begin();
+	workers[least].files.push_back(file);
+	load[least] += jobs[file].size;
+    }
+
+    for (auto &w : workers) {
+	w.fd = -1;
+	w.next = 0;
+    }
+
+    for (i = 0; i < shards; i ++)
+	spawn(workers, i, options);
+
+    next = 0;
+    status = EXIT_SUCCESS;
+
+    while (1) {
+	fds.clear();
+	ready.clear();
+
+	for (i = 0; i < shards; i ++) {
+	    Worker &w = workers[i];
+
+	    if (w.fd >= 0 && w.current < 0 && !dispatch(w, jobs))
+		reap(w);
+
+	    if (w.fd >= 0) {
+		fds.push_back({w.fd, POLLIN, 0});
+		ready.push_back(i);
+	    }
+	}
+
+	if (fds.empty())
+	    break;
+
+	if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+	    break;
+
+	for (i = 0; i < fds.size(); i ++) {
+	    if (fds[i].revents == 0)
+		continue;
+
+	    Worker &w = workers[ready[i]];
+	    Job &job = jobs[w.current];
+
+	    if (receiveAll(w.fd, header, sizeof(header)) &&
+		    receiveString(w.fd, job.output, header[1]) &&
+		    receiveString(w.fd, job.diagnostics, header[2]))
+		job.status = (int) header[0];
+
+	    else {
+		job.output.clear();
+		job.diagnostics = reap(w) + "\n";
+		job.status = EXIT_FAILURE;
+		spawn(workers, ready[i], options);
+	    }
+
+	    job.done = true;
+	    w.current = -1;
+	}
+
+	while (next < jobs.size() && jobs[next].done) {
+	    if (jobs[next].status != EXIT_SUCCESS)
+		status = EXIT_FAILURE;
+
+	    writeJob(jobs[next ++], options.format);
+	}
+    }
+
+    for (; next < jobs.size(); next ++) {
+	if (!jobs[next].done) {
+	    jobs[next].diagnostics = "worker could not be started\n";
+	    jobs[next].status = EXIT_FAILURE;
+	}
+
+	if (jobs[next].status != EXIT_SUCCESS)
+	    status = EXIT_FAILURE;
+
+	writeJob(jobs[next], options.format);
+    }
+
+    cout.flush();
+    return status;
+}
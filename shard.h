@@ -0,0 +1,16 @@
+/*
+ * File:	shard.h
+ *
+ * Description:	This file contains the public function declarations for
+ *		checking many translation units across worker processes.
+ */
+
+# ifndef SHARD_H
+# define SHARD_H
+# include <string>
+# include <vector>
+# include "scc.h"
+
+int shard(const std::vector<std::string> &paths, unsigned shards, const Options &options);
+
+# endif /* SHARD_H */
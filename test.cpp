@@ -0,0 +1,600 @@
+/*
+ * File:	test.cpp
+ *
+ * Description:	This file contains the main function for the tests of the
+ *		Simple C front end as a library, which check properties
+ *		that the examples cannot show, such as the memory used by
+ *		repeated checks, the agreement of documents and of edits
+ *		noted to an incremental engine with check() as the text is
+ *		edited, the sessions a server drops, and the syntax tree
+ *		images that scc writes.  It is run from the top directory,
+ *		where it reads the examples and runs scc.
+ *
+ *		usage: scc-test [-f filter] [-s seed]
+ *
+ *		-f	run only the tests whose names contain the text
+ *		-s	seed the random edits with the number (default 1)
+ *
+ *		Each test reports whether it passed, and the exit status is
+ *		a failure if any test failed.
+ */
+
+# include <cstdlib>
+# include <cstring>
+# include <random>
+# include <set>
+# include <tuple>
+# include <fstream>
+# include <sstream>
+# include <iostream>
+# include <functional>
+# include <malloc.h>
+# include <unistd.h>
+# include "Document.h"
+# include "Generator.h"
+# include "Sessions.h"
+# include "Tree.h"
+# include "scc.h"
+
+using namespace std;
+
+static const char *filter = nullptr;
+static unsigned seed = 1;
+static unsigned failures;
+
+typedef tuple<string, unsigned, unsigned, unsigned, unsigned, int> Declaration;
+
+
+/*
+ * Function:	run
+ *
+ * Description:	Run the named test, unless it is filtered out, and report
+ *		whether it passed.  A test returns an empty string if it
+ *		passed, and what went wrong otherwise.
+ */
+
+static void run(const string &name, const function<string()> &test)
+{
+    string problem;
+
+
+    if (filter != nullptr && name.find(filter) == string::npos)
+	return;
+
+    problem = test();
+
+    if (problem.empty())
+	cout << "pass " << name << endl;
+    else {
+	cout << "FAIL " << name << ": " << problem << endl;
+	failures ++;
+    }
+}
+
+
+/*
+ * Function:	heap
+ *
+ * Description:	Return the number of bytes of the heap now in use.
+ */
+
+static size_t heap()
+{
+    struct mallinfo2 info = mallinfo2();
+
+
+    return info.uordblks + info.hblkhd;
+}
+
+
+/*
+ * Function:	testRepeatedChecks
+ *
+ * Description:	Check that checking the same translation unit many times
+ *		with one context leaves the heap no larger than checking it
+ *		a few times, whether the unit is valid, has errors, or has
+ *		a syntax error that abandons it part way.
+ */
+
+static string testRepeatedChecks()
+{
+    const unsigned warmup = 20, checks = 200;
+    const size_t slack = 64 << 10;
+    string valid, invalid, broken;
+    size_t before, after, middle;
+    Generator::Knobs knobs;
+    Context context;
+
+
+    knobs.functions = 50;
+    valid = Generator(knobs).generate();
+    knobs.errors = 0.2;
+    invalid = Generator(knobs).generate();
+    middle = valid.find('\n', valid.size() / 2) + 1;
+    broken = valid.substr(0, middle) + "int ( ;\n" + valid.substr(middle);
+
+    if (context.check(invalid.data(), invalid.size()).errors == 0)
+	return "the unit with errors has none";
+
+    for (auto text : {&valid, &invalid, &broken}) {
+	for (unsigned i = 0; i < warmup; i ++)
+	    context.check(text->data(), text->size());
+
+	before = heap();
+
+	for (unsigned i = 0; i < checks; i ++)
+	    context.check(text->data(), text->size());
+
+	after = heap();
+
+	if (after > before + slack)
+	    return "heap grew by " + to_string(after - before) + " bytes over " +
+		to_string(checks) + " checks";
+    }
+
+    if (context.check(broken.data(), broken.size()).status != EXIT_FAILURE)
+	return "a syntax error did not fail the check";
+
+    return "";
+}
+
+
+/*
+ * Function:	slurp
+ *
+ * Description:	Read the named file into the given string.  Return whether
+ *		the file could be read.
+ */
+
+static bool slurp(const string &path, string &text)
+{
+    ifstream in(path);
+    ostringstream s;
+
+
+    if (!in)
+	return false;
+
+    s << in.rdbuf();
+    text = s.str();
+    return true;
+}
+
+
+/*
+ * Function:	compare
+ *
+ * Description:	Compare the result of the given document with that of
+ *		check() on its text.  Return an empty string if they are
+ *		the same, and the first difference otherwise.
+ */
+
+static string compare(Document &document)
+{
+    string text = document.text();
+    Result expected = check(text.data(), text.size());
+    const Result &actual = document.result();
+
+
+    if (actual.diagnostics != expected.diagnostics)
+	return "diagnostics\n" + actual.diagnostics + "instead of\n" + expected.diagnostics;
+
+    if (actual.symbols != expected.symbols)
+	return "symbols differ";
+
+    if (actual.status != expected.status || actual.errors != expected.errors)
+	return "status or error count differs";
+
+    return "";
+}
+
+
+/*
+ * Function:	testDocumentLines
+ *
+ * Description:	Check that a syntax error in a global after a string
+ *		literal that runs to the end of its line is reported on the
+ *		same line as by check() after later edits.
+ */
+
+static string testDocumentLines()
+{
+    struct { size_t offset, removed; const char *inserted; } edits[] = {
+	{207, 0, "\""}, {84, 0, "int *f();"}, {66, 1, "}"}, {115, 1, ";"},
+	{293, 0, "licting types f"},
+    };
+
+    string text, problem;
+    Document document;
+
+
+    if (!slurp("examples/conflicting.c", text))
+	return "cannot read examples/conflicting.c";
+
+    document.open(text.data(), text.size());
+
+    for (auto &e : edits) {
+	document.edit(e.offset, e.removed, e.inserted, strlen(e.inserted));
+	problem = compare(document);
+
+	if (!problem.empty())
+	    return problem;
+    }
+
+    return "";
+}
+
+
+/*
+ * Function:	testDocumentEdits
+ *
+ * Description:	Check that a document agrees with check() on its text
+ *		after each of many short series of random edits to each
+ *		example.
+ *		The edits insert fragments chosen to open and close
+ *		comments, strings, blocks, and declarations, and to add and
+ *		remove lines, so that they often break the syntax.  Half
+ *		of the edits are undone again, which keeps the text close
+ *		to the example, so that most globals and functions are
+ *		replayed rather than checked.
+ */
+
+static string testDocumentEdits()
+{
+    const char *fragments[] = {
+	"", "\"", "'", ";", "{", "}", "(", ")", ",", "\n", "\n\n", " ",
+	"/*", "*/", "x", "int", "int *f();", "int y;\n", "char f(int a)",
+	"\"a\nb\"", "[3]", "return 1;", "\\",
+    };
+
+    const char *examples[] = {
+	"examples/conflicting.c", "examples/undeclared.c",
+	"examples/redeclared.c", "examples/void.c",
+    };
+
+    const unsigned rounds = 100, edits = 40;
+    size_t offset, removed, length;
+    string text, problem, original;
+    mt19937 random(seed);
+    const char *inserted;
+
+
+    for (auto path : examples) {
+	if (!slurp(path, text))
+	    return string("cannot read ") + path;
+
+	Document document;
+
+	for (unsigned i = 0; i < rounds * edits; i ++) {
+	    if (i % edits == 0)
+		document.open(text.data(), text.size());
+
+	    length = document.length();
+	    offset = random() % (length + 1);
+	    removed = random() % (min(length - offset, (size_t) 8) + 1);
+	    inserted = fragments[random() % (sizeof(fragments) / sizeof(*fragments))];
+
+	    original = document.text().substr(offset, removed);
+
+	    document.edit(offset, removed, inserted, strlen(inserted));
+	    problem = compare(document);
+
+	    if (problem.empty() && random() % 2 == 0) {
+		document.edit(offset, strlen(inserted), original.data(), removed);
+		problem = compare(document);
+	    }
+
+	    if (!problem.empty())
+		return string(path) + ", round " + to_string(i / edits + 1) +
+		    ", edit " + to_string(i % edits + 1) + " (" +
+		    to_string(offset) + ", " + to_string(removed) + ", \"" +
+		    inserted + "\"): " + problem;
+	}
+    }
+
+    return "";
+}
+
+
+/*
+ * Function:	testNotedEdits
+ *
+ * Description:	Check that an incremental engine that is told of the edits
+ *		made to each example, which it then trusts rather than read
+ *		the text away from them, agrees with check() on the edited
+ *		text.  Several edits are sometimes made between checks, and
+ *		the text is sometimes replaced without saying how.
+ */
+
+static string testNotedEdits()
+{
+    const char *fragments[] = {
+	"", "\"", ";", "{", "}", "\n", "/*", "*/", "x", "int y;\n",
+	"int *f();", "char f(int a)", "return 1;",
+    };
+
+    const char *examples[] = {
+	"examples/conflicting.c", "examples/undeclared.c",
+	"examples/redeclared.c", "examples/void.c",
+    };
+
+    const unsigned rounds = 100, edits = 40;
+    size_t offset, removed, length;
+    string text, original;
+    mt19937 random(seed);
+    const char *inserted;
+    Options options;
+    Result expected, actual;
+
+
+    for (auto path : examples) {
+	if (!slurp(path, original))
+	    return string("cannot read ") + path;
+
+	Incremental engine;
+	options.incremental = &engine;
+
+	for (unsigned i = 0; i < rounds * edits; i ++) {
+	    if (i % edits == 0) {
+		text = original;
+		engine.replace();
+	    }
+
+	    do {
+		length = text.size();
+		offset = random() % (length + 1);
+		removed = random() % (min(length - offset, (size_t) 8) + 1);
+		inserted = fragments[random() % (sizeof(fragments) / sizeof(*fragments))];
+
+		text.replace(offset, removed, inserted);
+		engine.edit(offset, removed, strlen(inserted));
+	    } while (random() % 3 == 0);
+
+	    if (random() % 20 == 0)
+		engine.replace();
+
+	    actual = check(text.data(), text.size(), options);
+	    expected = check(text.data(), text.size());
+
+	    if (actual.diagnostics != expected.diagnostics || actual.symbols != expected.symbols)
+		return string(path) + ", round " + to_string(i / edits + 1) +
+		    ", edit " + to_string(i % edits + 1) + ": diagnostics\n" +
+		    actual.diagnostics + "instead of\n" + expected.diagnostics;
+	}
+    }
+
+    return "";
+}
+
+
+/*
+ * Function:	testSessionEviction
+ *
+ * Description:	Check that sessions beyond their capacity drop the one used
+ *		least recently, that finding a session marks it as used,
+ *		and that a dropped session lives on while a check holds it.
+ */
+
+static string testSessionEviction()
+{
+    Sessions sessions(3);
+    shared_ptr<Sessions::Session> a, held;
+
+
+    a = sessions.find("a");
+    held = sessions.find("b");
+    sessions.find("c");
+
+    if (sessions.find("a") != a)
+	return "a session was not found again";
+
+    sessions.find("d");
+
+    if (sessions.size() != 3)
+	return "the sessions grew past their capacity";
+
+    if (sessions.contains("b") || !sessions.contains("a"))
+	return "the session used least recently was not the one dropped";
+
+    lock_guard<mutex> guard(held->lock);
+
+    if (sessions.find("b") == held)
+	return "a dropped session was found again";
+
+    for (unsigned i = 0; i < 1000; i ++)
+	sessions.find("name" + to_string(i));
+
+    if (sessions.size() != 3 || !sessions.contains("name999"))
+	return "many names did not leave the most recent sessions";
+
+    return "";
+}
+
+/*
+ * Function:	walk
+ *
+ * Description:	Walk the subtree of the given image whose root is the given
+ *		node, checking that its children lie within it and add up
+ *		to its extent, and that its type and value are in range.
+ *		Add each declaration in the subtree to the given set.
+ *		Return an empty string if the subtree is sound, and what is
+ *		wrong otherwise.
+ */
+
+static string walk(const TreeImage *h, uint32_t n, set<Declaration> &declared)
+{
+    const char *base = (const char *) h;
+    const TreeNode *nodes = (const TreeNode *) (base + h->nodes);
+    const TreeNode &node = nodes[n];
+    uint32_t extent;
+    string problem;
+
+
+    if (node.extent == 0 || node.extent > n + 1)
+	return "node " + to_string(n) + " extends past the first node";
+
+    if (node.type != TREE_NONE && node.type >= h->ntypes)
+	return "node " + to_string(n) + " has no such type";
+
+    if (node.kind == TREE_DECLARATION || node.kind == TREE_FUNCTION) {
+	const TreeSymbol *s = (const TreeSymbol *) (base + h->symbols) + node.value;
+	const TreeType *t = (const TreeType *) (base + h->types) + s->type;
+
+	if (node.value >= h->nsymbols || s->type != node.type || s->name >= h->nstrings)
+	    return "node " + to_string(n) + " has a bad symbol";
+
+	declared.insert(Declaration(base + h->strings + s->name,
+	    t->kind, t->specifier, t->indirection, t->length, t->arity));
+    }
+
+    extent = 1;
+
+    for (unsigned i = 0; i < node.arity; i ++) {
+	if (extent >= node.extent)
+	    return "node " + to_string(n) + " has too few nodes for its children";
+
+	problem = walk(h, n - extent, declared);
+
+	if (!problem.empty())
+	    return problem;
+
+	extent += nodes[n - extent].extent;
+    }
+
+    if (extent != node.extent)
+	return "node " + to_string(n) + " has an extent of " +
+	    to_string(node.extent) + " but " + to_string(extent) + " nodes";
+
+    return "";
+}
+
+
+/*
+ * Function:	testTreeImages
+ *
+ * Description:	Check that the syntax tree image that scc writes for each
+ *		example can be opened, verified, and walked from its root
+ *		to every node, that its status and error count are those of
+ *		check(), and that it declares the same names as check()
+ *		writes.  A redeclaration refers to the symbol first
+ *		declared, so each declaration in the image need only match
+ *		one of those written under its name.
+ */
+
+static string testTreeImages()
+{
+    const char *examples[] = {
+	"examples/conflicting.c", "examples/undeclared.c",
+	"examples/redeclared.c", "examples/void.c",
+    };
+
+    set<Declaration> declared, written;
+    set<string> names, writtenNames;
+    const SymbolDump *dump;
+    const TreeImage *h;
+    const TreeNode *root;
+    const char *base;
+    string text, problem, command, name;
+    Options options;
+    Result result;
+    int fd;
+
+
+    options.format = Output::BINARY;
+
+    for (auto example : examples) {
+	if (!slurp(example, text))
+	    return string("cannot read ") + example;
+
+	char path[] = "/tmp/scc-test-XXXXXX";
+
+	if ((fd = mkstemp(path)) < 0)
+	    return string("cannot create ") + path;
+
+	close(fd);
+	command = string("./scc --tree ") + path + " < " + example + " > /dev/null 2>&1";
+
+	Tree tree;
+	bool opened = system(command.c_str()) != -1 && tree.open(path);
+
+	unlink(path);
+
+	if (!opened)
+	    return string("cannot open the image of ") + example;
+
+	if (!tree.verify())
+	    return string("the image of ") + example + " does not verify";
+
+	h = tree.image();
+	root = (const TreeNode *) ((const char *) h + h->nodes) + h->count - 1;
+
+	if (h->count == 0 || root->kind != TREE_UNIT || root->extent != h->count)
+	    return string("the last node of the image of ") + example + " is not the whole unit";
+
+	declared.clear();
+	problem = walk(h, h->count - 1, declared);
+
+	if (!problem.empty())
+	    return string(example) + ": " + problem;
+
+	result = check(text.data(), text.size(), options);
+
+	if (h->status != result.status || h->errors != result.errors)
+	    return string("the image of ") + example + " has another status or error count";
+
+	dump = (const SymbolDump *) result.symbols.data();
+	base = result.symbols.data();
+	written.clear();
+	writtenNames.clear();
+	names.clear();
+
+	for (uint32_t i = 0; i < dump->count; i ++) {
+	    name = base + dump->strings + ((const uint32_t *) (base + dump->names))[i];
+	    writtenNames.insert(name);
+	    written.insert(Declaration(name,
+		((const uint8_t *) (base + dump->kinds))[i],
+		((const uint8_t *) (base + dump->specifiers))[i],
+		((const uint32_t *) (base + dump->indirections))[i],
+		((const uint32_t *) (base + dump->lengths))[i],
+		((const int32_t *) (base + dump->arities))[i]));
+	}
+
+	for (auto &d : declared) {
+	    if (written.count(d) == 0)
+		return string(example) + ": '" + get<0>(d) + "' is declared with a type never written";
+
+	    names.insert(get<0>(d));
+	}
+
+	if (names != writtenNames)
+	    return string(example) + ": the image declares other names than check() writes";
+    }
+
+    return "";
+}
+
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+
+    while ((opt = getopt(argc, argv, "f:s:")) != -1)
+	if (opt == 'f')
+	    filter = optarg;
+	else if (opt == 's')
+	    seed = strtoul(optarg, nullptr, 0);
+	else {
+	    cerr << "usage: " << argv[0] << " [-f filter] [-s seed]" << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+    run("repeated checks", testRepeatedChecks);
+    run("document lines", testDocumentLines);
+    run("document edits", testDocumentEdits);
+    run("noted edits", testNotedEdits);
+    run("session eviction", testSessionEviction);
+    run("tree images", testTreeImages);
+
+    exit(failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}